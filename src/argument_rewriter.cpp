@@ -0,0 +1,199 @@
+#include <algorithm>
+#include "argument_rewriter.hpp"
+#include "compile_command.hpp"
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+    struct default_rule
+    {
+        std::string_view argument;
+        bool prefix;
+        std::size_t values;
+    };
+
+    constexpr default_rule default_rules [] = {
+        // outputs and dependency files
+        {"-o", false, 1},
+        {"-MF", false, 1},
+        {"-MT", false, 1},
+        {"-MQ", false, 1},
+        {"-MD", false, 0},
+        {"-MMD", false, 0},
+        {"-MP", false, 0},
+        {"-save-temps", true, 0},
+        {"-pipe", false, 0},
+
+        // code generation
+        {"-O", true, 0},
+        {"-flto", true, 0},
+        {"-fno-lto", false, 0},
+        {"-ffunction-sections", false, 0},
+        {"-fdata-sections", false, 0},
+        {"-fsanitize", true, 0},
+        {"-fno-sanitize", true, 0},
+        {"-fprofile-", true, 0},
+        {"-fcoverage-", true, 0},
+        {"--coverage", false, 0},
+        {"-fdebug-prefix-map=", true, 0},
+
+        // errors for warnings
+        {"-Werror", true, 0},
+        {"-pedantic-errors", false, 0},
+
+        // plugins
+        {"-fplugin=", true, 0},
+        {"-fpass-plugin=", true, 0}
+    };
+
+    /// Debug information arguments, but not -gcc-toolchain
+    bool
+    is_debug_argument(std::string_view argument)
+    {
+        return argument.starts_with("-g") && !argument.starts_with("-gcc");
+    }
+
+    /** Returns the number of arguments that make up the clang plugin
+     *  argument starting at arguments[i], or 0.
+     *
+     *  Plugins are loaded with -Xclang -load -Xclang <plugin>, and are
+     *  given arguments with -Xclang -add-plugin -Xclang <name> or
+     *  -Xclang -plugin-arg-<name> -Xclang <argument>.
+     */
+    std::size_t
+    plugin_arguments(const std::vector<std::string> & arguments, std::size_t i)
+    {
+        if (arguments[i] != "-Xclang" || i + 1 >= arguments.size())
+        {
+            return 0;
+        }
+
+        const std::string & argument = arguments[i + 1];
+        if (argument != "-load" && argument != "-add-plugin" && argument != "-plugin" &&
+            !argument.starts_with("-plugin-arg-"))
+        {
+            return 0;
+        }
+
+        if (i + 3 < arguments.size() && arguments[i + 2] == "-Xclang")
+        {
+            return 4;
+        }
+
+        return 2;
+    }
+}
+
+void
+argument_rewriter::keep_default_arguments() noexcept
+{
+    this->_default_rules = false;
+}
+
+void
+argument_rewriter::remove(const std::string & pattern)
+{
+    if (pattern.ends_with('*'))
+    {
+        this->_rules.push_back(rule {pattern.substr(0, pattern.size() - 1), true, 0});
+    }
+    else
+    {
+        this->_rules.push_back(rule {pattern, false, 0});
+    }
+}
+
+void
+argument_rewriter::remove_with_value(const std::string & argument)
+{
+    this->_rules.push_back(rule {argument, false, 1});
+}
+
+void
+argument_rewriter::add(const std::string & argument)
+{
+    this->_added.push_back(argument);
+}
+
+bool
+argument_rewriter::rewrite(compile_command & command) const
+{
+    const std::vector<std::string> arguments = command.arguments();
+    const std::string path = command.path().string();
+
+    std::vector<std::string> rewritten;
+    rewritten.reserve(arguments.size() + this->_added.size());
+    bool changed = false;
+    for (std::size_t i = 0; i < arguments.size();)
+    {
+        // The compiler and the main file are never removed.
+        const std::size_t count = (i == 0 || arguments[i] == command.file() || arguments[i] == path) ?
+            0 : this->removed(arguments, i);
+
+        if (count == 0)
+        {
+            rewritten.push_back(arguments[i]);
+            ++i;
+            continue;
+        }
+
+        changed = true;
+        i += count;
+    }
+
+    if (!this->_added.empty())
+    {
+        rewritten.insert(rewritten.end(), this->_added.cbegin(), this->_added.cend());
+        changed = true;
+    }
+
+    if (changed)
+    {
+        command.assign_arguments(rewritten);
+    }
+
+    return changed;
+}
+
+std::size_t
+argument_rewriter::removed(const std::vector<std::string> & arguments, std::size_t i) const
+{
+    const std::string & argument = arguments[i];
+    for (const auto & r: this->_rules)
+    {
+        if (r.prefix ? argument.starts_with(r.argument) : argument == r.argument)
+        {
+            return std::min(1 + r.values, arguments.size() - i);
+        }
+    }
+
+    if (!this->_default_rules)
+    {
+        return 0;
+    }
+
+    for (const auto & r: default_rules)
+    {
+        if (r.prefix ? argument.starts_with(r.argument) : argument == r.argument)
+        {
+            return std::min(1 + r.values, arguments.size() - i);
+        }
+    }
+
+    // -o<file>
+    if (argument.starts_with("-o") && argument.size() > 2 && argument.find('=') == std::string::npos &&
+        !argument.starts_with("-objc"))
+    {
+        return 1;
+    }
+
+    if (is_debug_argument(argument))
+    {
+        return 1;
+    }
+
+    return plugin_arguments(arguments, i);
+}
@@ -0,0 +1,69 @@
+#ifndef ARGUMENT_REWRITER_HPP
+#define ARGUMENT_REWRITER_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class compile_command;
+
+/** Rewrites the arguments of compile commands before they're parsed.
+ *
+ *  By default arguments that only affect code generation or the files
+ *  a compiler writes are removed: outputs, dependency files,
+ *  optimization, debug information, LTO, sanitizers, profiling and
+ *  coverage, -Werror and compiler plugins.  libclang doesn't need them
+ *  to parse a translation unit, and some of them slow it down or make
+ *  it fail.
+ *
+ *  More arguments can be removed and arguments can be added, they're
+ *  appended to each compile command.
+ */
+class argument_rewriter
+{
+    public:
+
+    argument_rewriter() = default;
+
+    /// Keeps the arguments that are removed by default
+    void
+    keep_default_arguments() noexcept;
+
+    /// Removes arguments that match pattern, an exact argument or a
+    /// prefix followed by a '*'
+    void
+    remove(const std::string & pattern);
+
+    /// Removes argument and the value that follows it
+    void
+    remove_with_value(const std::string & argument);
+
+    /// Appends argument to each compile command
+    void
+    add(const std::string & argument);
+
+    /// Rewrites the arguments of command, returns true if they changed
+    bool
+    rewrite(compile_command & command) const;
+
+    private:
+
+    struct rule
+    {
+        std::string argument;
+        bool prefix = false;
+
+        // the number of arguments after argument that are removed too
+        std::size_t values = 0;
+    };
+
+    /// Returns the number of arguments removed starting with arguments[i]
+    std::size_t
+    removed(const std::vector<std::string> & arguments, std::size_t i) const;
+
+    bool _default_rules = true;
+    std::vector<rule> _rules;
+    std::vector<std::string> _added;
+};
+
+#endif
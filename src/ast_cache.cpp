@@ -0,0 +1,274 @@
+#include <algorithm>
+#include "ast_cache.hpp"
+#include <chrono>
+#include <clang-c/Index.h>
+#include "compile_command.hpp"
+#include "content_hash.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// A saved translation unit is made up of a <key>.ast file written by
+// clang_saveTranslationUnit and a <key>.deps file.  Each line of the
+// dependency file is the content hash, size and modification time of
+// a file in the translation unit followed by its path.
+
+namespace
+{
+    /// A unique suffix for the temporary files of the calling thread
+    std::string
+    tmp_suffix()
+    {
+        return ".tmp." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    }
+}
+
+ast_cache::ast_cache(std::filesystem::path directory, std::uintmax_t max_size):
+    _directory(std::move(directory)),
+    _max_size(max_size)
+{}
+
+CXTranslationUnit
+ast_cache::load(CXIndex index,
+                const compile_command & command,
+                unsigned parse_options,
+                std::vector<std::string> & files) const
+{
+    std::filesystem::path entry = this->entry_path(command, parse_options);
+    if (entry.empty())
+    {
+        return nullptr;
+    }
+
+    std::ifstream stream(entry.replace_extension(".deps"));
+    if (!stream)
+    {
+        return nullptr;
+    }
+
+    std::vector<std::string> entry_files;
+    file_version recorded;
+    std::string file;
+    while (stream >> recorded.hash >> recorded.size >> recorded.mtime &&
+           stream.get() == ' ' && std::getline(stream, file))
+    {
+        // Files whose size and modification time are unchanged aren't
+        // read again.
+        std::error_code size_ec;
+        std::error_code mtime_ec;
+        const std::uintmax_t size = std::filesystem::file_size(file, size_ec);
+        const auto mtime = std::filesystem::last_write_time(file, mtime_ec);
+        if (size_ec || mtime_ec || size != recorded.size || mtime.time_since_epoch().count() != recorded.mtime)
+        {
+            const auto current = this->version(file);
+            if (!current || current->hash != recorded.hash)
+            {
+                return nullptr;
+            }
+        }
+
+        entry_files.push_back(std::move(file));
+    }
+
+    if (!stream.eof())
+    {
+        return nullptr;
+    }
+
+    entry.replace_extension(".ast");
+    CXTranslationUnit unit = nullptr;
+    if (clang_createTranslationUnit2(index, entry.c_str(), &unit) != CXError_Success)
+    {
+        return nullptr;
+    }
+
+    // The modification time of a saved translation unit is when it
+    // was last used.
+    std::error_code ec;
+    std::filesystem::last_write_time(entry, std::filesystem::file_time_type::clock::now(), ec);
+
+    files = std::move(entry_files);
+    return unit;
+}
+
+void
+ast_cache::save(CXTranslationUnit unit,
+                const compile_command & command,
+                unsigned parse_options,
+                const std::vector<std::string> & files) const
+{
+    std::filesystem::path entry = this->entry_path(command, parse_options);
+    if (entry.empty())
+    {
+        return;
+    }
+
+    std::filesystem::create_directories(this->_directory);
+
+    const std::string suffix = tmp_suffix();
+    std::filesystem::path deps_file = entry;
+    deps_file.replace_extension(".deps");
+    std::filesystem::path tmp_deps_file = deps_file;
+    tmp_deps_file += suffix;
+
+    {
+        std::ofstream stream(tmp_deps_file, std::ios::trunc);
+        for (const auto & f: files)
+        {
+            const auto current = this->version(f);
+            if (!current)
+            {
+                // A translation unit that can't be validated isn't saved.
+                stream.close();
+                std::filesystem::remove(tmp_deps_file);
+                return;
+            }
+
+            stream << current->hash << ' ' << current->size << ' ' << current->mtime << ' ' << f << '\n';
+        }
+
+        if (!stream)
+        {
+            throw std::runtime_error("error writing " + tmp_deps_file.string());
+        }
+    }
+
+    std::filesystem::path ast_file = entry;
+    ast_file.replace_extension(".ast");
+    std::filesystem::path tmp_ast_file = ast_file;
+    tmp_ast_file += suffix;
+
+    if (clang_saveTranslationUnit(unit, tmp_ast_file.c_str(), CXSaveTranslationUnit_None) != CXSaveError_None)
+    {
+        std::filesystem::remove(tmp_deps_file);
+        std::filesystem::remove(tmp_ast_file);
+        return;
+    }
+
+    std::filesystem::rename(tmp_ast_file, ast_file);
+    std::filesystem::rename(tmp_deps_file, deps_file);
+}
+
+void
+ast_cache::evict() const
+{
+    std::error_code ec;
+    std::vector<std::tuple<std::filesystem::file_time_type, std::uintmax_t, std::filesystem::path>> entries;
+    std::uintmax_t total_size = 0;
+    for (const auto & entry: std::filesystem::directory_iterator(this->_directory, ec))
+    {
+        if (entry.path().extension() != ".ast")
+        {
+            continue;
+        }
+
+        std::filesystem::path deps_file = entry.path();
+        deps_file.replace_extension(".deps");
+
+        const std::uintmax_t size = entry.file_size(ec);
+        if (ec)
+        {
+            continue;
+        }
+
+        const std::uintmax_t deps_size = std::filesystem::file_size(deps_file, ec);
+        if (ec)
+        {
+            continue;
+        }
+
+        const auto mtime = entry.last_write_time(ec);
+        if (ec)
+        {
+            continue;
+        }
+
+        total_size += size + deps_size;
+        entries.emplace_back(mtime, size + deps_size, entry.path());
+    }
+
+    if (total_size <= this->_max_size)
+    {
+        return;
+    }
+
+    std::sort(entries.begin(), entries.end());
+    for (auto & [mtime, size, ast_file]: entries)
+    {
+        if (total_size <= this->_max_size)
+        {
+            break;
+        }
+
+        std::filesystem::remove(ast_file, ec);
+        std::filesystem::remove(ast_file.replace_extension(".deps"), ec);
+        total_size -= size;
+    }
+}
+
+std::optional<ast_cache::file_version>
+ast_cache::version(const std::string & file) const
+{
+    {
+        const std::lock_guard lock(this->_mutex);
+        const auto i = this->_versions.find(file);
+        if (i != this->_versions.end())
+        {
+            return i->second;
+        }
+    }
+
+    std::optional<file_version> current;
+    std::error_code size_ec;
+    std::error_code mtime_ec;
+    const std::uintmax_t size = std::filesystem::file_size(file, size_ec);
+    const auto mtime = std::filesystem::last_write_time(file, mtime_ec);
+    const auto hash = (size_ec || mtime_ec) ? std::nullopt : file_content_hash(file);
+    if (hash)
+    {
+        current = file_version {*hash, size, mtime.time_since_epoch().count()};
+    }
+
+    const std::lock_guard lock(this->_mutex);
+    this->_versions.emplace(file, current);
+    return current;
+}
+
+std::filesystem::path
+ast_cache::entry_path(const compile_command & command, unsigned parse_options) const
+{
+    const auto main_file_hash = file_content_hash(command.path());
+    if (!main_file_hash)
+    {
+        return {};
+    }
+
+    std::uint64_t hash = content_hash_seed;
+    for (std::size_t i = 0; i < command.size(); ++i)
+    {
+        // include the terminating null so argument boundaries
+        // contribute to the hash
+        const std::string_view arg = command.array()[i];
+        hash = content_hash(std::string_view(arg.data(), arg.size() + 1), hash);
+    }
+
+    hash = content_hash(std::to_string(parse_options), hash);
+    hash = content_hash(std::to_string(*main_file_hash), hash);
+
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return this->_directory / name.str();
+}
@@ -0,0 +1,86 @@
+#ifndef AST_CACHE_HPP
+#define AST_CACHE_HPP
+
+#include <clang-c/Index.h>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+class compile_command;
+
+/** Parsed translation units saved in a cache directory.
+ *
+ *  A translation unit is saved with clang_saveTranslationUnit under a
+ *  hash of its arguments, parse options and main file contents, next
+ *  to the size, modification time and content hash of each file it
+ *  includes.  Loading it with clang_createTranslationUnit2 is much
+ *  faster than parsing it again, as long as none of those files
+ *  changed.
+ *
+ *  The least recently used translation units are removed once the
+ *  cache grows larger than its size limit.
+ */
+class ast_cache
+{
+    public:
+
+    ast_cache(std::filesystem::path directory, std::uintmax_t max_size);
+
+    ast_cache(const ast_cache &) = delete;
+    ast_cache& operator = (const ast_cache &) = delete;
+
+    /** Loads the saved translation unit of command.
+     *
+     *  Returns nullptr if there is none or any of its files changed,
+     *  otherwise files is filled with the main file and the files it
+     *  includes.
+     */
+    CXTranslationUnit
+    load(CXIndex index,
+         const compile_command & command,
+         unsigned parse_options,
+         std::vector<std::string> & files) const;
+
+    /// Saves unit, parsed from command with parse_options and made up
+    /// of files
+    void
+    save(CXTranslationUnit unit,
+         const compile_command & command,
+         unsigned parse_options,
+         const std::vector<std::string> & files) const;
+
+    /// Removes the least recently used translation units until the
+    /// cache is no larger than its size limit
+    void
+    evict() const;
+
+    private:
+
+    struct file_version
+    {
+        std::uint64_t hash = 0;
+        std::uintmax_t size = 0;
+        std::int64_t mtime = 0;
+    };
+
+    /// The current version of file, each file is only hashed once
+    std::optional<file_version>
+    version(const std::string & file) const;
+
+    /// The path of the saved translation unit, without an extension,
+    /// or an empty path if the main file can't be read
+    std::filesystem::path
+    entry_path(const compile_command & command, unsigned parse_options) const;
+
+    std::filesystem::path _directory;
+    std::uintmax_t _max_size;
+
+    mutable std::mutex _mutex;
+    mutable std::map<std::string, std::optional<file_version>> _versions;
+};
+
+#endif
@@ -0,0 +1,158 @@
+#include <cerrno>
+#include "child_process.hpp"
+#include <csignal>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <system_error>
+#include <unistd.h>
+
+child_process::child_process(const std::function<void (int output)> & body)
+{
+    int pipe_fds[2];
+    if (::pipe(pipe_fds) != 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "error creating pipe");
+    }
+
+    // Output buffered by the parent would otherwise be written by the
+    // child too.
+    std::cout.flush();
+    std::cerr.flush();
+
+    this->_pid = ::fork();
+    if (this->_pid < 0)
+    {
+        const int error = errno;
+        ::close(pipe_fds[0]);
+        ::close(pipe_fds[1]);
+        throw std::system_error(error, std::generic_category(), "error creating child process");
+    }
+
+    if (this->_pid == 0)
+    {
+        ::close(pipe_fds[0]);
+
+        int status = 0;
+        try
+        {
+            body(pipe_fds[1]);
+        }
+        catch (const std::exception & e)
+        {
+            std::cerr << e.what() << '\n';
+            status = 1;
+        }
+        catch (...)
+        {
+            status = 1;
+        }
+
+        // The parent's objects the child inherited are not destroyed.
+        std::cout.flush();
+        std::cerr.flush();
+        ::_exit(status);
+    }
+
+    ::close(pipe_fds[1]);
+    this->_output = pipe_fds[0];
+}
+
+child_process::~child_process()
+{
+    if (!this->_exited)
+    {
+        this->kill();
+        try
+        {
+            this->wait();
+        }
+        catch (...)
+        {
+        }
+    }
+
+    ::close(this->_output);
+}
+
+void
+child_process::write(int output, std::string_view data)
+{
+    while (!data.empty())
+    {
+        const ssize_t written = ::write(output, data.data(), data.size());
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            throw std::system_error(errno, std::generic_category(), "error writing to parent");
+        }
+
+        data.remove_prefix(written);
+    }
+}
+
+int
+child_process::output() const noexcept
+{
+    return this->_output;
+}
+
+bool
+child_process::read(std::string & buffer)
+{
+    char data[4096];
+    while (true)
+    {
+        const ssize_t size = ::read(this->_output, data, sizeof(data));
+        if (size < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            throw std::system_error(errno, std::generic_category(), "error reading from child");
+        }
+
+        buffer.append(data, size);
+        return size > 0;
+    }
+}
+
+void
+child_process::kill() noexcept
+{
+    if (!this->_exited)
+    {
+        ::kill(this->_pid, SIGKILL);
+    }
+}
+
+int
+child_process::wait()
+{
+    while (!this->_exited)
+    {
+        if (::waitpid(this->_pid, &this->_status, 0) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            throw std::system_error(errno, std::generic_category(), "error waiting for child");
+        }
+
+        this->_exited = true;
+    }
+
+    return this->_status;
+}
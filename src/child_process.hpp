@@ -0,0 +1,64 @@
+#ifndef CHILD_PROCESS_HPP
+#define CHILD_PROCESS_HPP
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+
+/** A function run in a forked child process.
+ *
+ *  The function writes its results to a pipe that the parent reads,
+ *  and the child exits when it returns, with status 1 if it threw.  A
+ *  child that is still running when its child_process is destroyed is
+ *  killed.
+ *
+ *  The child starts with a copy of the calling thread only, so it must
+ *  be forked from a process without other threads, otherwise it can
+ *  block on a mutex another thread held.
+ */
+class child_process
+{
+    public:
+
+    /// Runs body in a child process, passing it the write end of the
+    /// pipe.  Throws std::system_error if the child can't be created.
+    explicit
+    child_process(const std::function<void (int output)> & body);
+
+    child_process(const child_process &) = delete;
+    child_process& operator = (const child_process &) = delete;
+
+    ~child_process();
+
+    /// Writes all of data to output, called by the child
+    static
+    void
+    write(int output, std::string_view data);
+
+    /// The read end of the pipe, to poll
+    int
+    output() const noexcept;
+
+    /// Appends the output that is available to buffer, returns false
+    /// once the child closed the pipe
+    bool
+    read(std::string & buffer);
+
+    void
+    kill() noexcept;
+
+    /// Waits for the child to exit and returns its status as reported
+    /// by waitpid
+    int
+    wait();
+
+    private:
+
+    pid_t _pid = -1;
+    int _output = -1;
+    bool _exited = false;
+    int _status = 0;
+};
+
+#endif
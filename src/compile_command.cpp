@@ -0,0 +1,94 @@
+#include <algorithm>
+#include "compile_command.hpp"
+#include "compile_database.hpp"
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+compile_command::compile_command(const std::string & file):
+    _file(file)
+{
+    this->_commands.push_back(this->own(file));
+}
+
+compile_command::compile_command(const compile_database::entry & entry):
+    _commands(entry.arguments.begin(), entry.arguments.end()),
+    _file(entry.file),
+    _directory(entry.directory)
+{}
+
+compile_command::~compile_command() = default;
+
+char * const *
+compile_command::array() const noexcept
+{
+    
+    return this->_commands.empty() ? nullptr : &this->_commands.front();
+}
+
+size_t
+compile_command::size() const noexcept
+{
+    return this->_commands.size();
+}
+
+bool
+compile_command::empty() const noexcept
+{
+    return this->_commands.empty();
+}
+
+void
+compile_command::insert_arguments(std::size_t position, const std::vector<std::string> & arguments)
+{
+    std::vector<char *> inserted;
+    inserted.reserve(arguments.size());
+    for (const auto & argument: arguments)
+    {
+        inserted.push_back(this->own(argument));
+    }
+
+    position = std::min(position, this->_commands.size());
+    this->_commands.insert(this->_commands.begin() + position, inserted.cbegin(), inserted.cend());
+}
+
+std::vector<std::string>
+compile_command::arguments() const
+{
+    return std::vector<std::string>(this->_commands.cbegin(), this->_commands.cend());
+}
+
+void
+compile_command::assign_arguments(const std::vector<std::string> & arguments)
+{
+    this->_commands.clear();
+    this->_owned.clear();
+    this->insert_arguments(0, arguments);
+}
+
+const std::string &
+compile_command::file() const noexcept
+{
+    return this->_file;
+}
+
+const std::string &
+compile_command::directory() const noexcept
+{
+    return this->_directory;
+}
+
+std::filesystem::path
+compile_command::path() const
+{
+    return std::filesystem::path(this->_directory) / this->_file;
+}
+
+char *
+compile_command::own(const std::string & argument)
+{
+    this->_owned.push_back(std::make_unique<char []>(argument.size() + 1));
+    argument.copy(this->_owned.back().get(), argument.size());
+    return this->_owned.back().get();
+}
@@ -0,0 +1,72 @@
+#ifndef COMPILE_COMMAND_HPP
+#define COMPILE_COMMAND_HPP
+
+#include "compile_database.hpp"
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+class compile_command
+{
+    public:
+
+    /// Refers to the arguments of entry, which must outlive the
+    /// compile command
+    explicit
+    compile_command(const compile_database::entry & entry);
+    compile_command(const std::string & file);
+
+    ~compile_command();
+
+    compile_command(const compile_command &) = delete;
+    compile_command& operator = (const compile_command &) = delete;
+
+    char * const *
+    array() const noexcept;
+
+    size_t
+    size() const noexcept;
+
+    bool
+    empty() const noexcept;
+
+    /// Inserts arguments before the argument at position
+    void
+    insert_arguments(std::size_t position, const std::vector<std::string> & arguments);
+
+    std::vector<std::string>
+    arguments() const;
+
+    /// Replaces the arguments
+    void
+    assign_arguments(const std::vector<std::string> & arguments);
+
+    /// The main file of the compile command
+    const std::string &
+    file() const noexcept;
+
+    /// The working directory of the compile command
+    const std::string &
+    directory() const noexcept;
+
+    /// The main file resolved against the working directory
+    std::filesystem::path
+    path() const;
+
+    private:
+
+    /// Returns a copy of argument owned by the compile command
+    char *
+    own(const std::string & argument);
+
+    std::vector<char *> _commands;
+
+    // the arguments that aren't in the compile database's arena
+    std::vector<std::unique_ptr<char []>> _owned;
+    std::string _file;
+    std::string _directory;
+};
+
+#endif
@@ -0,0 +1,790 @@
+#include <algorithm>
+#include <cerrno>
+#include "compile_database.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    /// A read only memory mapping of a file
+    class mapped_file
+    {
+        public:
+
+        explicit
+        mapped_file(const std::filesystem::path & path)
+        {
+            const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+            {
+                throw std::system_error(errno, std::generic_category(), path.string());
+            }
+
+            struct stat status;
+            if (::fstat(fd, &status) < 0)
+            {
+                const int error = errno;
+                ::close(fd);
+                throw std::system_error(error, std::generic_category(), path.string());
+            }
+
+            this->_size = status.st_size;
+            if (this->_size > 0)
+            {
+                void * data = ::mmap(nullptr, this->_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (data == MAP_FAILED)
+                {
+                    const int error = errno;
+                    ::close(fd);
+                    throw std::system_error(error, std::generic_category(), path.string());
+                }
+
+                ::madvise(data, this->_size, MADV_SEQUENTIAL);
+                this->_data = static_cast<const char *>(data);
+            }
+
+            ::close(fd);
+        }
+
+        ~mapped_file()
+        {
+            if (this->_data)
+            {
+                ::munmap(const_cast<char *>(this->_data), this->_size);
+            }
+        }
+
+        mapped_file(const mapped_file &) = delete;
+        mapped_file& operator = (const mapped_file &) = delete;
+
+        std::string_view
+        contents() const noexcept
+        {
+            return {this->_data ? this->_data : "", this->_size};
+        }
+
+        private:
+
+        const char * _data = nullptr;
+        std::size_t _size = 0;
+    };
+
+    /// Reads the JSON values of a compile database without building
+    /// a document
+    class json_reader
+    {
+        public:
+
+        json_reader(std::string_view data, std::string name):
+            _data(data),
+            _name(std::move(name))
+        {}
+
+        std::size_t
+        position() const noexcept
+        {
+            return this->_position;
+        }
+
+        void
+        seek(std::size_t position) noexcept
+        {
+            this->_position = position;
+        }
+
+        /// Skips white space, returns true if the next character is c
+        /// and consumes it
+        bool
+        consume(char c)
+        {
+            this->skip_space();
+            if (this->_position < this->_data.size() && this->_data[this->_position] == c)
+            {
+                ++this->_position;
+                return true;
+            }
+
+            return false;
+        }
+
+        void
+        expect(char c)
+        {
+            if (!this->consume(c))
+            {
+                this->error(std::string("expected '") + c + '\'');
+            }
+        }
+
+        void
+        expect_end()
+        {
+            this->skip_space();
+            if (this->_position != this->_data.size())
+            {
+                this->error("expected the end of the file");
+            }
+        }
+
+        /// Reads a string into value
+        void
+        read_string(std::string & value)
+        {
+            value.clear();
+            this->append_string(value);
+        }
+
+        /// Reads a string and appends it to value
+        void
+        append_string(std::string & value)
+        {
+            this->expect('"');
+            while (true)
+            {
+                const std::size_t end = this->string_end(this->_position);
+                if (end == std::string_view::npos)
+                {
+                    this->error("unterminated string");
+                }
+
+                value.append(this->_data, this->_position, end - this->_position);
+                this->_position = end + 1;
+                if (this->_data[end] == '"')
+                {
+                    return;
+                }
+
+                this->read_escape(value);
+            }
+        }
+
+        /// Skips any value
+        void
+        skip_value()
+        {
+            this->skip_space();
+            if (this->_position >= this->_data.size())
+            {
+                this->error("expected a value");
+            }
+
+            const char c = this->_data[this->_position];
+            if (c == '"')
+            {
+                this->skip_string();
+            }
+            else if (c == '[' || c == '{')
+            {
+                const char close = (c == '[') ? ']' : '}';
+                ++this->_position;
+                if (this->consume(close))
+                {
+                    return;
+                }
+
+                do
+                {
+                    if (close == '}')
+                    {
+                        this->skip_string();
+                        this->expect(':');
+                    }
+
+                    this->skip_value();
+                } while (this->consume(','));
+
+                this->expect(close);
+            }
+            else
+            {
+                // numbers, true, false and null
+                const std::size_t end = this->_data.find_first_of(",]} \t\r\n", this->_position);
+                if (end == this->_position)
+                {
+                    this->error("expected a value");
+                }
+
+                this->_position = (end == std::string_view::npos) ? this->_data.size() : end;
+            }
+        }
+
+        [[noreturn]]
+        void
+        error(const std::string & what) const
+        {
+            throw std::runtime_error(this->_name + ':' + std::to_string(this->_position) + ": " + what);
+        }
+
+        private:
+
+        void
+        skip_space() noexcept
+        {
+            while (this->_position < this->_data.size())
+            {
+                const char c = this->_data[this->_position];
+                if (c != ' ' && c != '\t' && c != '\r' && c != '\n')
+                {
+                    return;
+                }
+
+                ++this->_position;
+            }
+        }
+
+        /// Returns the position of the quote or backslash that ends
+        /// the characters of a string starting at position
+        std::size_t
+        string_end(std::size_t position) const noexcept
+        {
+            for (; position < this->_data.size(); ++position)
+            {
+                const char c = this->_data[position];
+                if (c == '"' || c == '\\')
+                {
+                    return position;
+                }
+            }
+
+            return std::string_view::npos;
+        }
+
+        void
+        skip_string()
+        {
+            this->expect('"');
+            while (true)
+            {
+                const std::size_t end = this->string_end(this->_position);
+                if (end == std::string_view::npos || end + 1 >= this->_data.size())
+                {
+                    this->error("unterminated string");
+                }
+
+                this->_position = end + 1 + (this->_data[end] == '\\');
+                if (this->_data[end] == '"')
+                {
+                    return;
+                }
+            }
+        }
+
+        void
+        read_escape(std::string & value)
+        {
+            if (this->_position >= this->_data.size())
+            {
+                this->error("unterminated string");
+            }
+
+            const char c = this->_data[this->_position++];
+            switch (c)
+            {
+                case '"':
+                case '\\':
+                case '/':
+                    value += c;
+                    return;
+                case 'b':
+                    value += '\b';
+                    return;
+                case 'f':
+                    value += '\f';
+                    return;
+                case 'n':
+                    value += '\n';
+                    return;
+                case 'r':
+                    value += '\r';
+                    return;
+                case 't':
+                    value += '\t';
+                    return;
+                case 'u':
+                    break;
+                default:
+                    this->error("invalid escape");
+            }
+
+            std::uint32_t code_point = this->read_hex();
+            if (code_point >= 0xd800 && code_point < 0xdc00 &&
+                this->_data.substr(this->_position, 2) == "\\u")
+            {
+                this->_position += 2;
+                const std::uint32_t low = this->read_hex();
+                code_point = 0x10000 + ((code_point - 0xd800) << 10) + (low - 0xdc00);
+            }
+
+            // UTF-8
+            if (code_point < 0x80)
+            {
+                value += static_cast<char>(code_point);
+            }
+            else if (code_point < 0x800)
+            {
+                value += static_cast<char>(0xc0 | (code_point >> 6));
+                value += static_cast<char>(0x80 | (code_point & 0x3f));
+            }
+            else if (code_point < 0x10000)
+            {
+                value += static_cast<char>(0xe0 | (code_point >> 12));
+                value += static_cast<char>(0x80 | ((code_point >> 6) & 0x3f));
+                value += static_cast<char>(0x80 | (code_point & 0x3f));
+            }
+            else
+            {
+                value += static_cast<char>(0xf0 | (code_point >> 18));
+                value += static_cast<char>(0x80 | ((code_point >> 12) & 0x3f));
+                value += static_cast<char>(0x80 | ((code_point >> 6) & 0x3f));
+                value += static_cast<char>(0x80 | (code_point & 0x3f));
+            }
+        }
+
+        std::uint32_t
+        read_hex()
+        {
+            if (this->_position + 4 > this->_data.size())
+            {
+                this->error("invalid unicode escape");
+            }
+
+            std::uint32_t value = 0;
+            for (int i = 0; i < 4; ++i)
+            {
+                const char c = this->_data[this->_position++];
+                value <<= 4;
+                if (c >= '0' && c <= '9')
+                {
+                    value |= c - '0';
+                }
+                else if (c >= 'a' && c <= 'f')
+                {
+                    value |= c - 'a' + 10;
+                }
+                else if (c >= 'A' && c <= 'F')
+                {
+                    value |= c - 'A' + 10;
+                }
+                else
+                {
+                    this->error("invalid unicode escape");
+                }
+            }
+
+            return value;
+        }
+
+        std::string_view _data;
+        std::string _name;
+        std::size_t _position = 0;
+    };
+
+    /// The arguments of a compile command, separated by nulls
+    struct argument_buffer
+    {
+        std::string data;
+        std::vector<std::size_t> starts;
+
+        void
+        clear() noexcept
+        {
+            this->data.clear();
+            this->starts.clear();
+        }
+
+        void
+        start_argument()
+        {
+            this->starts.push_back(this->data.size());
+        }
+
+        void
+        end_argument()
+        {
+            this->data += '\0';
+        }
+
+        std::size_t
+        size() const noexcept
+        {
+            return this->starts.size();
+        }
+
+        std::string_view
+        operator [] (std::size_t i) const noexcept
+        {
+            return this->data.c_str() + this->starts[i];
+        }
+    };
+
+    bool
+    is_command_space(char c) noexcept
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    /** Splits a command the way a POSIX shell would.
+     *
+     *  Arguments are separated by white space.  A backslash escapes the
+     *  next character, except inside single quotes, and quotes group
+     *  characters into one argument.  This is how libclang's JSON
+     *  compilation database splits commands.
+     */
+    void
+    split_command(std::string_view command, argument_buffer & arguments)
+    {
+        bool in_argument = false;
+        for (std::size_t i = 0; i < command.size(); ++i)
+        {
+            const char c = command[i];
+            if (is_command_space(c))
+            {
+                if (in_argument)
+                {
+                    arguments.end_argument();
+                    in_argument = false;
+                }
+
+                continue;
+            }
+
+            if (!in_argument)
+            {
+                arguments.start_argument();
+                in_argument = true;
+            }
+
+            if (c == '\\' && i + 1 < command.size())
+            {
+                arguments.data += command[++i];
+            }
+            else if (c == '\'')
+            {
+                const std::size_t end = command.find('\'', i + 1);
+                const std::size_t last = (end == std::string_view::npos) ? command.size() : end;
+                arguments.data.append(command, i + 1, last - i - 1);
+                i = last;
+            }
+            else if (c == '"')
+            {
+                for (++i; i < command.size() && command[i] != '"'; ++i)
+                {
+                    if (command[i] == '\\' && i + 1 < command.size())
+                    {
+                        ++i;
+                    }
+
+                    arguments.data += command[i];
+                }
+            }
+            else
+            {
+                std::size_t end = i + 1;
+                while (end < command.size() && !is_command_space(command[end]) &&
+                       command[end] != '\\' && command[end] != '\'' && command[end] != '"')
+                {
+                    ++end;
+                }
+
+                arguments.data.append(command, i, end - i);
+                i = end - 1;
+            }
+        }
+
+        if (in_argument)
+        {
+            arguments.end_argument();
+        }
+    }
+
+    /** Replaces @file arguments with the arguments read from the file,
+     *  like libclang's JSON compilation database does.
+     *
+     *  Relative response files are found from the directory of the
+     *  entry and response files may name further response files, up to
+     *  a nesting depth that stops cycles.  An argument naming a file
+     *  that can't be read is kept as it is, for the compiler to report.
+     */
+    void
+    expand_response_files(argument_buffer & arguments, const std::filesystem::path & directory,
+                          unsigned int depth = 0)
+    {
+        constexpr unsigned int max_depth = 16;
+
+        bool found = false;
+        for (std::size_t i = 0; i < arguments.size() && !found; ++i)
+        {
+            found = arguments[i].size() > 1 && arguments[i].front() == '@';
+        }
+
+        if (!found || depth == max_depth)
+        {
+            return;
+        }
+
+        argument_buffer expanded;
+        std::string contents;
+        for (std::size_t i = 0; i < arguments.size(); ++i)
+        {
+            const std::string_view argument = arguments[i];
+            if (argument.size() > 1 && argument.front() == '@')
+            {
+                std::ifstream stream(directory / argument.substr(1), std::ios::binary);
+                if (stream)
+                {
+                    contents.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+                    if (!stream.bad())
+                    {
+                        argument_buffer included;
+                        split_command(contents, included);
+                        expand_response_files(included, directory, depth + 1);
+                        for (std::size_t j = 0; j < included.size(); ++j)
+                        {
+                            expanded.start_argument();
+                            expanded.data += included[j];
+                            expanded.end_argument();
+                        }
+
+                        continue;
+                    }
+                }
+            }
+
+            expanded.start_argument();
+            expanded.data += argument;
+            expanded.end_argument();
+        }
+
+        arguments = std::move(expanded);
+    }
+
+    /** Returns the --driver-mode argument implied by the name of the
+     *  compiler, like libclang's compilation database adds.
+     *
+     *  clang++, g++ and c++ are C++ drivers and clang-cl is the cl
+     *  driver, optionally followed by a version.
+     */
+    std::string_view
+    implied_driver_mode(const argument_buffer & arguments)
+    {
+        if (arguments.size() == 0)
+        {
+            return {};
+        }
+
+        for (std::size_t i = 1; i < arguments.size(); ++i)
+        {
+            if (arguments[i].starts_with("--driver-mode="))
+            {
+                return {};
+            }
+        }
+
+        std::string name = std::filesystem::path(arguments[0]).filename().string();
+        if (name.ends_with(".exe"))
+        {
+            name.erase(name.size() - 4);
+        }
+
+        // strip a version, clang++-18 or g++-13.2
+        const std::size_t version = name.find_last_not_of("0123456789.");
+        if (version != std::string::npos && version + 1 < name.size() && name[version] == '-')
+        {
+            name.erase(version);
+        }
+
+        if (name.ends_with("++"))
+        {
+            return "--driver-mode=g++";
+        }
+
+        if (name == "clang-cl" || name == "cl")
+        {
+            return "--driver-mode=cl";
+        }
+
+        return {};
+    }
+}
+
+compile_database::compile_database(const std::filesystem::path & build_dir, const filter & file_filter)
+{
+    const std::filesystem::path path = build_dir / "compile_commands.json";
+    const mapped_file file {path};
+    json_reader reader {file.contents(), path.string()};
+
+    // Entries refer to their arguments by position until _argv stops
+    // growing.
+    std::vector<std::pair<std::size_t, std::size_t>> argument_ranges;
+
+    std::string key;
+    std::string directory;
+    std::string file_name;
+    std::string value;
+    argument_buffer arguments;
+
+    reader.expect('[');
+    std::size_t index = 0;
+    if (!reader.consume(']'))
+    {
+        do
+        {
+            directory.clear();
+            file_name.clear();
+            std::optional<std::size_t> command_position;
+            std::optional<std::size_t> arguments_position;
+
+            reader.expect('{');
+            if (!reader.consume('}'))
+            {
+                do
+                {
+                    reader.read_string(key);
+                    reader.expect(':');
+                    if (key == "directory")
+                    {
+                        reader.read_string(directory);
+                    }
+                    else if (key == "file")
+                    {
+                        reader.read_string(file_name);
+                    }
+                    else
+                    {
+                        // The arguments are only read if the file
+                        // passes the filter.
+                        if (key == "command")
+                        {
+                            command_position = reader.position();
+                        }
+                        else if (key == "arguments")
+                        {
+                            arguments_position = reader.position();
+                        }
+
+                        reader.skip_value();
+                    }
+                } while (reader.consume(','));
+
+                reader.expect('}');
+            }
+
+            const std::size_t entry_index = index++;
+            if (file_name.empty() || (!command_position && !arguments_position))
+            {
+                reader.error("entry without a file or a command");
+            }
+
+            if (file_filter && !file_filter(std::filesystem::path(directory) / file_name))
+            {
+                continue;
+            }
+
+            const std::size_t end = reader.position();
+            arguments.clear();
+            if (arguments_position)
+            {
+                reader.seek(*arguments_position);
+                reader.expect('[');
+                if (!reader.consume(']'))
+                {
+                    do
+                    {
+                        arguments.start_argument();
+                        reader.append_string(arguments.data);
+                        arguments.end_argument();
+                    } while (reader.consume(','));
+
+                    reader.expect(']');
+                }
+            }
+            else
+            {
+                reader.seek(*command_position);
+                reader.read_string(value);
+                split_command(value, arguments);
+            }
+
+            reader.seek(end);
+            expand_response_files(arguments, directory);
+
+            entry e;
+            e.index = entry_index;
+            e.directory = std::string_view(this->store(directory), directory.size());
+            e.file = std::string_view(this->store(file_name), file_name.size());
+
+            const std::size_t first = this->_argv.size();
+            const std::string_view driver_mode = implied_driver_mode(arguments);
+            char * stored = this->store(arguments.data);
+            for (std::size_t i = 0; i < arguments.size(); ++i)
+            {
+                this->_argv.push_back(stored + arguments.starts[i]);
+                if (i == 0 && !driver_mode.empty())
+                {
+                    this->_argv.push_back(this->store(driver_mode));
+                }
+            }
+
+            argument_ranges.emplace_back(first, this->_argv.size() - first);
+            this->_entries.push_back(e);
+        } while (reader.consume(','));
+
+        reader.expect(']');
+    }
+
+    reader.expect_end();
+
+    for (std::size_t i = 0; i < this->_entries.size(); ++i)
+    {
+        const auto [first, size] = argument_ranges[i];
+        this->_entries[i].arguments = std::span<char * const>(this->_argv.data() + first, size);
+    }
+}
+
+const std::vector<compile_database::entry> &
+compile_database::entries() const noexcept
+{
+    return this->_entries;
+}
+
+const compile_database::entry *
+compile_database::find(std::size_t index) const noexcept
+{
+    const auto i = std::lower_bound(this->_entries.cbegin(), this->_entries.cend(), index,
+                                    [] (const entry & e, std::size_t index) {return e.index < index;});
+    return (i == this->_entries.cend() || i->index != index) ? nullptr : &*i;
+}
+
+char *
+compile_database::store(std::string_view data)
+{
+    constexpr std::size_t block_size = 1024 * 1024;
+    if (this->_blocks.empty() || this->_block_used + data.size() + 1 > this->_block_size)
+    {
+        this->_block_size = std::max(block_size, data.size() + 1);
+        this->_blocks.push_back(std::make_unique_for_overwrite<char []>(this->_block_size));
+        this->_block_used = 0;
+    }
+
+    char * stored = this->_blocks.back().get() + this->_block_used;
+    data.copy(stored, data.size());
+    stored[data.size()] = '\0';
+    this->_block_used += data.size() + 1;
+    return stored;
+}
@@ -0,0 +1,73 @@
+#ifndef COMPILE_DATABASE_HPP
+#define COMPILE_DATABASE_HPP
+
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+/** The compile commands of a build directory's compile_commands.json.
+ *
+ *  The file is memory mapped and parsed one entry at a time, without
+ *  building a document.  The strings of the entries are stored in an
+ *  arena owned by the database, and each entry's arguments are a view
+ *  of an argv array that can be passed to libclang as it is.
+ *
+ *  An entry whose main file doesn't pass the filter is skipped before
+ *  its arguments are read.
+ */
+class compile_database
+{
+    public:
+
+    struct entry
+    {
+        // position of the entry in compile_commands.json
+        std::size_t index = 0;
+
+        std::string_view directory;
+        std::string_view file;
+        std::span<char * const> arguments;
+    };
+
+    /// Returns true if the compile command of file, the main file
+    /// resolved against the working directory, is kept
+    using filter = std::function<bool (const std::filesystem::path & file)>;
+
+    /** Loads build_dir/compile_commands.json.
+     *
+     *  Throws std::runtime_error if the file can't be read or isn't a
+     *  compile database.
+     */
+    explicit
+    compile_database(const std::filesystem::path & build_dir, const filter & file_filter = {});
+
+    compile_database(const compile_database &) = delete;
+    compile_database& operator = (const compile_database &) = delete;
+
+    const std::vector<entry> &
+    entries() const noexcept;
+
+    /// Returns the entry at index in compile_commands.json, or nullptr
+    /// if there is none or it was filtered out
+    const entry *
+    find(std::size_t index) const noexcept;
+
+    private:
+
+    /// Copies data to the arena, followed by a null
+    char *
+    store(std::string_view data);
+
+    std::vector<entry> _entries;
+    std::vector<char *> _argv;
+
+    std::vector<std::unique_ptr<char []>> _blocks;
+    std::size_t _block_used = 0;
+    std::size_t _block_size = 0;
+};
+
+#endif
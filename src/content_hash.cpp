@@ -0,0 +1,47 @@
+#include "content_hash.hpp"
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string_view>
+
+std::uint64_t
+content_hash(std::string_view data, std::uint64_t seed) noexcept
+{
+    constexpr std::uint64_t prime = 0x100000001b3;
+
+    std::uint64_t hash = seed;
+    for (const char c: data)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= prime;
+    }
+
+    return hash;
+}
+
+std::optional<std::uint64_t>
+file_content_hash(const std::filesystem::path & file)
+{
+    std::ifstream stream(file, std::ios::binary);
+    if (!stream)
+    {
+        return std::nullopt;
+    }
+
+    std::uint64_t hash = content_hash_seed;
+    std::array<char, 64 * 1024> buffer;
+    while (stream)
+    {
+        stream.read(buffer.data(), buffer.size());
+        hash = content_hash(std::string_view(buffer.data(), stream.gcount()), hash);
+    }
+
+    if (stream.bad())
+    {
+        return std::nullopt;
+    }
+
+    return hash;
+}
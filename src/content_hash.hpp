@@ -0,0 +1,19 @@
+#ifndef CONTENT_HASH_HPP
+#define CONTENT_HASH_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+
+/// 64 bit FNV-1a hash used to detect changes in file contents
+constexpr std::uint64_t content_hash_seed = 0xcbf29ce484222325;
+
+std::uint64_t
+content_hash(std::string_view data, std::uint64_t seed = content_hash_seed) noexcept;
+
+/// Hashes the contents of file, returns nothing if file can't be read
+std::optional<std::uint64_t>
+file_content_hash(const std::filesystem::path & file);
+
+#endif
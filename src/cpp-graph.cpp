@@ -1,36 +1,78 @@
 #include <algorithm>
+#include "argument_rewriter.hpp"
 #include <array>
-#include <clang-c/CXCompilationDatabase.h>
+#include "ast_cache.hpp"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include "child_process.hpp"
 #include <clang-c/Index.h>
 #include "class_decl_node.hpp"
 #include "class_node.hpp"
-#include <cstring>
+#include "compile_command.hpp"
+#include "compile_database.hpp"
+#include "content_hash.hpp"
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
 #include "edge_labels.hpp"
 #include <exception>
 #include <filesystem>
+#include <fstream>
 #include <functional>
 #include "function_node.hpp"
 #include "function_decl_def_node.hpp"
+#include "function_labels.hpp"
+#include "graph_connection.hpp"
 #include <getopt.h>
+#include "file_watcher.hpp"
+#include "graphed_files.hpp"
 #include "help.hpp"
+#include "index_state.hpp"
+#include "indexer.hpp"
 #include <iostream>
+#include <iterator>
+#include <map>
 #include <memory>
 #include "memgraph/cypher.hpp"
 #include "memgraph/cypher/property.hpp"
 #include "memgraph/cypher/property_set.hpp"
 #include <mgclient.hpp>
+#include <mutex>
 #include "namespace_node.hpp"
 #include "namespace_decl_node.hpp"
 #include "ngclang.hpp"
 #include "node_property_names.hpp"
 #include <optional>
+#include "path_matcher.hpp"
+#include "path_trie.hpp"
+#include "pch_cache.hpp"
+#include <poll.h>
+#include <set>
 #include "raw_node.hpp"
+#include "shared_channel.hpp"
+#include "source_cache.hpp"
 #include <sstream>
+#include <stdexcept>
 #include "statement_executor.hpp"
 #include <string>
 #include <string_view>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <system_error>
+#include <thread>
+#include "translation_units.hpp"
+#include "tu_deduplicator.hpp"
+#include <unordered_map>
+#include "tu_scheduler.hpp"
+#include "tu_timings.hpp"
 #include <unistd.h>
+#include "unix_socket_server.hpp"
+#include "unity_batches.hpp"
+#include "unresolved_function_node.hpp"
 #include <vector>
+#include "work_client.hpp"
+#include "work_coordinator.hpp"
 
 class memgraph_init
 {
@@ -189,7 +231,7 @@ class function_decl
     public:
 
     explicit
-    function_decl(CXCursor cursor);
+    function_decl(ngclang::cursor_facts & facts);
 
     const std::string &
     universal_symbol_reference() const noexcept;
@@ -207,12 +249,11 @@ class function_decl
     bool _is_member_function = false;
 };
 
-function_decl::function_decl(CXCursor cursor):
-    _location(cursor),
-    _universal_symbol_reference(ngclang::to_string(cursor, &clang_getCursorUSR))
+function_decl::function_decl(ngclang::cursor_facts & facts):
+    _location(facts.location()),
+    _universal_symbol_reference(facts.universal_symbol_reference())
 {
-    const CXCursorKind cursor_kind = clang_getCursorKind(cursor);
-    if (cursor_kind == CXCursor_CXXMethod)
+    if (facts.kind() == CXCursor_CXXMethod)
     {
         this->_is_member_function = true;
     }
@@ -312,23 +353,38 @@ optional_sentry<T>::~optional_sentry()
     }
 }
 
+/** Selects the files that are parsed and graphed.
+ *
+ *  Files are selected by source file, source directory and source
+ *  tree.  The filter is compiled into a trie of absolute paths, each
+ *  path inserted both as given and with symbolic links resolved, and
+ *  into the device and inode of each source file, so checking a file
+ *  doesn't touch the file system.  Of the selected files, only those
+ *  matching the include patterns, if there are any, and none of the
+ *  exclude patterns are parsed.
+ *
+ *  The decision for a CXFile is cached by its unique ID, which is
+ *  shared by the copies of a filter, so each file is only looked up
+ *  once per run no matter how many translation units include it.
+ */
 class ast_visitor_filter
 {
     public:
 
     ast_visitor_filter() = default;
 
+    /// True if no files were specified, so every file is selected
     bool
-    is_src_dir(const std::filesystem::path & path) const;
-
-    bool
-    in_src_tree(const std::filesystem::path & path) const;
+    empty() const noexcept;
 
+    /// True if file is selected, or no files were specified
     bool
-    is_src_file(const std::filesystem::path & path) const noexcept;
+    parse_file(const std::filesystem::path & file) const;
 
+    /// True if file is selected, or no files were specified.  Source
+    /// files are also matched by libclang's unique ID of file.
     bool
-    parse_file(const std::filesystem::path & file) const;
+    parse_file(CXFile file) const;
 
     void
     push_back_src_dir(const std::filesystem::path & src_dir);
@@ -339,105 +395,229 @@ class ast_visitor_filter
     void
     push_back_src_file(const std::filesystem::path & src_file);
 
+    /// Throws std::invalid_argument if pattern is invalid
+    void
+    push_back_include(std::string_view pattern);
+
+    /// Throws std::invalid_argument if pattern is invalid
+    void
+    push_back_exclude(std::string_view pattern);
+
     private:
-    std::vector<std::filesystem::path> _src_dirs;
-    std::vector<std::filesystem::path> _src_trees;
-    std::vector<std::filesystem::path> _src_files;
+
+    /// Records the working directory when the first filter is added
+    void
+    set_directory();
+
+    /// Inserts path as given and with symbolic links resolved
+    void
+    insert(const std::filesystem::path & path, path_trie::kind kind);
+
+    /// Returns path if it's absolute and lexically normal, otherwise
+    /// stores it made so in buffer and returns that
+    std::string_view
+    normal_path(std::string_view path, std::string & buffer) const;
+
+    /// True if path, made absolute and lexically normal, is in the trie
+    bool
+    contains(std::string_view path) const;
+
+    /// parse_file(CXFile) without the cache
+    bool
+    select(CXFile file, const CXFileUniqueID * id) const;
+
+    struct file_decisions
+    {
+        std::mutex mutex;
+        std::map<std::array<unsigned long long, 3>, bool> selected;
+    };
+
+    // the working directory relative paths are resolved against
+    std::filesystem::path _directory;
+    path_trie _paths;
+    path_matcher _patterns;
+
+    // the device and inode of each source file
+    std::set<std::pair<unsigned long long, unsigned long long>> _file_ids;
+
+    // whether each file seen by libclang is selected, by unique ID
+    std::shared_ptr<file_decisions> _decisions = std::make_shared<file_decisions>();
 };
 
-bool
-ast_visitor_filter::is_src_dir(const std::filesystem::path & file) const
+/// True if an absolute path has "." or ".." components or repeated
+/// separators
+bool needs_normalizing(std::string_view path) noexcept
 {
-    std::filesystem::path src_dir = file;
-    src_dir.remove_filename();
+    return path.find("//") != std::string_view::npos ||
+        path.find("/./") != std::string_view::npos ||
+        path.find("/../") != std::string_view::npos ||
+        path.ends_with("/.") || path.ends_with("/..");
+}
 
-    auto is_src_dir = [&src_dir] (const std::filesystem::path & p) {return std::filesystem::equivalent(src_dir, p);};
-    return (std::find_if(this->_src_dirs.cbegin(), this->_src_dirs.cend(), is_src_dir) != this->_src_dirs.cend());
+bool
+ast_visitor_filter::empty() const noexcept
+{
+    return this->_paths.empty() && this->_patterns.empty();
 }
 
 bool
-ast_visitor_filter::is_src_file(const std::filesystem::path & file) const noexcept
+ast_visitor_filter::parse_file(const std::filesystem::path & file) const
 {
-    auto is_src_file = [&file] (const std::filesystem::path & p) {return std::filesystem::equivalent(file, p);};
-    return (std::find_if(this->_src_files.cbegin(), this->_src_files.cend(), is_src_file) != this->_src_files.cend());
+    if (this->empty())
+    {
+        // no filter was given, so all files should be parsed
+        return true;
+    }
+
+    std::string buffer;
+    const std::string_view path = this->normal_path(file.native(), buffer);
+    return (this->_paths.empty() || this->_paths.contains(path)) && this->_patterns.selects(path);
 }
 
 bool
-ast_visitor_filter::in_src_tree(const std::filesystem::path & path) const
+ast_visitor_filter::parse_file(CXFile file) const
 {
-    for (auto & t: this->_src_trees)
+    if (this->empty())
     {
-        auto ret = std::mismatch(t.begin(), t.end(), path.begin(), path.end());
+        return true;
+    }
 
-        if (ret.first == t.end())
-        {
-            return true;
-        }
+    CXFileUniqueID id;
+    if (clang_getFileUniqueID(file, &id) != 0)
+    {
+        return this->select(file, nullptr);
+    }
 
-        if (std::distance(ret.first, t.end()) == 1 && ret.first->empty())
+    const std::array<unsigned long long, 3> key {id.data[0], id.data[1], id.data[2]};
+    {
+        const std::lock_guard lock(this->_decisions->mutex);
+        const auto i = this->_decisions->selected.find(key);
+        if (i != this->_decisions->selected.end())
         {
-            return true;
+            return i->second;
         }
     }
 
-    return false;
+    const bool selected = this->select(file, &id);
+
+    const std::lock_guard lock(this->_decisions->mutex);
+    this->_decisions->selected.emplace(key, selected);
+    return selected;
+}
+
+bool
+ast_visitor_filter::select(CXFile file, const CXFileUniqueID * id) const
+{
+    // patterns match the name the file was included by
+    ngclang::string_t name {clang_getFileName(file)};
+    const char * file_name = clang_getCString(name.get());
+    if (!file_name)
+    {
+        return false;
+    }
+
+    std::string buffer;
+    if (!this->_patterns.selects(this->normal_path(file_name, buffer)))
+    {
+        return false;
+    }
+
+    if (this->_paths.empty() || (id && this->_file_ids.contains({id->data[0], id->data[1]})))
+    {
+        return true;
+    }
+
+    // libclang has the real path of files it opened
+    ngclang::string_t real_path {clang_File_tryGetRealPathName(file)};
+    const char * real_path_name = clang_getCString(real_path.get());
+    if (real_path_name && *real_path_name && this->contains(real_path_name))
+    {
+        return true;
+    }
+
+    return this->contains(file_name);
 }
 
 void
 ast_visitor_filter::push_back_src_dir(const std::filesystem::path & src_dir)
 {
-    this->_src_dirs.push_back(src_dir);
+    this->insert(src_dir, path_trie::kind::directory);
 }
 
 void
 ast_visitor_filter::push_back_src_tree(const std::filesystem::path & src_tree)
 {
-    this->_src_trees.push_back(src_tree);
+    this->insert(src_tree, path_trie::kind::tree);
 }
 
 void
 ast_visitor_filter::push_back_src_file(const std::filesystem::path & file)
 {
-    this->_src_files.push_back(file);
+    this->insert(file, path_trie::kind::file);
+
+    struct stat status;
+    if (::stat(file.c_str(), &status) == 0)
+    {
+        this->_file_ids.emplace(status.st_dev, status.st_ino);
+    }
+}
+
+void
+ast_visitor_filter::push_back_include(std::string_view pattern)
+{
+    this->_patterns.add(pattern, path_matcher::kind::include);
+    this->set_directory();
 }
 
-bool
-ast_visitor_filter::parse_file(const std::filesystem::path & file) const
+void
+ast_visitor_filter::push_back_exclude(std::string_view pattern)
 {
-    std::optional<bool> match_found;
+    this->_patterns.add(pattern, path_matcher::kind::exclude);
+    this->set_directory();
+}
 
-    if (!this->_src_files.empty())
+void
+ast_visitor_filter::set_directory()
+{
+    if (this->_directory.empty())
     {
-        match_found = this->is_src_file(file);
+        this->_directory = std::filesystem::current_path();
     }
+}
 
-    if (match_found && *match_found)
-    {
-        return true;
-    }
+void
+ast_visitor_filter::insert(const std::filesystem::path & path, path_trie::kind kind)
+{
+    this->set_directory();
 
-    if (!this->_src_dirs.empty())
-    {
-        match_found = this->is_src_dir(file);
-    }
+    const std::filesystem::path absolute = (this->_directory / path).lexically_normal();
+    this->_paths.insert(absolute.native(), kind);
 
-    if (match_found && *match_found)
+    std::error_code ec;
+    const std::filesystem::path canonical = std::filesystem::weakly_canonical(absolute, ec);
+    if (!ec && canonical != absolute)
     {
-        return true;
+        this->_paths.insert(canonical.native(), kind);
     }
+}
 
-    if (!this->_src_trees.empty())
+std::string_view
+ast_visitor_filter::normal_path(std::string_view path, std::string & buffer) const
+{
+    if (path.starts_with('/') && !needs_normalizing(path))
     {
-        match_found = this->in_src_tree(file);
+        return path;
     }
 
-    if (match_found)
-    {
-        return *match_found;
-    }
+    buffer = (this->_directory / path).lexically_normal().native();
+    return buffer;
+}
 
-    // no filter was given, so all files should be parsed
-    return true;
+bool
+ast_visitor_filter::contains(std::string_view path) const
+{
+    std::string buffer;
+    return this->_paths.contains(this->normal_path(path, buffer));
 }
 
 class ast_visitor_policy
@@ -468,12 +648,34 @@ class ast_visitor_policy
     void
     ancestor_match(CXCursorKind) noexcept;
 
+    /// True if function bodies are skipped, so no calls are graphed
+    bool
+    structure_only() const noexcept;
+
+    void
+    structure_only(bool structure_only) noexcept;
+
+    /// True if files are parsed on their own, without the files they
+    /// include, so calls that can't be resolved are graphed to
+    /// placeholder nodes
+    bool
+    single_file() const noexcept;
+
+    void
+    single_file(bool single_file) noexcept;
+
+    /// The flags translation units are parsed with
+    unsigned
+    parse_options() const noexcept;
+
     private:
 
     ast_visitor_filter _filter;
     bool _print_ast = false;
     bool _graph_raw = false;
     std::optional<CXCursorKind> _ancestor_match;
+    bool _structure_only = false;
+    bool _single_file = false;
 };
 
 const ast_visitor_filter &
@@ -524,168 +726,45 @@ ast_visitor_policy::ancestor_match(CXCursorKind kind) noexcept
     this->_ancestor_match = kind;
 }
 
-void
-function_labels(CXCursor cursor,
-                std::string * label,
-                std::string * decl_label,
-                std::string * def_label)
+bool
+ast_visitor_policy::structure_only() const noexcept
 {
-    const CXCursorKind cursor_kind = clang_getCursorKind(cursor);
-    switch (cursor_kind)
-    {
-        case CXCursor_FunctionDecl:
-        {
-            if (label)
-            {
-                *label = "Function";
-            }
-            if (decl_label)
-            {
-                *decl_label = "FunctionDeclaration";
-            }
-            if (def_label)
-            {
-                *def_label = "FunctionDefinition";
-            }
-
-            break;
-        }
-        case CXCursor_FunctionTemplate:
-        {
-            CXCursor semantic_parent = clang_getCursorSemanticParent(cursor);
-            if (!clang_Cursor_isNull(semantic_parent))
-            {
-                const auto parent_kind = clang_getCursorKind(semantic_parent);
-                switch(parent_kind)
-                {
-                    case CXCursor_ClassDecl:
-                    {
-                        if (label)
-                        {
-                            *label = "MemberFunction";
-                        }
-                        if (decl_label)
-                        {
-                            *decl_label = "MemberFunctionDeclaration";
-                        }
-                        if (def_label)
-                        {
-                            *def_label = "MemberFunctionDefinition";
-                        }
-
-                        break;
-                    }
-                    case CXCursor_ClassTemplate:
-                    {
-                        if (label)
-                        {
-                            *label = "MemberFunction";
-                        }
-                        if (decl_label)
-                        {
-                            *decl_label = "MemberFunctionDeclaration";
-                        }
-                        if (def_label)
-                        {
-                            *def_label = "MemberFunctionDefinition";
-                        }
-
-                        break;
-                    }
-                    default:
-                    {
-                        if (label)
-                        {
-                            *label = "Function";
-                        }
-                        if (decl_label)
-                        {
-                            *decl_label = "FunctionDeclaration";
-                        }
-                        if (def_label)
-                        {
-                            *def_label = "FunctionDefinition";
-                        }
+    return this->_structure_only;
+}
 
-                        break;
-                    }
-                }
-            }
-            else
-            {
-                if (label)
-                {
-                    *label = "Function";
-                }
-                if (decl_label)
-                {
-                    *decl_label = "FunctionDeclaration";
-                }
-                if (def_label)
-                {
-                    *def_label = "FunctionDefinition";
-                }
+void
+ast_visitor_policy::structure_only(bool structure_only) noexcept
+{
+    this->_structure_only = structure_only;
+}
 
-            }
+bool
+ast_visitor_policy::single_file() const noexcept
+{
+    return this->_single_file;
+}
 
-            break;
-        }
-        case CXCursor_CXXMethod:
-        {
-            if (label)
-            {
-                *label = "MemberFunction";
-            }
-            if (decl_label)
-            {
-                *decl_label = "MemberFunctionDeclaration";
-            }
-            if (def_label)
-            {
-                *def_label = "MemberFunctionDefinition";
-            }
+void
+ast_visitor_policy::single_file(bool single_file) noexcept
+{
+    this->_single_file = single_file;
+}
 
-            break;
-        }
-        case CXCursor_Constructor:
-        {
-            if (label)
-            {
-                *label = "Constructor";
-            }
-            if (decl_label)
-            {
-                *decl_label = "ConstructorDeclaration";
-            }
-            if (def_label)
-            {
-                *def_label = "ConstructorDefinition";
-            }
+unsigned
+ast_visitor_policy::parse_options() const noexcept
+{
+    unsigned options = CXTranslationUnit_KeepGoing | CXTranslationUnit_IgnoreNonErrorsFromIncludedFiles;
+    if (this->_structure_only)
+    {
+        options |= CXTranslationUnit_SkipFunctionBodies;
+    }
 
-            break;
-        }
-        case CXCursor_Destructor:
-        {
-            if (label)
-            {
-                *label = "Destructor";
-            }
-            if (decl_label)
-            {
-                *decl_label = "DestructorDeclaration";
-            }
-            if (def_label)
-            {
-                *def_label = "DestructorDefinition";
-            }
+    if (this->_single_file)
+    {
+        options |= CXTranslationUnit_SingleFileParse;
+    }
 
-            break;
-        }
-        default:
-        {
-            throw std::logic_error("not a function");
-        }
-    };
+    return options;
 }
 
 class ast_visitor
@@ -693,8 +772,9 @@ class ast_visitor
     public:
 
     explicit
-    ast_visitor(std::reference_wrapper<mg::Client> client,
-                std::optional<std::reference_wrapper<const ast_visitor_policy>> policy = std::nullopt);
+    ast_visitor(std::reference_wrapper<ngmg::connection> connection,
+                std::optional<std::reference_wrapper<const ast_visitor_policy>> policy = std::nullopt,
+                std::optional<std::reference_wrapper<graphed_files>> graphed = std::nullopt);
 
     static
     CXChildVisitResult
@@ -703,8 +783,30 @@ class ast_visitor
     std::string
     fully_qualified_namespace() const;
 
+    /// Adds the headers graphed by this visitor to the graphed files.
+    /// Call once the whole translation unit is visited.
+    void
+    record_graphed_files();
+
+    /// Graphs the cursors in file like those of the main file, whether
+    /// or not an earlier translation unit graphed it
+    void
+    add_source(CXFile file);
+
     private:
 
+    /** True if the cursor is in a file the filter doesn't select or
+     *  in a header that an earlier translation unit has already
+     *  graphed.
+     *
+     *  A graphed file is only skipped outside function definitions.
+     *  One that's included in a function's body, like an .inc or .def
+     *  file, holds calls of that function, which the earlier
+     *  translation unit graphed for its own function.
+     */
+    bool
+    skip_file(ngclang::cursor_facts & facts);
+
     CXChildVisitResult
     graph (CXCursor cursor,
            CXCursor parent_cursor);
@@ -714,29 +816,34 @@ class ast_visitor
               CXCursor parent_cursor);
 
     bool
-    graph_parent(CXCursor cursor,
+    graph_parent(ngclang::cursor_facts & facts,
                  CXCursor parent_cursor);
 
     bool
     graph_namespace(vector_sentry<name_decl> & sentry,
-                    CXCursor cursor,
+                    ngclang::cursor_facts & facts,
                     CXCursor parent_cursor);
 
     bool
     graph_function_decl(vector_sentry<function_decl> & function_def_sentry,
-                        CXCursor cursor,
+                        ngclang::cursor_facts & facts,
                         CXCursor parent_cursor);
 
     bool
-    graph_function_call(CXCursor cursor, CXCursor parent_cursor);
+    graph_function_call(ngclang::cursor_facts & facts, CXCursor parent_cursor);
+
+    /// Graphs a call that libclang couldn't resolve to a placeholder
+    /// node for its callee
+    bool
+    graph_unresolved_call(ngclang::cursor_facts & facts);
 
     bool
     graph_class_decl(vector_sentry<name_decl> & name_sentry,
-                     CXCursor cursor,
+                     ngclang::cursor_facts & facts,
                      CXCursor parent_cursor);
 
     bool
-    graph_base_class_specifier(CXCursor, CXCursor parent_cursor);
+    graph_base_class_specifier(ngclang::cursor_facts &, CXCursor parent_cursor);
 
     /** Performs the following actions
      *  - creates the member function declaration
@@ -745,82 +852,180 @@ class ast_visitor
      */
     bool
     graph_member_function_decl(vector_sentry<function_decl> & function_def_sentry,
-                               CXCursor cursor,
+                               ngclang::cursor_facts & facts,
                                CXCursor parent_cursor);
 
     bool
     graph_constructor(vector_sentry<function_decl> & ctor_def_sentry,
-                      CXCursor cursor,
+                      ngclang::cursor_facts & facts,
                       CXCursor parent_cursor);
 
     bool
     graph_destructor(vector_sentry<function_decl> & dtor_def_sentry,
-                      CXCursor cursor,
+                      ngclang::cursor_facts & facts,
                       CXCursor parent_cursor);
 
+    /// Graphs the function and its declaration or definition, created
+    /// is set if the declaration or definition wasn't graphed before
     bool
-    graph_function(CXCursor cursor,
+    graph_function(ngclang::cursor_facts & facts,
                    CXCursor parent_cursor,
                    vector_sentry<function_decl> & function_def_sentry,
                    bool & created);
 
     std::vector<name_decl> _names;
-    mg::Client * const _mgclient = nullptr;
+    ngmg::connection * const _connection = nullptr;
     ast_visitor_policy const * _policy = nullptr;
     std::vector<function_decl> _function_definitions;
     std::vector<ngclang::cursor_location> _ancestor_matches;
     unsigned int _level = 0;
+
+    // nodes reused by graph_raw for each cursor it visits
+    raw_node _raw_node;
+    raw_node _raw_parent_node;
+    raw_node _raw_lexical_parent_node;
+    raw_node _raw_semantic_parent_node;
+    raw_node _raw_ref_node;
+
+    graphed_files * _graphed_files = nullptr;
+    // why the cursors of each file in this translation unit are skipped
+    enum class file_skip
+    {
+        none,
+        filtered,
+        graphed
+    };
+
+    std::unordered_map<CXFile, file_skip> _skip_files;
+    std::vector<graphed_files::file_id> _visited_files;
+
+    // the files graphed like the main file
+    std::vector<CXFile> _sources;
 };
 
-ast_visitor::ast_visitor(std::reference_wrapper<mg::Client> mgclient,
-                         std::optional<std::reference_wrapper<const ast_visitor_policy>> policy):
-    _mgclient(&mgclient.get())
+ast_visitor::ast_visitor(std::reference_wrapper<ngmg::connection> connection,
+                         std::optional<std::reference_wrapper<const ast_visitor_policy>> policy,
+                         std::optional<std::reference_wrapper<graphed_files>> graphed):
+    _connection(&connection.get())
 {
     if (policy)
     {
         this->_policy = &policy->get();
     }
+
+    if (graphed)
+    {
+        this->_graphed_files = &graphed->get();
+    }
 }
 
-CXChildVisitResult
-ast_visitor::graph(CXCursor cursor, CXCursor parent_cursor, CXClientData client_data)
+void
+ast_visitor::record_graphed_files()
 {
-    ast_visitor & visitor = *(reinterpret_cast<ast_visitor *>(client_data));
-    visitor.graph(cursor, parent_cursor);
-    return CXChildVisit_Continue;
+    if (this->_graphed_files)
+    {
+        this->_graphed_files->insert(this->_visited_files);
+    }
 }
 
-CXChildVisitResult
-ast_visitor::graph_raw(CXCursor cursor, CXCursor parent_cursor)
+void
+ast_visitor::add_source(CXFile file)
 {
-    static raw_node node;
-
-    node.clear_sets();
-    node.fill_match_props(cursor);
-    const bool node_exists = ngmg::cypher::node_return(*this->_mgclient,
-                                                       node.match_property_tuple(),
-                                                       std::tie(node.visited_property));
+    this->_sources.push_back(file);
+}
 
-    if (node_exists && node.visited_property.value())
+bool
+ast_visitor::skip_file(ngclang::cursor_facts & facts)
+{
+    const ast_visitor_filter * filter = (this->_policy && !this->_policy->filter().empty()) ?
+        &this->_policy->filter() :
+        nullptr;
+    if (!this->_graphed_files && !filter)
     {
-        // cursor is already graphed and visited
-        return CXChildVisit_Continue;
+        return false;
     }
 
-    node.visited_property.value(true);
+    CXFile file = facts.file();
+    if (!file)
+    {
+        return false;
+    }
 
-    if (!node_exists)
+    const bool in_function = !this->_function_definitions.empty();
+    const auto [i, inserted] = this->_skip_files.try_emplace(file, file_skip::none);
+    if (!inserted)
     {
-        // node doesn't exist, so create it
-        node.fill_non_match_props(cursor);
-        ngmg::cypher::create_node(*this->_mgclient,
-                                  node.label_set,
-                                  node.property_tuple(),
-                                  node.property_set);
+        return i->second == file_skip::filtered || (i->second == file_skip::graphed && !in_function);
+    }
+
+    if (filter && !filter->parse_file(file))
+    {
+        i->second = file_skip::filtered;
+        return true;
+    }
+
+    if (!this->_graphed_files || clang_Location_isFromMainFile(facts.source_location()) ||
+        std::ranges::any_of(this->_sources, [file] (CXFile source) { return clang_File_isEqual(source, file); }))
+    {
+        return false;
+    }
+
+    const auto id = graphed_files::identify(clang_Cursor_getTranslationUnit(facts.cursor()), file);
+    if (!id)
+    {
+        return false;
+    }
+
+    if (this->_graphed_files->contains(*id))
+    {
+        i->second = file_skip::graphed;
+        return !in_function;
+    }
+
+    this->_visited_files.push_back(*id);
+    return false;
+}
+
+CXChildVisitResult
+ast_visitor::graph(CXCursor cursor, CXCursor parent_cursor, CXClientData client_data)
+{
+    ast_visitor & visitor = *(reinterpret_cast<ast_visitor *>(client_data));
+    visitor.graph(cursor, parent_cursor);
+    return CXChildVisit_Continue;
+}
+
+CXChildVisitResult
+ast_visitor::graph_raw(CXCursor cursor, CXCursor parent_cursor)
+{
+    raw_node & node = this->_raw_node;
+
+    node.clear_sets();
+    node.fill_match_props(cursor);
+    const bool node_exists = ngmg::cypher::node_return(*this->_connection,
+                                                       node.match_property_tuple(),
+                                                       std::tie(node.visited_property));
+
+    if (node_exists && node.visited_property.value())
+    {
+        // cursor is already graphed and visited
+        return CXChildVisit_Continue;
+    }
+
+    node.visited_property.value(true);
+
+    if (!node_exists)
+    {
+        // node doesn't exist, so create it
+        node.fill_non_match_props(cursor);
+        ngmg::cypher::merge_node(*this->_connection,
+                                 node.label_set,
+                                 node.match_property_tuple(),
+                                 node.property_tuple(),
+                                 node.property_set);
     }
     else
     {
-        ngmg::cypher::match_set(*this->_mgclient,
+        ngmg::cypher::match_set(*this->_connection,
                                 node.match_property_tuple(),
                                 std::tie(node.visited_property));
     }
@@ -829,33 +1034,34 @@ ast_visitor::graph_raw(CXCursor cursor, CXCursor parent_cursor)
         // Handle parents
 
         {
-            static raw_node parent_node;
+            raw_node & parent_node = this->_raw_parent_node;
             static const ngmg::cypher::label parent_label("PARENT");
 
             parent_node.clear_sets();
             parent_node.fill_match_props(parent_cursor);
             const bool parent_exists =
-                ngmg::cypher::node_exists(*this->_mgclient,
+                ngmg::cypher::node_exists(*this->_connection,
                                           parent_node.match_property_tuple());
 
             if (!parent_exists)
             {
                 parent_node.visited_property.value(false);
                 parent_node.fill_non_match_props(parent_cursor);
-                ngmg::cypher::create_node(*this->_mgclient,
-                                          parent_node.label_set,
-                                          parent_node.property_tuple(),
-                                          parent_node.property_set);
+                ngmg::cypher::merge_node(*this->_connection,
+                                         parent_node.label_set,
+                                         parent_node.match_property_tuple(),
+                                         parent_node.property_tuple(),
+                                         parent_node.property_set);
             }
 
-            ngmg::cypher::merge_relate(*this->_mgclient,
+            ngmg::cypher::merge_relate(*this->_connection,
                                        parent_label,
                                        node.match_property_tuple(),
                                        parent_node.match_property_tuple());
         }
 
         {
-            static raw_node lexical_parent_node;
+            raw_node & lexical_parent_node = this->_raw_lexical_parent_node;
             static const ngmg::cypher::label parent_label("LEXICAL_PARENT");
 
             CXCursor lexical_parent_cursor = clang_getCursorLexicalParent(cursor);
@@ -864,7 +1070,7 @@ ast_visitor::graph_raw(CXCursor cursor, CXCursor parent_cursor)
                 lexical_parent_node.clear_sets();
                 lexical_parent_node.fill_match_props(lexical_parent_cursor);
                 const bool lexical_parent_exists =
-                    ngmg::cypher::node_exists(*this->_mgclient,
+                    ngmg::cypher::node_exists(*this->_connection,
                                               lexical_parent_node.match_property_tuple());
 
 
@@ -873,13 +1079,14 @@ ast_visitor::graph_raw(CXCursor cursor, CXCursor parent_cursor)
                     // add lexical parent
                     lexical_parent_node.visited_property.value(false);
                     lexical_parent_node.fill_non_match_props(lexical_parent_cursor);
-                    ngmg::cypher::create_node(*this->_mgclient,
-                                              lexical_parent_node.label_set,
-                                              lexical_parent_node.property_tuple(),
-                                              lexical_parent_node.property_set);
+                    ngmg::cypher::merge_node(*this->_connection,
+                                             lexical_parent_node.label_set,
+                                             lexical_parent_node.match_property_tuple(),
+                                             lexical_parent_node.property_tuple(),
+                                             lexical_parent_node.property_set);
                 }
 
-                ngmg::cypher::merge_relate(*this->_mgclient,
+                ngmg::cypher::merge_relate(*this->_connection,
                                            parent_label,
                                            node.match_property_tuple(),
                                            lexical_parent_node.match_property_tuple());
@@ -887,7 +1094,7 @@ ast_visitor::graph_raw(CXCursor cursor, CXCursor parent_cursor)
         }
 
         {
-            static raw_node semantic_parent_node;
+            raw_node & semantic_parent_node = this->_raw_semantic_parent_node;
             static const ngmg::cypher::label parent_label("SEMANTIC_PARENT");
 
             CXCursor semantic_parent_cursor = clang_getCursorSemanticParent(cursor);
@@ -896,7 +1103,7 @@ ast_visitor::graph_raw(CXCursor cursor, CXCursor parent_cursor)
                 semantic_parent_node.clear_sets();
                 semantic_parent_node.fill_match_props(semantic_parent_cursor);
                 const bool semantic_parent_exists =
-                    ngmg::cypher::node_exists(*this->_mgclient,
+                    ngmg::cypher::node_exists(*this->_connection,
                                               semantic_parent_node.match_property_tuple());
 
                 if (!semantic_parent_exists)
@@ -904,13 +1111,14 @@ ast_visitor::graph_raw(CXCursor cursor, CXCursor parent_cursor)
                     // add semantic parent
                     semantic_parent_node.visited_property.value(false);
                     semantic_parent_node.fill_non_match_props(semantic_parent_cursor);
-                    ngmg::cypher::create_node(*this->_mgclient,
-                                              semantic_parent_node.label_set,
-                                              semantic_parent_node.property_tuple(),
-                                              semantic_parent_node.property_set);
+                    ngmg::cypher::merge_node(*this->_connection,
+                                             semantic_parent_node.label_set,
+                                             semantic_parent_node.match_property_tuple(),
+                                             semantic_parent_node.property_tuple(),
+                                             semantic_parent_node.property_set);
                 }
 
-                ngmg::cypher::merge_relate(*this->_mgclient,
+                ngmg::cypher::merge_relate(*this->_connection,
                                            parent_label,
                                            node.match_property_tuple(),
                                            semantic_parent_node.match_property_tuple());
@@ -923,12 +1131,12 @@ ast_visitor::graph_raw(CXCursor cursor, CXCursor parent_cursor)
     CXCursor ref_cursor = clang_getCursorReferenced(cursor);
     if (!clang_Cursor_isNull(ref_cursor) && !clang_equalCursors(cursor, ref_cursor))
     {
-        static raw_node ref_node;
+        raw_node & ref_node = this->_raw_ref_node;
 
         ref_node.clear_sets();
         ref_node.fill_match_props(ref_cursor);
 
-        const bool ref_node_exists = ngmg::cypher::node_exists(*this->_mgclient,
+        const bool ref_node_exists = ngmg::cypher::node_exists(*this->_connection,
                                                                ref_node.match_property_tuple());
 
         if (!ref_node_exists)
@@ -955,14 +1163,15 @@ ast_visitor::graph_raw(CXCursor cursor, CXCursor parent_cursor)
             // never visited by matching all nodes whose 'visited'
             // property is set to false.
 
-            ngmg::cypher::create_node(*this->_mgclient,
-                                      ref_node.label_set,
-                                      ref_node.property_tuple(),
-                                      ref_node.property_set);
+            ngmg::cypher::merge_node(*this->_connection,
+                                     ref_node.label_set,
+                                     ref_node.match_property_tuple(),
+                                     ref_node.property_tuple(),
+                                     ref_node.property_set);
         }
 
         static const ngmg::cypher::label references_label("REFERENCES");
-        ngmg::cypher::merge_relate(*this->_mgclient,
+        ngmg::cypher::merge_relate(*this->_connection,
                                    references_label,
                                    node.match_property_tuple(),
                                    ref_node.match_property_tuple());
@@ -976,18 +1185,24 @@ ast_visitor::graph_raw(CXCursor cursor, CXCursor parent_cursor)
 CXChildVisitResult
 ast_visitor::graph(CXCursor cursor, CXCursor parent_cursor)
 {
-    if(clang_Location_isInSystemHeader( clang_getCursorLocation( cursor ) ) != 0 )
+    // Asked for once however many of the graph functions need them
+    ngclang::cursor_facts facts {cursor};
+
+    if(clang_Location_isInSystemHeader( facts.source_location() ) != 0 )
+    {
+        return CXChildVisit_Continue;
+    }
+
+    if (this->skip_file(facts))
     {
         return CXChildVisit_Continue;
     }
 
-    const CXCursorKind cursor_kind = clang_getCursorKind(cursor);
+    const CXCursorKind cursor_kind = facts.kind();
     vector_sentry<ngclang::cursor_location> ancestor_matches_sentry(std::ref(this->_ancestor_matches));
 
     if (this->_policy)
     {
-        const ngclang::cursor_location cursor_loc {cursor};
-
         if (this->_policy->print_ast())
         {
             ::print_cursor(cursor, parent_cursor, this->_level);
@@ -1010,7 +1225,7 @@ ast_visitor::graph(CXCursor cursor, CXCursor parent_cursor)
 
             if (cursor_kind == this->_policy->ancestor_match().value())
             {
-                ancestor_matches_sentry.push(cursor_loc);
+                ancestor_matches_sentry.push(facts.location());
             }
         }
 
@@ -1027,7 +1242,7 @@ ast_visitor::graph(CXCursor cursor, CXCursor parent_cursor)
     {
         case CXCursor_Namespace:
         {
-            if (!this->graph_namespace(name_sentry, cursor, parent_cursor))
+            if (!this->graph_namespace(name_sentry, facts, parent_cursor))
             {
                 return CXChildVisit_Break;
             }
@@ -1036,7 +1251,7 @@ ast_visitor::graph(CXCursor cursor, CXCursor parent_cursor)
         }
         case CXCursor_FunctionDecl:
         {
-            if (!this->graph_function_decl(function_def_sentry, cursor, parent_cursor))
+            if (!this->graph_function_decl(function_def_sentry, facts, parent_cursor))
             {
                 return CXChildVisit_Break;
             }
@@ -1045,7 +1260,7 @@ ast_visitor::graph(CXCursor cursor, CXCursor parent_cursor)
         }
         case CXCursor_FunctionTemplate:
         {
-            if (!this->graph_function_decl(function_def_sentry, cursor, parent_cursor))
+            if (!this->graph_function_decl(function_def_sentry, facts, parent_cursor))
             {
                 return CXChildVisit_Break;
             }
@@ -1053,7 +1268,26 @@ ast_visitor::graph(CXCursor cursor, CXCursor parent_cursor)
         }
         case CXCursor_CallExpr:
         {
-            if (!this->graph_function_call(cursor, parent_cursor))
+            if (this->_policy && this->_policy->structure_only())
+            {
+                break;
+            }
+
+            if (!this->graph_function_call(facts, parent_cursor))
+            {
+                return CXChildVisit_Break;
+            }
+
+            break;
+        }
+        case CXCursor_UnexposedExpr:
+        {
+            if (!this->_policy || !this->_policy->single_file() || !ngclang::is_recovered_call(cursor))
+            {
+                break;
+            }
+
+            if (!this->graph_unresolved_call(facts))
             {
                 return CXChildVisit_Break;
             }
@@ -1062,7 +1296,7 @@ ast_visitor::graph(CXCursor cursor, CXCursor parent_cursor)
         }
         case CXCursor_ClassDecl:
         {
-            if (!this->graph_class_decl(name_sentry, cursor, parent_cursor))
+            if (!this->graph_class_decl(name_sentry, facts, parent_cursor))
             {
                 return CXChildVisit_Break;
             }
@@ -1071,7 +1305,7 @@ ast_visitor::graph(CXCursor cursor, CXCursor parent_cursor)
         }
         case CXCursor_ClassTemplate:
         {
-            if (!this->graph_class_decl(name_sentry, cursor, parent_cursor))
+            if (!this->graph_class_decl(name_sentry, facts, parent_cursor))
             {
                 return CXChildVisit_Break;
             }
@@ -1079,7 +1313,7 @@ ast_visitor::graph(CXCursor cursor, CXCursor parent_cursor)
         }
         case CXCursor_CXXMethod:
         {
-            if (!this->graph_member_function_decl(function_def_sentry, cursor, parent_cursor))
+            if (!this->graph_member_function_decl(function_def_sentry, facts, parent_cursor))
             {
                 return CXChildVisit_Break;
             }
@@ -1088,7 +1322,7 @@ ast_visitor::graph(CXCursor cursor, CXCursor parent_cursor)
         }
         case CXCursor_Constructor:
         {
-            if (!this->graph_constructor(function_def_sentry, cursor, parent_cursor))
+            if (!this->graph_constructor(function_def_sentry, facts, parent_cursor))
             {
                 return CXChildVisit_Break;
             }
@@ -1097,7 +1331,7 @@ ast_visitor::graph(CXCursor cursor, CXCursor parent_cursor)
         }
         case CXCursor_Destructor:
         {
-            if (!this->graph_destructor(function_def_sentry, cursor, parent_cursor))
+            if (!this->graph_destructor(function_def_sentry, facts, parent_cursor))
             {
                 return CXChildVisit_Break;
             }
@@ -1106,7 +1340,7 @@ ast_visitor::graph(CXCursor cursor, CXCursor parent_cursor)
         }
         case CXCursor_CXXBaseSpecifier:
         {
-            if (!this->graph_base_class_specifier(cursor, parent_cursor))
+            if (!this->graph_base_class_specifier(facts, parent_cursor))
             {
                 return CXChildVisit_Break;
             }
@@ -1126,11 +1360,12 @@ ast_visitor::graph(CXCursor cursor, CXCursor parent_cursor)
 }
 
 bool
-ast_visitor::graph_parent(CXCursor cursor, CXCursor parent_cursor)
+ast_visitor::graph_parent(ngclang::cursor_facts & facts, CXCursor parent_cursor)
 {
-    const universal_symbol_reference_property cursor_usr {cursor};
-    const auto parent_usr = [&cursor, &parent_cursor]() {
-        CXCursor semantic_parent = clang_getCursorSemanticParent(cursor);
+    universal_symbol_reference_property cursor_usr;
+    cursor_usr.prop = facts.universal_symbol_reference();
+    const auto parent_usr = [&facts, &parent_cursor]() {
+        CXCursor semantic_parent = facts.semantic_parent();
         if (clang_Cursor_isNull(semantic_parent))
         {
             return universal_symbol_reference_property {parent_cursor};
@@ -1146,28 +1381,39 @@ ast_visitor::graph_parent(CXCursor cursor, CXCursor parent_cursor)
         return true;
     }
 
-    if (ngmg::cypher::relationship_exists(*this->_mgclient,
+    // Each file that declares the cursor has its own relationship, so
+    // it's removed with the file's other nodes and relationships.
+    location_properties cursor_loc;
+    cursor_loc.fill(facts.location());
+    if (ngmg::cypher::relationship_exists(*this->_connection,
                                           has_label,
                                           parent_usr.tuple(),
-                                          cursor_usr.tuple()))
+                                          cursor_usr.tuple(),
+                                          ngmg::cypher::relationship_type::directed,
+                                          std::tie(cursor_loc.file_prop)))
     {
         return true;
     }
 
-    ngmg::cypher::create_relate(*this->_mgclient,
+    ngmg::cypher::create_relate(*this->_connection,
                                 has_label,
                                 parent_usr.tuple(),
-                                cursor_usr.tuple());
+                                cursor_usr.tuple(),
+                                ngmg::cypher::relationship_type::directed,
+                                std::tie(cursor_loc.file_prop));
     return true;
 }
 
 bool
-ast_visitor::graph_namespace(vector_sentry<name_decl> & name_sentry, CXCursor cursor, CXCursor parent_cursor)
+ast_visitor::graph_namespace(vector_sentry<name_decl> & name_sentry,
+                             ngclang::cursor_facts & facts,
+                             CXCursor parent_cursor)
 {
+    const CXCursor cursor = facts.cursor();
     namespace_decl_node namespace_decl;
-    namespace_decl.location.fill(cursor);
+    namespace_decl.location.fill(facts.location());
 
-    if (ngmg::cypher::node_exists(*this->_mgclient,
+    if (ngmg::cypher::node_exists(*this->_connection,
                                   namespace_decl.label(),
                                   namespace_decl.location.tuple()))
     {
@@ -1177,104 +1423,112 @@ ast_visitor::graph_namespace(vector_sentry<name_decl> & name_sentry, CXCursor cu
     name_sentry.push(name_decl{ngclang::to_string(cursor, &clang_getCursorDisplayName)});
     namespace_decl.names.fill_with_fq_name(cursor, this->fully_qualified_namespace());
 
-    ngmg::cypher::create_node(*this->_mgclient,
-                              namespace_decl.label(),
-                              namespace_decl.tuple());
+    ngmg::cypher::merge_node(*this->_connection,
+                             namespace_decl.label(),
+                             namespace_decl.location.tuple(),
+                             namespace_decl.tuple());
 
     namespace_node namespace_node;
-    namespace_node.usr.fill(cursor);
-    if (!ngmg::cypher::node_exists(*this->_mgclient,
+    namespace_node.usr.prop = facts.universal_symbol_reference();
+    if (!ngmg::cypher::node_exists(*this->_connection,
                                    namespace_node.label(),
                                    namespace_node.usr.tuple()))
     {
         namespace_node.names.fill_with_fq_name(cursor, this->fully_qualified_namespace());
-        ngmg::cypher::create_node(*this->_mgclient,
-                                  namespace_node.label(),
-                                  namespace_node.tuple());
+        ngmg::cypher::merge_node(*this->_connection,
+                                 namespace_node.label(),
+                                 namespace_node.usr.tuple(),
+                                 namespace_node.tuple());
     }
 
-    ngmg::cypher::create_relate(*this->_mgclient,
+    ngmg::cypher::create_relate(*this->_connection,
                                 declares_label,
                                 namespace_decl.location.tuple(),
                                 namespace_decl.label(),
                                 namespace_node.usr.tuple(),
                                 namespace_node.label());
 
-    return this->graph_parent(cursor, parent_cursor);
+    return this->graph_parent(facts, parent_cursor);
 }
 
 bool
-ast_visitor::graph_function(CXCursor cursor,
+ast_visitor::graph_function(ngclang::cursor_facts & facts,
                             CXCursor parent_cursor,
                             vector_sentry<function_decl> & function_def_sentry,
                             bool & created)
 {
+    const CXCursor cursor = facts.cursor();
     created = false;
     std::string function_label;
     std::string function_dec_label;
     std::string function_def_label;
-    function_labels(cursor, &function_label, &function_dec_label, &function_def_label);
+    function_labels(facts, &function_label, &function_dec_label, &function_def_label);
 
     function_node func_node {function_label};
-    func_node.usr.fill(cursor);
+    func_node.usr.prop = facts.universal_symbol_reference();
 
-    if (!ngmg::cypher::node_exists(*this->_mgclient,
+    if (!ngmg::cypher::node_exists(*this->_connection,
                                    func_node.label(),
                                    func_node.usr.tuple()))
     {
-        func_node.is_template.fill(cursor);
+        func_node.is_template.fill(facts.kind());
         func_node.names.fill_with_fq_namespace(cursor, this->fully_qualified_namespace());
-        ngmg::cypher::create_node(*this->_mgclient,
-                                  func_node.label(),
-                                  func_node.tuple());
-        created = true;
+        ngmg::cypher::merge_node(*this->_connection,
+                                 func_node.label(),
+                                 func_node.usr.tuple(),
+                                 func_node.tuple());
     }
 
-    if (clang_isCursorDefinition(cursor))
+    if (clang_isCursorDefinition(cursor) ||
+        (this->_policy && this->_policy->structure_only() && ngclang::has_skipped_body(cursor)))
     {
-        function_decl function_def {cursor};
+        function_decl function_def {facts};
         function_def_sentry.push(function_def);
 
         function_decl_def_node func_def_node {function_def_label};
-        func_def_node.location.fill(cursor);
+        func_def_node.location.fill(function_def.location());
 
-        if (!ngmg::cypher::node_exists(*this->_mgclient,
+        if (!ngmg::cypher::node_exists(*this->_connection,
                                        func_def_node.label(),
                                        func_def_node.location.tuple()))
         {
             func_def_node.names.fill_with_fq_namespace(cursor, this->fully_qualified_namespace());
-            ngmg::cypher::create_node(*this->_mgclient,
-                                      func_def_node.label(),
-                                      func_def_node.tuple());
+            ngmg::cypher::merge_node(*this->_connection,
+                                     func_def_node.label(),
+                                     func_def_node.location.tuple(),
+                                     func_def_node.tuple());
 
-            ngmg::cypher::create_relate(*this->_mgclient,
+            ngmg::cypher::create_relate(*this->_connection,
                                         defines_label,
                                         func_def_node.location.tuple(),
                                         func_def_node.label(),
                                         func_node.usr.tuple(),
                                         func_node.label());
+            created = true;
         }
     }
     else
     {
         function_decl_def_node func_decl_node {function_dec_label};
-        func_decl_node.location.fill(cursor);
+        func_decl_node.location.fill(facts.location());
 
-        if (!ngmg::cypher::node_exists(*this->_mgclient,
+        if (!ngmg::cypher::node_exists(*this->_connection,
                                        func_decl_node.label(),
                                        func_decl_node.location.tuple()))
         {
             func_decl_node.names.fill_with_fq_namespace(cursor, this->fully_qualified_namespace());
-            ngmg::cypher::create_node(*this->_mgclient,
-                                      func_decl_node.label(),
-                                      func_decl_node.tuple());
+            ngmg::cypher::merge_node(*this->_connection,
+                                     func_decl_node.label(),
+                                     func_decl_node.location.tuple(),
+                                     func_decl_node.tuple());
 
-            ngmg::cypher::create_relate(*this->_mgclient,
+            ngmg::cypher::create_relate(*this->_connection,
                                         declares_label,
                                         func_decl_node.location.tuple(),
                                         func_decl_node.label(),
                                         func_node.usr.tuple(),
                                         func_node.label());
+            created = true;
         }
     }
 
@@ -1283,45 +1537,52 @@ ast_visitor::graph_function(CXCursor cursor,
 
 bool
 ast_visitor::graph_function_decl(vector_sentry<function_decl> & function_def_sentry,
-                                 CXCursor cursor,
+                                 ngclang::cursor_facts & facts,
                                  CXCursor parent_cursor)
 {
     bool created = false;
-    if (!this->graph_function(cursor, parent_cursor, function_def_sentry, created))
+    if (!this->graph_function(facts, parent_cursor, function_def_sentry, created))
     {
         return false;
     }
 
     if (!created)
     {
-        // function already existed so nothing else to do
+        // declaration already graphed so nothing else to do
         return true;
     }
 
-    return this->graph_parent(cursor, parent_cursor);
+    return this->graph_parent(facts, parent_cursor);
 }
 
 bool
-ast_visitor::graph_function_call(CXCursor cursor, CXCursor parent)
+ast_visitor::graph_function_call(ngclang::cursor_facts & facts, CXCursor parent)
 {
     if (this->_function_definitions.empty())
     {
         return true;
     }
 
-    CXCursor callee_cursor = clang_getCursorReferenced(cursor);
+    CXCursor callee_cursor = clang_getCursorReferenced(facts.cursor());
+
+    if (this->_policy && this->_policy->single_file() &&
+        (clang_Cursor_isNull(callee_cursor) || clang_getCursorKind(callee_cursor) == CXCursor_OverloadedDeclRef))
+    {
+        return this->graph_unresolved_call(facts);
+    }
 
     if (clang_Cursor_isNull(callee_cursor))
     {
         return true;
     }
 
-    const location_properties cursor_loc {cursor};
+    location_properties cursor_loc;
+    cursor_loc.fill(facts.location());
     const universal_symbol_reference_property callee_usr {callee_cursor};
     universal_symbol_reference_property caller_usr;
     caller_usr.prop = this->_function_definitions.back().universal_symbol_reference();
 
-    if (ngmg::cypher::relationship_exists(*this->_mgclient,
+    if (ngmg::cypher::relationship_exists(*this->_connection,
                                           calls_label,
                                           ngmg::cypher::relationship_type::directed,
                                           cursor_loc.tuple()))
@@ -1329,7 +1590,7 @@ ast_visitor::graph_function_call(CXCursor cursor, CXCursor parent)
         return true;
     }
 
-    ngmg::cypher::create_relate(*this->_mgclient,
+    ngmg::cypher::create_relate(*this->_connection,
                                 calls_label,
                                 caller_usr.tuple(),
                                 callee_usr.tuple(),
@@ -1340,11 +1601,63 @@ ast_visitor::graph_function_call(CXCursor cursor, CXCursor parent)
 }
 
 bool
-ast_visitor::graph_class_decl(vector_sentry<name_decl> & name_sentry, CXCursor cursor, CXCursor parent_cursor)
+ast_visitor::graph_unresolved_call(ngclang::cursor_facts & facts)
+{
+    if (this->_function_definitions.empty())
+    {
+        return true;
+    }
+
+    const std::string name = ngclang::unresolved_callee_name(facts.cursor());
+    if (name.empty())
+    {
+        return true;
+    }
+
+    unresolved_function_node callee;
+    callee.fill(name);
+    if (!ngmg::cypher::node_exists(*this->_connection,
+                                   callee.label(),
+                                   callee.usr.tuple()))
+    {
+        ngmg::cypher::merge_node(*this->_connection,
+                                 callee.label(),
+                                 callee.usr.tuple(),
+                                 callee.tuple());
+    }
+
+    location_properties cursor_loc;
+    cursor_loc.fill(facts.location());
+    universal_symbol_reference_property caller_usr;
+    caller_usr.prop = this->_function_definitions.back().universal_symbol_reference();
+
+    if (ngmg::cypher::relationship_exists(*this->_connection,
+                                          calls_label,
+                                          ngmg::cypher::relationship_type::directed,
+                                          cursor_loc.tuple()))
+    {
+        return true;
+    }
+
+    ngmg::cypher::create_relate(*this->_connection,
+                                calls_label,
+                                caller_usr.tuple(),
+                                callee.usr.tuple(),
+                                ngmg::cypher::relationship_type::directed,
+                                cursor_loc.tuple());
+
+    return true;
+}
+
+bool
+ast_visitor::graph_class_decl(vector_sentry<name_decl> & name_sentry,
+                              ngclang::cursor_facts & facts,
+                              CXCursor parent_cursor)
 {
+    const CXCursor cursor = facts.cursor();
     class_decl_node class_decl;
-    class_decl.location.fill(cursor);
-    if (ngmg::cypher::node_exists(*this->_mgclient,
+    class_decl.location.fill(facts.location());
+    if (ngmg::cypher::node_exists(*this->_connection,
                                   class_decl.label(),
                                   class_decl.location.tuple()))
     {
@@ -1354,68 +1667,76 @@ ast_visitor::graph_class_decl(vector_sentry<name_decl> & name_sentry, CXCursor c
     name_sentry.push(name_decl{ngclang::to_string(cursor, &clang_getCursorDisplayName)});
     class_decl.names.fill_with_fq_name(cursor, this->fully_qualified_namespace());
 
-    ngmg::cypher::create_node(*this->_mgclient,
-                              class_decl.label(),
-                              class_decl.tuple());
+    ngmg::cypher::merge_node(*this->_connection,
+                             class_decl.label(),
+                             class_decl.location.tuple(),
+                             class_decl.tuple());
 
     class_node class_node;
-    class_node.usr.fill(cursor);
+    class_node.usr.prop = facts.universal_symbol_reference();
 
-    if (!ngmg::cypher::node_exists(*this->_mgclient,
+    if (!ngmg::cypher::node_exists(*this->_connection,
                                    class_node.label(),
                                    class_node.usr.tuple()))
     {
         class_node.names.fill_with_fq_name(cursor, this->fully_qualified_namespace());
-        class_node.is_template.fill(cursor);
-        ngmg::cypher::create_node(*this->_mgclient,
-                                  class_node.label(),
-                                  class_node.tuple());
+        class_node.is_template.fill(facts.kind());
+        ngmg::cypher::merge_node(*this->_connection,
+                                 class_node.label(),
+                                 class_node.usr.tuple(),
+                                 class_node.tuple());
     }
 
-    ngmg::cypher::create_relate(*this->_mgclient,
+    ngmg::cypher::create_relate(*this->_connection,
                                 declares_label,
                                 class_decl.location.tuple(),
                                 class_decl.label(),
                                 class_node.usr.tuple(),
                                 class_node.label());
 
-    return this->graph_parent(cursor, parent_cursor);
+    return this->graph_parent(facts, parent_cursor);
 }
 
 bool
-ast_visitor::graph_base_class_specifier(CXCursor cursor, CXCursor parent_cursor)
+ast_visitor::graph_base_class_specifier(ngclang::cursor_facts & facts, CXCursor parent_cursor)
 {
-    CXCursor base_cursor = clang_getCursorReferenced(cursor);
+    CXCursor base_cursor = clang_getCursorReferenced(facts.cursor());
     const universal_symbol_reference_property base_usr {base_cursor};
     const universal_symbol_reference_property child_usr {parent_cursor};
+    location_properties specifier_loc;
+    specifier_loc.fill(facts.location());
 
-    if (ngmg::cypher::relationship_exists(*this->_mgclient,
+    if (ngmg::cypher::relationship_exists(*this->_connection,
                                           inherits_label,
                                           child_usr.tuple(),
                                           class_node::label(),
                                           base_usr.tuple(),
-                                          class_node::label()))
+                                          class_node::label(),
+                                          ngmg::cypher::relationship_type::directed,
+                                          std::tie(specifier_loc.file_prop)))
     {
         return true;
     }
 
-    ngmg::cypher::create_relate(*this->_mgclient,
+    ngmg::cypher::create_relate(*this->_connection,
                                 inherits_label,
                                 child_usr.tuple(),
                                 class_node::label(),
                                 base_usr.tuple(),
-                                class_node::label());
+                                class_node::label(),
+                                ngmg::cypher::relationship_type::directed,
+                                std::tie(specifier_loc.file_prop));
 
     return true;
 }
 
 bool
 ast_visitor::graph_member_function_decl(vector_sentry<function_decl> & function_def_sentry,
-                                        CXCursor cursor,
+                                        ngclang::cursor_facts & facts,
                                         CXCursor parent_cursor)
 {
     bool created = false;
-    if (!this->graph_function(cursor, parent_cursor, function_def_sentry, created))
+    if (!this->graph_function(facts, parent_cursor, function_def_sentry, created))
     {
         return false;
     }
@@ -1425,7 +1746,7 @@ ast_visitor::graph_member_function_decl(vector_sentry<function_decl> & function_
         return true;
     }
 
-    if (!this->graph_parent(cursor, parent_cursor))
+    if (!this->graph_parent(facts, parent_cursor))
     {
         return false;
     }
@@ -1433,20 +1754,25 @@ ast_visitor::graph_member_function_decl(vector_sentry<function_decl> & function_
     // Virtual function overrides
     ngclang::overridden_cursors_t overrides;
     unsigned num_overrides;
-    clang_getOverriddenCursors(cursor, &overrides.get(), &num_overrides);
+    clang_getOverriddenCursors(facts.cursor(), &overrides.get(), &num_overrides);
 
-    const universal_symbol_reference_property cursor_usr {cursor};
+    universal_symbol_reference_property cursor_usr;
+    cursor_usr.prop = facts.universal_symbol_reference();
+    location_properties cursor_loc;
+    cursor_loc.fill(facts.location());
     const ngmg::cypher::label member_func_label {"MemberFunction"};
 
     for(unsigned i = 0; i < num_overrides; ++i)
     {
         const universal_symbol_reference_property override_usr {overrides.get()[i]};
-        ngmg::cypher::create_relate(*this->_mgclient,
+        ngmg::cypher::create_relate(*this->_connection,
                                     overrides_label,
                                     cursor_usr.tuple(),
                                     member_func_label,
                                     override_usr.tuple(),
-                                    member_func_label);
+                                    member_func_label,
+                                    ngmg::cypher::relationship_type::directed,
+                                    std::tie(cursor_loc.file_prop));
     }
 
     return true;
@@ -1454,11 +1780,11 @@ ast_visitor::graph_member_function_decl(vector_sentry<function_decl> & function_
 
 bool
 ast_visitor::graph_constructor(vector_sentry<function_decl> & function_def_sentry,
-                               CXCursor cursor,
+                               ngclang::cursor_facts & facts,
                                CXCursor parent_cursor)
 {
     bool created = false;
-    if (!this->graph_function(cursor, parent_cursor, function_def_sentry, created))
+    if (!this->graph_function(facts, parent_cursor, function_def_sentry, created))
     {
         return false;
     }
@@ -1468,16 +1794,16 @@ ast_visitor::graph_constructor(vector_sentry<function_decl> & function_def_sentr
         return true;
     }
 
-    return this->graph_parent(cursor, parent_cursor);
+    return this->graph_parent(facts, parent_cursor);
 }
 
 bool
 ast_visitor::graph_destructor(vector_sentry<function_decl> & function_def_sentry,
-                              CXCursor cursor,
+                              ngclang::cursor_facts & facts,
                               CXCursor parent_cursor)
 {
     bool created = false;
-    if (!this->graph_function(cursor, parent_cursor, function_def_sentry, created))
+    if (!this->graph_function(facts, parent_cursor, function_def_sentry, created))
     {
         return false;
     }
@@ -1487,7 +1813,7 @@ ast_visitor::graph_destructor(vector_sentry<function_decl> & function_def_sentry
         return true;
     }
 
-    return this->graph_parent(cursor, parent_cursor);
+    return this->graph_parent(facts, parent_cursor);
 }
 
 std::string
@@ -1511,149 +1837,1429 @@ ast_visitor::fully_qualified_namespace() const
     return name;
 }
 
-class compile_command
+void parse_file(CXIndex index, const std::string & file, ngmg::connection & connection)
 {
-    public:
-
-    explicit
-    compile_command(CXCompileCommand);
-    compile_command(const std::string & file);
-
-    ~compile_command();
+    ngclang::translation_unit_t unit = 
+        clang_parseTranslationUnit(
+            index, // clang index
+            file.c_str(), // path
+            nullptr, // command line args
+            0, // number of command line args
+            nullptr, // clang unsaved files
+            0, // number of unsaved files
+            CXTranslationUnit_None);
 
-    compile_command(const compile_command &) = delete;
-    compile_command& operator = (const compile_command &) = delete;
+    CXCursor cursor = clang_getTranslationUnitCursor(unit.get());
 
-    char * const *
-    array() const noexcept;
+    ast_visitor visitor(std::ref(connection));
+    clang_visitChildren(cursor, &ast_visitor::graph, &visitor);
+}
 
-    size_t
-    size() const noexcept;
+/** Graphs the declarations of unit.
+ *
+ *  If graphed is not null, headers it contains are skipped and the
+ *  headers graphed here are added to it.  The files named by sources
+ *  are graphed like the main file, they're the sources of a unity
+ *  translation unit.
+ */
+void graph_translation_unit(CXTranslationUnit unit,
+                            ngmg::connection & connection,
+                            const ast_visitor_policy & policy,
+                            graphed_files * graphed = nullptr,
+                            const std::vector<std::string> & sources = {})
+{
+    CXCursor cursor = clang_getTranslationUnitCursor(unit);
 
-    bool
-    empty() const noexcept;
+    std::optional<std::reference_wrapper<graphed_files>> graphed_ref;
+    if (graphed)
+    {
+        graphed_ref = std::ref(*graphed);
+    }
 
-    private:
-    std::vector<char *> _commands;
-};
+    ast_visitor visitor(std::ref(connection), std::ref(policy), graphed_ref);
+    for (const auto & source: sources)
+    {
+        if (CXFile file = clang_getFile(unit, source.c_str()))
+        {
+            visitor.add_source(file);
+        }
+    }
 
-compile_command::compile_command(const std::string & file)
-{
-    this->_commands.push_back(new char[file.size() + 1]);
-    std::fill(this->_commands.back(), this->_commands.back() + file.size() + 1, 0);
-    file.copy(this->_commands.back(), file.size());
+    clang_visitChildren(cursor, &ast_visitor::graph, &visitor);
+    visitor.record_graphed_files();
 }
 
-compile_command::compile_command(CXCompileCommand cx_compile_command)
+/// The C and C++ files of paths, the files in directories that
+/// filter selects and the other paths as they are
+std::vector<std::string>
+single_files(const std::vector<std::string> & paths, const ast_visitor_filter & filter)
 {
-    const unsigned sizeof_args = clang_CompileCommand_getNumArgs(cx_compile_command);
-    this->_commands.resize(sizeof_args);
+    static const std::set<std::filesystem::path> extensions {".c", ".cc", ".cpp", ".cxx", ".h", ".hh", ".hpp", ".hxx"};
 
-    for(unsigned i = 0; i < sizeof_args; ++i)
+    std::vector<std::string> files;
+    for (const auto & path: paths)
     {
-        ngclang::string_t cxstring(clang_CompileCommand_getArg(cx_compile_command, i));
-        char const * const command = clang_getCString(cxstring.get());
-        const size_t sizeof_command = std::strlen(command);
-        this->_commands[i] = new char[sizeof_command + 1];
-        std::fill(this->_commands[i], this->_commands[i] + sizeof_command + 1, 0);
-        std::copy(command, command + sizeof_command, this->_commands[i]);
+        if (!std::filesystem::is_directory(path))
+        {
+            files.push_back(path);
+            continue;
+        }
+
+        for (const auto & entry: std::filesystem::recursive_directory_iterator(path))
+        {
+            if (entry.is_regular_file() && extensions.contains(entry.path().extension()) &&
+                filter.parse_file(entry.path()))
+            {
+                files.push_back(entry.path().string());
+            }
+        }
     }
+
+    return files;
 }
 
-compile_command::~compile_command()
+/** Parses each of files on its own, without the files it includes or
+ *  a compile command, and graphs what libclang resolves.
+ *
+ *  Files are parsed with CXTranslationUnit_SingleFileParse, as C if
+ *  they end in ".c" and as C++ otherwise, by jobs threads that each
+ *  have their own libclang index and memgraph connection.
+ */
+void index_single_files(const std::vector<std::string> & files,
+                        const mg::Client::Params & params,
+                        const ast_visitor_policy & policy,
+                        const unsigned int jobs)
 {
-    for (auto c : this->_commands)
+    const auto start = std::chrono::steady_clock::now();
+    std::atomic<std::size_t> next_file = 0;
+    std::vector<std::exception_ptr> errors(jobs);
+    {
+        std::vector<std::jthread> workers;
+        for (unsigned int i = 0; i < jobs; ++i)
+        {
+            workers.emplace_back([&files, &params, &policy, &next_file, &error = errors[i]] () {
+                try
+                {
+                    auto client = mg::Client::Connect(params);
+                    if (!client)
+                    {
+                        throw std::runtime_error("failed to connect to db");
+                    }
+
+                    // Without the included files most files have errors,
+                    // so diagnostics aren't displayed.
+                    ngmg::client_connection connection {std::ref(*client)};
+                    ngclang::object<CXIndex, ngclang::dispose_index> index = clang_createIndex(0,0);
+                    for (std::size_t i = next_file++; i < files.size(); i = next_file++)
+                    {
+                        const std::string & file = files[i];
+                        // Each name declared in a missing header is an error,
+                        // so there's no error limit, and no time is spent
+                        // looking for names they could be typos of.
+                        const char * const arguments[] = {
+                            "-x", file.ends_with(".c") ? "c" : "c++",
+                            "-ferror-limit=0",
+                            "-fno-spell-checking"
+                        };
+
+                        ngclang::translation_unit_t unit {nullptr};
+                        const CXErrorCode error =
+                            clang_parseTranslationUnit2(index.get(),
+                                                        file.c_str(),
+                                                        arguments,
+                                                        std::size(arguments),
+                                                        nullptr,
+                                                        0,
+                                                        policy.parse_options(),
+                                                        &unit.get());
+                        if (error != CXError_Success)
+                        {
+                            std::cerr << "error parsing " << file << '\n';
+                            continue;
+                        }
+
+                        graph_translation_unit(unit.get(), connection, policy);
+                    }
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+            });
+        }
+    }
+
+    for (auto & error: errors)
     {
-        delete [] c;
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
     }
-}
 
-char * const *
-compile_command::array() const noexcept
-{
-    
-    return this->_commands.empty() ? nullptr : &this->_commands.front();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "graphed " << files.size() << " files in " << elapsed.count() << "s" << std::endl;
 }
 
-size_t
-compile_command::size() const noexcept
+/** Parses and graphs the translation unit of commands.
+ *
+ *  If includes is not null, it's filled with the main file and all the
+ *  files it includes.  If graphed is not null, headers it contains are
+ *  skipped and the headers graphed here are added to it.  If cache is
+ *  not null, the translation unit is loaded from it instead of parsed
+ *  when possible, and saved to it otherwise.  If unsaved is not null,
+ *  its files are read from it instead of the file system.  Returns
+ *  false if the translation unit could not be parsed.
+ */
+bool parse_compile_command(CXIndex index,
+                           const compile_command & commands,
+                           ngmg::connection & connection,
+                           const ast_visitor_policy & policy,
+                           std::vector<std::string> * includes = nullptr,
+                           graphed_files * graphed = nullptr,
+                           const ast_cache * cache = nullptr,
+                           source_cache::snapshot * unsaved = nullptr)
 {
-    return this->_commands.size();
-}
+    std::vector<std::string> files;
+    ngclang::translation_unit_t unit {cache ? cache->load(index, commands, policy.parse_options(), files) : nullptr};
+    if (!unit.get())
+    {
+        const CXErrorCode error =
+            clang_parseTranslationUnit2FullArgv(
+                index,
+                nullptr,
+                commands.array(),
+                commands.size(),
+                unsaved ? unsaved->files() : nullptr,
+                unsaved ? unsaved->size() : 0,
+                policy.parse_options(),
+                &unit.get());
+
+        if (error != CXError_Success)
+        {
+            std::cerr << "error parsing file\n";
+            return false;
+        }
 
-bool
-compile_command::empty() const noexcept
-{
-    return this->_commands.empty();
+        if (cache || includes)
+        {
+            files = ngclang::included_files(unit.get());
+        }
+
+        if (cache)
+        {
+            cache->save(unit.get(), commands, policy.parse_options(), files);
+        }
+    }
+
+    graph_translation_unit(unit.get(), connection, policy, graphed);
+
+    if (includes)
+    {
+        *includes = std::move(files);
+    }
+
+    return true;
 }
 
-void parse_file(CXIndex index, const std::string & file, mg::Client & client)
+/** Parses and graphs the unity translation unit of commands, whose
+ *  sources are the main files of batch.
+ *
+ *  If the translation unit can't be parsed, has errors or its sources
+ *  declare internal linkage symbols with the same name, each compile
+ *  command of batch is parsed on its own instead.  The files each
+ *  compile command's translation unit includes are recorded in state,
+ *  for a unity translation unit all the files it includes but the
+ *  other sources, and added to includes.  Headers graphed contains are
+ *  skipped and the headers graphed here are added to it.  If unsaved
+ *  is not null, its files are read from it instead of the file system.
+ */
+void parse_unity_command(CXIndex index,
+                         const compile_command & commands,
+                         const unity_batches::batch & batch,
+                         ngmg::connection & connection,
+                         const ast_visitor_policy & policy,
+                         index_state & state,
+                         graphed_files & graphed,
+                         std::vector<std::string> & includes,
+                         source_cache::snapshot * unsaved = nullptr)
 {
-    ngclang::translation_unit_t unit = 
-        clang_parseTranslationUnit(
-            index, // clang index
-            file.c_str(), // path
-            nullptr, // command line args
-            0, // number of command line args
-            nullptr, // clang unsaved files
-            0, // number of unsaved files
-            CXTranslationUnit_None);
+    std::string conflict;
+    {
+        ngclang::translation_unit_t unit {nullptr};
+        const CXErrorCode error =
+            clang_parseTranslationUnit2FullArgv(
+                index,
+                nullptr,
+                commands.array(),
+                commands.size(),
+                unsaved ? unsaved->files() : nullptr,
+                unsaved ? unsaved->size() : 0,
+                policy.parse_options(),
+                &unit.get());
+
+        if (error != CXError_Success)
+        {
+            conflict = "it could not be parsed";
+        }
+        else if (ngclang::has_errors(unit.get()))
+        {
+            conflict = "it has errors";
+        }
+        else if (const auto symbol = unity_batches::conflicting_symbol(unit.get(), batch))
+        {
+            conflict = "more than one source declares " + *symbol;
+        }
+        else
+        {
+            std::vector<std::string> sources;
+            std::vector<std::string> source_paths;
+            for (const auto & command: batch)
+            {
+                sources.push_back(unity_batches::source(*command));
+                source_paths.push_back(ngclang::file_path(clang_getFile(unit.get(), sources.back().c_str())));
+            }
 
-    CXCursor cursor = clang_getTranslationUnitCursor(unit.get());
+            graph_translation_unit(unit.get(), connection, policy, &graphed, sources);
 
-    ast_visitor visitor(std::ref(client));
-    clang_visitChildren(cursor, &ast_visitor::graph, &visitor);
+            const std::string main_file = ngclang::file_path(clang_getFile(unit.get(), commands.file().c_str()));
+            const std::vector<std::string> files = ngclang::included_files(unit.get());
+            for (std::size_t i = 0; i < batch.size(); ++i)
+            {
+                std::vector<std::string> source_includes;
+                std::ranges::copy_if(files, std::back_inserter(source_includes), [&] (const std::string & file) {
+                    return file != main_file &&
+                        (file == source_paths[i] || std::ranges::find(source_paths, file) == source_paths.end());
+                });
+                state.record(*batch[i], std::move(source_includes));
+            }
+
+            includes.insert(includes.end(), files.cbegin(), files.cend());
+
+            return;
+        }
+    }
+
+    std::ostringstream message;
+    message << "parsing the sources of " << commands.path() << " one at a time, " << conflict << '\n';
+    std::cerr << message.str();
+
+    for (const auto & command: batch)
+    {
+        std::vector<std::string> source_includes;
+        if (parse_compile_command(index, *command, connection, policy, &source_includes, &graphed, nullptr, unsaved))
+        {
+            includes.insert(includes.end(), source_includes.cbegin(), source_includes.cend());
+            state.record(*command, std::move(source_includes));
+        }
+    }
 }
 
-void parse_compile_command(CXIndex index,
-                           CXCompileCommand cx_compile_command,
-                           mg::Client & client,
-                           const ast_visitor_policy & policy)
+/// How translation units are traversed to build the graph
+enum class traversal_engine
 {
-    compile_command commands (cx_compile_command);
-    ngclang::translation_unit_t unit;
-    const CXErrorCode error =
-        clang_parseTranslationUnit2FullArgv(
-            index,
-            nullptr,
-            commands.array(),
-            commands.size(),
-            nullptr,
-            0,
-            CXTranslationUnit_KeepGoing | CXTranslationUnit_IgnoreNonErrorsFromIncludedFiles,
-            &unit.get());
+    // ast_visitor visits every cursor
+    visitor,
 
-    if (error != CXError_Success)
+    // libclang's indexer reports declarations and references
+    indexer
+};
+
+/** The part of the compile database a run indexes.
+ *
+ *  Translation units are assigned to shards by a hash of their main
+ *  file's path, so each of count runs started with the same compile
+ *  database indexes a different part of it, regardless of the order
+ *  of the compile commands.
+ */
+struct shard
+{
+    unsigned int index = 0;
+    unsigned int count = 1;
+
+    bool
+    contains(const compile_command & command) const
     {
-        std::cerr << "error parsing file\n";
-        return;
+        return content_hash(command.path().lexically_normal().string()) % this->count == this->index;
     }
+};
 
-    CXCursor cursor = clang_getTranslationUnitCursor(unit.get());
+/// The file filter of an indexer that graphs the files selected by
+/// policy's filter, or none if all files are selected
+indexer::file_filter
+indexer_filter(const ast_visitor_policy & policy)
+{
+    if (policy.filter().empty())
+    {
+        return {};
+    }
 
-    ast_visitor visitor(std::ref(client), std::ref(policy));
-    clang_visitChildren(cursor, &ast_visitor::graph, &visitor);
+    return [&filter = policy.filter()](CXFile file)
+    {
+        return filter.parse_file(file);
+    };
 }
 
-int main(int argc, char ** argv)
+/** Parses compile commands from the scheduler until it is empty.
+ *
+ *  Each worker has its own libclang index, memgraph connection and
+ *  copy of the visitor policy, so workers share nothing but the
+ *  scheduler, the recorded timings, the index state, the graphed
+ *  files, the precompiled headers, the unity batches, the AST cache
+ *  and the source cache.  If unity is not null, the compile commands
+ *  of its batches are parsed as unity translation units.  If sources
+ *  is not null, a translation unit reads the files it's expected to
+ *  include from it, the files recorded for it in the index state and
+ *  those the worker's last translation unit included, and the files it
+ *  included are added to it.
+ */
+void index_compile_commands(tu_scheduler & scheduler,
+                            tu_timings & timings,
+                            index_state & state,
+                            graphed_files & graphed,
+                            const pch_cache & pch,
+                            const unity_batches * unity,
+                            const ast_cache * cache,
+                            source_cache * sources,
+                            const mg::Client::Params & params,
+                            const ast_visitor_policy policy,
+                            const traversal_engine engine)
 {
-    std::string build_dir;
-    std::string file_to_parse;
+    auto client = mg::Client::Connect(params);
+    if (!client)
+    {
+        throw std::runtime_error("failed to connect to db");
+    }
 
-    static const struct option long_options [] = {
-        {"src-dir", required_argument, nullptr, 0},
-        {"src-tree", required_argument, nullptr, 1},
-        {"src-file", required_argument, nullptr, 2},
-        {"raw", no_argument, nullptr,3},
-        {"ancestor", required_argument, nullptr, 4},
-        {0,0,0,0}
-    };
+    ngmg::client_connection connection {std::ref(*client)};
+    ngclang::object<CXIndex, ngclang::dispose_index> index = clang_createIndex(0,1);
 
-    ast_visitor_policy policy;
-    int option_index;
-    for(;;)
+    std::optional<indexer> tu_indexer;
+    if (engine == traversal_engine::indexer)
     {
-        switch(::getopt_long(argc, argv, "s:t:d:f:phr",
+        tu_indexer.emplace(index.get(), std::ref(connection), policy.parse_options(), indexer_filter(policy));
+    }
+
+    // The scheduler hands a worker translation units that include the
+    // same files while it can, so the next one likely includes them.
+    std::vector<std::string> last_includes;
+
+    tu_scheduler::affinity affinity;
+    for (auto commands = scheduler.pop(affinity); commands; commands = scheduler.pop(affinity))
+    {
+        const unity_batches::batch * batch = unity ? unity->find(*commands) : nullptr;
+
+        std::ostringstream message;
+        message << "parsing: " << std::filesystem::path(commands->file());
+        if (batch)
+        {
+            message << " with " << batch->size() << " sources";
+        }
+        message << '\n';
+        std::cout << message.str() << std::flush;
+
+        std::vector<std::string> pch_files = batch ? std::vector<std::string>() : pch.apply(*commands);
+
+        std::optional<source_cache::snapshot> unsaved;
+        if (sources)
+        {
+            std::vector<std::string> expected = std::move(last_includes);
+            const auto add_recorded = [&expected, &state] (const compile_command & command) {
+                const std::vector<std::string> recorded = state.includes(command);
+                expected.insert(expected.end(), recorded.cbegin(), recorded.cend());
+            };
+
+            add_recorded(*commands);
+            if (batch)
+            {
+                for (const auto & command: *batch)
+                {
+                    add_recorded(*command);
+                }
+            }
+
+            unsaved.emplace(sources->find(expected));
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<std::string> includes;
+        if (batch)
+        {
+            parse_unity_command(index.get(), *commands, *batch, connection, policy, state, graphed, includes,
+                                unsaved ? &*unsaved : nullptr);
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            timings.record(commands->path().string(), elapsed.count());
+        }
+        else
+        {
+            const bool parsed = tu_indexer ?
+                tu_indexer->index(*commands, &includes) :
+                parse_compile_command(index.get(), *commands, connection, policy, &includes, &graphed, cache,
+                                      unsaved ? &*unsaved : nullptr);
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            timings.record(commands->path().string(), elapsed.count());
+            if (parsed)
+            {
+                includes.insert(includes.end(), pch_files.begin(), pch_files.end());
+                state.record(*commands, includes);
+            }
+        }
+
+        if (sources)
+        {
+            sources->add(includes);
+            last_includes = std::move(includes);
+        }
+    }
+}
+
+/** Parses and graphs commands in a child process.
+ *
+ *  The graph statements are sent to the parent through channel.  The
+ *  results are written to output for
+ *  index_compile_commands_in_children: an "include <file>" line for
+ *  the main file and each file it includes, a "graphed <device>
+ *  <inode> <mtime> <content hash>" line for each header graphed, and a
+ *  final "parsed" line if the translation unit could be parsed.
+ */
+void graph_in_child(int output,
+                    shared_channel & channel,
+                    const compile_command & commands,
+                    const graphed_files & graphed,
+                    const ast_cache * cache,
+                    const ast_visitor_policy & policy,
+                    const traversal_engine engine)
+{
+    ngmg::channel_connection connection {std::ref(channel)};
+    ngclang::object<CXIndex, ngclang::dispose_index> index = clang_createIndex(0,1);
+
+    std::vector<std::string> includes;
+    graphed_files child_graphed {&graphed};
+    bool parsed = false;
+    if (engine == traversal_engine::indexer)
+    {
+        indexer tu_indexer {index.get(), std::ref(connection), policy.parse_options(), indexer_filter(policy)};
+        parsed = tu_indexer.index(commands, &includes);
+    }
+    else
+    {
+        parsed = parse_compile_command(index.get(), commands, connection, policy, &includes, &child_graphed, cache);
+    }
+
+    std::ostringstream results;
+    for (const auto & file: includes)
+    {
+        results << "include " << file << '\n';
+    }
+
+    for (const auto & id: child_graphed.files())
+    {
+        results << "graphed " << id.device << ' ' << id.inode << ' ' << id.mtime << ' ' << id.content_hash << '\n';
+    }
+
+    if (parsed)
+    {
+        results << "parsed\n";
+    }
+
+    child_process::write(output, results.str());
+}
+
+/** Executes up to count statements a child sent through channel.
+ *
+ *  Returns false if a statement failed, after writing why.  The child
+ *  may be waiting for the reply to the statement that failed, so it
+ *  has to be killed.
+ */
+bool execute_child_statements(shared_channel & channel,
+                              ngmg::connection & connection,
+                              std::size_t count,
+                              const std::string & file)
+{
+    shared_channel::record_kind kind;
+    std::string statement;
+    try
+    {
+        for (; count > 0 && channel.receive(kind, statement); --count)
+        {
+            if (kind == shared_channel::record_kind::exists)
+            {
+                channel.reply(connection.exists(statement));
+            }
+            else
+            {
+                connection.write(statement, kind == shared_channel::record_kind::write_existing_ok);
+            }
+        }
+    }
+    catch (const std::exception & e)
+    {
+        std::cerr << "error graphing " << file << ": " << e.what() << '\n';
+        return false;
+    }
+
+    return true;
+}
+
+/** Parses compile commands from the scheduler in child processes.
+ *
+ *  Up to jobs children run at once, each parsing one translation unit
+ *  with its own libclang index, and a child that crashes only loses
+ *  its translation unit.  Children send their graph statements through
+ *  a shared_channel, and the calling thread executes them on client,
+ *  so the graph is built over a single memgraph connection.  A child
+ *  that sent a statement that fails is killed, and its translation
+ *  unit is not recorded in the index state.
+ *
+ *  If budget is set, a translation unit that takes longer, not
+ *  counting the time its child waits for this thread to execute its
+ *  statements, is killed and parsed again with
+ *  CXTranslationUnit_SkipFunctionBodies, so only its declarations are
+ *  graphed, and is written to the slow
+ *  translation unit report along with how it ended.  Neither is
+ *  recorded in the index state, so an incremental run tries them
+ *  again.
+ *
+ *  Children are forked from the calling thread, so it must be the
+ *  process's only thread.
+ */
+void index_compile_commands_in_children(tu_scheduler & scheduler,
+                                        tu_timings & timings,
+                                        index_state & state,
+                                        graphed_files & graphed,
+                                        const pch_cache & pch,
+                                        const ast_cache * cache,
+                                        mg::Client & client,
+                                        const ast_visitor_policy & policy,
+                                        const traversal_engine engine,
+                                        const unsigned int jobs,
+                                        const std::optional<std::chrono::duration<double>> budget,
+                                        const std::filesystem::path & slow_tus_file)
+{
+    // statements executed for a child before the others' turn
+    constexpr std::size_t statements_per_turn = 256;
+
+    ngmg::client_connection connection {std::ref(client)};
+    ast_visitor_policy declarations_policy = policy;
+    declarations_policy.structure_only(true);
+
+    struct running_unit
+    {
+        std::unique_ptr<compile_command> commands;
+        std::vector<std::string> pch_files;
+        bool declarations_only = false;
+
+        // seconds spent on the attempts that went over the budget
+        double timed_out_seconds = 0;
+
+        std::chrono::steady_clock::time_point start;
+        std::string output;
+        std::unique_ptr<shared_channel> channel;
+        std::unique_ptr<child_process> child;
+    };
+
+    std::ofstream slow_tus;
+    if (budget)
+    {
+        slow_tus.open(slow_tus_file, std::ios::trunc);
+    }
+
+    std::deque<running_unit> retries;
+    std::vector<running_unit> running;
+    tu_scheduler::affinity affinity;
+    while (true)
+    {
+        while (running.size() < jobs)
+        {
+            running_unit unit;
+            if (!retries.empty())
+            {
+                unit = std::move(retries.front());
+                retries.pop_front();
+            }
+            else if (auto commands = scheduler.pop(affinity); commands)
+            {
+                std::ostringstream message;
+                message << "parsing: " << std::filesystem::path(commands->file()) << '\n';
+                std::cout << message.str() << std::flush;
+
+                unit.pch_files = pch.apply(*commands);
+                unit.commands = std::move(commands);
+            }
+            else
+            {
+                break;
+            }
+
+            const ast_visitor_policy & unit_policy = unit.declarations_only ? declarations_policy : policy;
+            unit.start = std::chrono::steady_clock::now();
+            unit.channel = std::make_unique<shared_channel>();
+            unit.child = std::make_unique<child_process>([&] (int output) {
+                graph_in_child(output, *unit.channel, *unit.commands, graphed, cache, unit_policy, engine);
+            });
+            running.push_back(std::move(unit));
+        }
+
+        if (running.empty())
+        {
+            break;
+        }
+
+        // each child's output followed by its channel's signal
+        auto now = std::chrono::steady_clock::now();
+        std::vector<pollfd> outputs;
+        auto timeout = std::chrono::steady_clock::duration::max();
+        for (const auto & unit: running)
+        {
+            outputs.push_back({unit.child->output(), POLLIN, 0});
+            outputs.push_back({unit.channel->signal(), POLLIN, 0});
+            if (!unit.channel->empty())
+            {
+                timeout = std::chrono::steady_clock::duration::zero();
+            }
+
+            if (budget)
+            {
+                const auto deadline = unit.start + unit.channel->waited() +
+                    std::chrono::duration_cast<std::chrono::steady_clock::duration>(*budget);
+                timeout = std::min(timeout, deadline > now ? deadline - now : std::chrono::steady_clock::duration::zero());
+            }
+        }
+
+        // round up so a child isn't polled again just before its deadline
+        const int timeout_ms = timeout == std::chrono::steady_clock::duration::max() ?
+            -1 : std::chrono::ceil<std::chrono::milliseconds>(timeout).count();
+        if (::poll(outputs.data(), outputs.size(), timeout_ms) < 0 && errno != EINTR)
+        {
+            throw std::system_error(errno, std::generic_category(), "error polling child processes");
+        }
+
+        now = std::chrono::steady_clock::now();
+        std::vector<running_unit> still_running;
+        for (std::size_t i = 0; i < running.size(); ++i)
+        {
+            running_unit & unit = running[i];
+            const std::chrono::duration<double> elapsed = now - unit.start;
+            const double seconds = unit.timed_out_seconds + elapsed.count();
+
+            // the time the child spent parsing, without the time it
+            // waited for the statements this process executes
+            const std::chrono::duration<double> parse_time = elapsed - unit.channel->waited();
+            const std::string & file = unit.commands->file();
+            if (outputs[2 * i + 1].revents != 0)
+            {
+                unit.channel->acknowledge();
+            }
+
+            // A child that closed its output sent all of its statements.
+            const bool open = outputs[2 * i].revents == 0 || unit.child->read(unit.output);
+            if (!execute_child_statements(*unit.channel, connection, open ? statements_per_turn : SIZE_MAX, file))
+            {
+                unit.child->kill();
+                unit.child->wait();
+                timings.record(unit.commands->path().string(), seconds);
+                if (budget)
+                {
+                    slow_tus << seconds << " failed " << file << '\n';
+                }
+
+                continue;
+            }
+
+            if (open)
+            {
+                if (!budget || parse_time < *budget)
+                {
+                    still_running.push_back(std::move(unit));
+                    continue;
+                }
+
+                unit.child->kill();
+                unit.child->wait();
+                unit.child.reset();
+                if (!unit.declarations_only)
+                {
+                    std::cout << "over " << budget->count() << "s, parsing declarations only: " << file << std::endl;
+                    unit.declarations_only = true;
+                    unit.timed_out_seconds = seconds;
+                    unit.output.clear();
+                    retries.push_back(std::move(unit));
+                }
+                else
+                {
+                    std::cerr << "over " << budget->count() << "s parsing declarations only, skipped: " << file << '\n';
+                    slow_tus << seconds << " timed-out " << file << '\n';
+                    timings.record(unit.commands->path().string(), seconds);
+                }
+
+                continue;
+            }
+
+            const int status = unit.child->wait();
+            timings.record(unit.commands->path().string(), seconds);
+            if (WIFSIGNALED(status))
+            {
+                std::cerr << "crashed with signal " << WTERMSIG(status) << " parsing " << file << '\n';
+                continue;
+            }
+
+            std::vector<std::string> includes;
+            std::vector<graphed_files::file_id> graphed_ids;
+            bool parsed = false;
+            std::istringstream results(unit.output);
+            std::string kind;
+            while (results >> kind)
+            {
+                if (kind == "include" && results.get() == ' ')
+                {
+                    std::string include;
+                    std::getline(results, include);
+                    includes.push_back(std::move(include));
+                }
+                else if (kind == "graphed")
+                {
+                    graphed_files::file_id id;
+                    results >> id.device >> id.inode >> id.mtime >> id.content_hash;
+                    graphed_ids.push_back(id);
+                }
+                else if (kind == "parsed")
+                {
+                    parsed = true;
+                }
+            }
+
+            // A translation unit graphed without function bodies is
+            // missing its calls, so neither it nor its headers are
+            // recorded as graphed.
+            if (unit.declarations_only)
+            {
+                slow_tus << seconds << (parsed ? " declarations-only " : " failed ") << file << '\n';
+            }
+            else if (parsed)
+            {
+                graphed.insert(graphed_ids);
+                includes.insert(includes.end(), unit.pch_files.begin(), unit.pch_files.end());
+                state.record(*unit.commands, std::move(includes));
+            }
+        }
+
+        running = std::move(still_running);
+    }
+
+    if (budget && !slow_tus)
+    {
+        throw std::runtime_error("error writing " + slow_tus_file.string());
+    }
+}
+
+/** Hands the scheduled compile commands out to worker processes.
+ *
+ *  A worker is sent the index of a compile command in the compile
+ *  database followed by its main file, and reports back how long it
+ *  took to parse and graph it.
+ */
+void coordinate_workers(const std::string & address,
+                        tu_scheduler & scheduler,
+                        const std::unordered_map<const compile_command *, std::size_t> & command_indexes,
+                        tu_timings & timings)
+{
+    std::vector<std::string> items;
+    std::vector<std::string> paths;
+    tu_scheduler::affinity affinity;
+    for (auto commands = scheduler.pop(affinity); commands; commands = scheduler.pop(affinity))
+    {
+        items.push_back(std::to_string(command_indexes.at(commands.get())) + ' ' + commands->file());
+        paths.push_back(commands->path().string());
+    }
+
+    work_coordinator coordinator {address};
+    std::cout << "coordinating " << items.size() << " translation units on " << address << std::endl;
+
+    std::size_t done = 0;
+    coordinator.run(items, [&paths, &timings, &done] (std::size_t item, double seconds) {
+        timings.record(paths[item], seconds);
+        std::cout << "done (" << ++done << '/' << paths.size() << "): " << paths[item] << std::endl;
+    });
+}
+
+/** Parses the compile commands a coordinator hands out until it has
+ *  none left.
+ *
+ *  Compile commands are identified by their index in the compile
+ *  database, so a worker has to use the coordinator's compile database.
+ */
+void index_assigned_commands(const std::string & coordinator,
+                             const compile_database & database,
+                             const argument_rewriter & rewriter,
+                             graphed_files & graphed,
+                             const ast_cache * cache,
+                             const mg::Client::Params & params,
+                             const ast_visitor_policy policy,
+                             const traversal_engine engine)
+{
+    auto client = mg::Client::Connect(params);
+    if (!client)
+    {
+        throw std::runtime_error("failed to connect to db");
+    }
+
+    ngmg::client_connection connection {std::ref(*client)};
+    ngclang::object<CXIndex, ngclang::dispose_index> index = clang_createIndex(0,1);
+
+    std::optional<indexer> tu_indexer;
+    if (engine == traversal_engine::indexer)
+    {
+        tu_indexer.emplace(index.get(), std::ref(connection), policy.parse_options(), indexer_filter(policy));
+    }
+
+    work_client work {coordinator};
+    std::optional<std::string> item = work.next();
+    while (item)
+    {
+        char * end = nullptr;
+        const unsigned long i = std::strtoul(item->c_str(), &end, 10);
+        const compile_database::entry * entry = (end == item->c_str() || *end != ' ') ? nullptr : database.find(i);
+        if (!entry)
+        {
+            throw std::runtime_error("invalid work item: " + *item);
+        }
+
+        compile_command commands {*entry};
+        if (commands.file() != end + 1)
+        {
+            throw std::runtime_error("the coordinator's compile database doesn't match: " + *item);
+        }
+
+        rewriter.rewrite(commands);
+
+        std::ostringstream message;
+        message << "parsing: " << std::filesystem::path(commands.file()) << '\n';
+        std::cout << message.str() << std::flush;
+
+        const auto start = std::chrono::steady_clock::now();
+        if (tu_indexer)
+        {
+            tu_indexer->index(commands, nullptr);
+        }
+        else
+        {
+            parse_compile_command(index.get(), commands, connection, policy, nullptr, &graphed, cache);
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        item = work.done(elapsed.count());
+    }
+}
+
+/** Parses each translation unit with its original and its rewritten
+ *  arguments, and prints how much parse time rewriting them saved.
+ *
+ *  Translation units are only parsed, not graphed, and the two
+ *  versions are parsed alternately so both see the same file cache.
+ */
+void report_rewrite_savings(const std::vector<std::pair<std::unique_ptr<compile_command>,
+                                                        std::unique_ptr<compile_command>>> & commands,
+                            std::size_t sizeof_translation_units,
+                            unsigned parse_options)
+{
+    ngclang::object<CXIndex, ngclang::dispose_index> index = clang_createIndex(0,0);
+
+    // Returns the seconds it took to parse command, and whether it
+    // failed.
+    const auto parse = [&index, parse_options] (const compile_command & command) {
+        ngclang::translation_unit_t unit;
+        const auto start = std::chrono::steady_clock::now();
+        const CXErrorCode error =
+            clang_parseTranslationUnit2FullArgv(
+                index.get(),
+                nullptr,
+                command.array(),
+                command.size(),
+                nullptr,
+                0,
+                parse_options,
+                &unit.get());
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        return std::make_pair(elapsed.count(), error != CXError_Success || ngclang::has_errors(unit.get()));
+    };
+
+    double original_seconds = 0;
+    double rewritten_seconds = 0;
+    std::size_t original_failures = 0;
+    std::size_t rewritten_failures = 0;
+    for (const auto & [original, rewritten]: commands)
+    {
+        const auto [original_time, original_failed] = parse(*original);
+        const auto [rewritten_time, rewritten_failed] = parse(*rewritten);
+        original_seconds += original_time;
+        rewritten_seconds += rewritten_time;
+        original_failures += original_failed;
+        rewritten_failures += rewritten_failed;
+    }
+
+    std::cout << "rewritten: " << commands.size() << " of " << sizeof_translation_units
+              << " translation units\n"
+              << "original arguments: " << original_seconds << "s, " << original_failures << " with errors\n"
+              << "rewritten arguments: " << rewritten_seconds << "s, " << rewritten_failures << " with errors\n"
+              << "saved: " << (original_seconds - rewritten_seconds) << 's';
+    if (original_seconds > 0)
+    {
+        std::cout << " (" << 100 * (original_seconds - rewritten_seconds) / original_seconds << "%)";
+    }
+    std::cout << std::endl;
+}
+
+/** Removes the nodes and relationships located in files.
+ *
+ *  Nodes and relationships of every label have a file, so there's no
+ *  index to find them by, and all of the files are removed in one
+ *  scan of the nodes and one of the relationships.
+ */
+void delete_file_subgraph(mg::Client & client, const std::set<std::string> & files)
+{
+    if (files.empty())
+    {
+        return;
+    }
+
+    mg::List file_list(files.size());
+    for (const auto & file: files)
+    {
+        file_list.Append(mg::Value(file));
+    }
+
+    mg::Map params(1);
+    params.Insert("files", mg::Value(std::move(file_list)));
+
+    {
+        ngmg::statement_executor executor(std::ref(client));
+        executor.execute("MATCH ()-[r]->() WHERE r.file IN $files DELETE r;", params.AsConstMap());
+    }
+
+    {
+        ngmg::statement_executor executor(std::ref(client));
+        executor.execute("MATCH (n) WHERE n.file IN $files DETACH DELETE n;", params.AsConstMap());
+    }
+}
+
+/// Removes the symbol nodes that no longer have a declaration or definition
+void delete_undeclared_symbols(mg::Client & client)
+{
+    ngmg::statement_executor executor(std::ref(client));
+    executor.execute("MATCH (n) "
+                     "WHERE (n:Namespace OR n:Class OR n:Function OR n:MemberFunction OR n:Constructor OR n:Destructor) "
+                     "AND NOT exists(()-[:DECLARES|DEFINES]->(n)) "
+                     "DETACH DELETE n;");
+}
+
+/** Reindexes the translation units that include changed files.
+ *
+ *  The translation units are kept parsed between calls while they use
+ *  less than units_memory bytes, so they're reparsed with their
+ *  precompiled preambles, and their part of the graph is replaced like
+ *  --incremental does.
+ */
+class reindexer
+{
+    public:
+
+    reindexer(const compile_database & database,
+              const argument_rewriter & rewriter,
+              mg::Client & client,
+              const ast_visitor_policy & policy,
+              index_state & state,
+              std::filesystem::path index_state_file,
+              std::size_t units_memory);
+
+    reindexer(const reindexer &) = delete;
+    reindexer& operator = (const reindexer &) = delete;
+
+    /// Parses the recorded translation units until they use the memory
+    /// kept for them, so the first changes are reparsed with
+    /// precompiled preambles too, returns a line describing what was
+    /// done
+    std::string
+    preload();
+
+    /// Reindexes the translation units that include files, returns a
+    /// line describing what was done
+    std::string
+    reindex(const std::set<std::string> & files);
+
+    /// The directories of the main files and the files they include
+    /// that pass the policy's filter
+    std::set<std::filesystem::path>
+    directories() const;
+
+    private:
+
+    ngclang::object<CXIndex, ngclang::dispose_index> _index;
+    translation_units _units;
+
+    // compile commands by the canonical path of their main file
+    std::map<std::string, std::unique_ptr<compile_command>> _commands;
+
+    mg::Client & _client;
+    const ast_visitor_policy & _policy;
+    index_state & _state;
+    const std::filesystem::path _index_state_file;
+};
+
+reindexer::reindexer(const compile_database & database,
+                     const argument_rewriter & rewriter,
+                     mg::Client & client,
+                     const ast_visitor_policy & policy,
+                     index_state & state,
+                     std::filesystem::path index_state_file,
+                     std::size_t units_memory):
+    _index(clang_createIndex(0,1)),
+    _units(units_memory),
+    _client(client),
+    _policy(policy),
+    _state(state),
+    _index_state_file(std::move(index_state_file))
+{
+    for (const auto & entry: database.entries())
+    {
+        auto command = std::make_unique<compile_command>(entry);
+        std::error_code ec;
+        const std::filesystem::path main_file = std::filesystem::canonical(command->path(), ec);
+        if (!ec && policy.filter().parse_file(main_file))
+        {
+            rewriter.rewrite(*command);
+            this->_commands.emplace(main_file.string(), std::move(command));
+        }
+    }
+}
+
+std::string
+reindexer::preload()
+{
+    const auto start = std::chrono::steady_clock::now();
+    std::size_t parsed = 0;
+    for (const auto & [main_file, command]: this->_commands)
+    {
+        if (this->_state.includes(*command).empty())
+        {
+            continue;
+        }
+
+        // Once a unit is disposed of to keep the limit, parsing more
+        // would only replace the ones kept.
+        const std::size_t kept = this->_units.size();
+        if (!this->_units.parse(this->_index.get(), *command, this->_policy.parse_options()))
+        {
+            std::cerr << "error parsing " << main_file << '\n';
+            continue;
+        }
+
+        ++parsed;
+        if (this->_units.size() <= kept)
+        {
+            break;
+        }
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::ostringstream reply;
+    reply << "parsed " << parsed << " translation units in " << elapsed.count() << "s, kept "
+          << this->_units.size() << " in " << this->_units.memory_used() / (1024 * 1024) << " MiB\n";
+    return reply.str();
+}
+
+std::string
+reindexer::reindex(const std::set<std::string> & files)
+{
+    std::set<std::string> main_files;
+    for (const auto & file: files)
+    {
+        if (this->_commands.contains(file))
+        {
+            main_files.insert(file);
+        }
+
+        for (const auto & tu: this->_state.translation_units_including(file))
+        {
+            std::error_code ec;
+            const std::string main_file = std::filesystem::canonical(tu, ec).string();
+            if (!ec && this->_commands.contains(main_file))
+            {
+                main_files.insert(main_file);
+            }
+        }
+    }
+
+    if (main_files.empty())
+    {
+        return "no translation unit includes the changed files\n";
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::set<std::string> stale_files = files;
+    stale_files.insert(main_files.cbegin(), main_files.cend());
+    delete_file_subgraph(this->_client, stale_files);
+
+    ngmg::client_connection connection {std::ref(this->_client)};
+    graphed_files graphed;
+    std::size_t reindexed = 0;
+    for (const auto & main_file: main_files)
+    {
+        const compile_command & command = *this->_commands.at(main_file);
+        this->_state.invalidate(command);
+        CXTranslationUnit unit = this->_units.parse(this->_index.get(), command, this->_policy.parse_options());
+        if (!unit)
+        {
+            std::cerr << "error parsing " << main_file << '\n';
+            continue;
+        }
+
+        graph_translation_unit(unit, connection, this->_policy, &graphed);
+        this->_state.record(command, ngclang::included_files(unit));
+        ++reindexed;
+    }
+
+    delete_undeclared_symbols(this->_client);
+
+    // The graph is up to date whether or not the state is saved, an
+    // unsaved state only makes the next --incremental run parse more.
+    std::ostringstream reply;
+    try
+    {
+        this->_state.save(this->_index_state_file);
+    }
+    catch (const std::exception & e)
+    {
+        reply << "error saving index state: " << e.what() << '\n';
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    reply << "reindexed " << reindexed << " of " << main_files.size()
+          << " translation units in " << elapsed.count() << "s, "
+          << this->_units.memory_used() / (1024 * 1024) << " MiB of parsed translation units kept\n";
+    return reply.str();
+}
+
+std::set<std::filesystem::path>
+reindexer::directories() const
+{
+    std::set<std::filesystem::path> directories;
+    for (const auto & [main_file, command]: this->_commands)
+    {
+        directories.insert(std::filesystem::path(main_file).parent_path());
+    }
+
+    for (const auto & file: this->_state.files())
+    {
+        if (this->_policy.filter().parse_file(file))
+        {
+            directories.insert(std::filesystem::path(file).parent_path());
+        }
+    }
+
+    return directories;
+}
+
+/** Serves reindex requests on socket_path.
+ *
+ *  Each request is the path of a file, the translation units that
+ *  include it are reindexed.  A quit request stops serving.
+ */
+void serve_reindex_requests(const std::filesystem::path & socket_path, reindexer & files_reindexer)
+{
+    unix_socket_server server {socket_path};
+    std::cout << "listening on " << socket_path << std::endl;
+
+    server.serve([&] (const std::string & request) -> std::string {
+        if (request == "quit")
+        {
+            server.stop();
+            return "bye\n";
+        }
+
+        std::error_code ec;
+        const std::string file = std::filesystem::canonical(request, ec).string();
+        if (ec)
+        {
+            return "error: " + request + ": " + ec.message() + '\n';
+        }
+
+        try
+        {
+            return files_reindexer.reindex({file});
+        }
+        catch (const std::exception & e)
+        {
+            return std::string("error: ") + e.what() + '\n';
+        }
+    });
+}
+
+/** Watches the directories of the indexed files and reindexes the
+ *  translation units affected by each burst of changes.
+ *
+ *  Files whose contents didn't change are ignored.  A burst that
+ *  can't be reindexed is reported and the next one is waited for.
+ *  Runs until the process is interrupted.
+ */
+void watch_files(reindexer & files_reindexer, index_state & state, std::chrono::milliseconds debounce)
+{
+    file_watcher watcher;
+    for (const auto & directory: files_reindexer.directories())
+    {
+        if (!watcher.add_directory(directory))
+        {
+            std::cerr << "can't watch " << directory << '\n';
+        }
+    }
+
+    std::cout << "watching " << watcher.size() << " directories" << std::endl;
+
+    for (;;)
+    {
+        const file_watcher::change_set events = watcher.wait(debounce);
+        for (const auto & directory: events.unwatched)
+        {
+            if (!watcher.add_directory(directory))
+            {
+                std::cerr << "can't watch " << directory << '\n';
+            }
+        }
+
+        // The state of the files is only cleared when it's saved, and
+        // a burst that reindexes nothing doesn't save it.  When events
+        // were lost every recorded file is looked at again.
+        std::set<std::string> changes;
+        if (events.overflow)
+        {
+            std::cerr << "inotify lost events, checking every file\n";
+            state.forget();
+            const std::vector<std::string> changed_files = state.changed_files();
+            changes.insert(changed_files.cbegin(), changed_files.cend());
+        }
+        else
+        {
+            state.forget(events.files);
+            const std::vector<std::string> changed_files = state.changed_files();
+            std::set_intersection(events.files.cbegin(), events.files.cend(),
+                                  changed_files.cbegin(), changed_files.cend(),
+                                  std::inserter(changes, changes.end()));
+        }
+
+        if (changes.empty())
+        {
+            continue;
+        }
+
+        for (const auto & file: changes)
+        {
+            std::cout << "changed: " << file << '\n';
+        }
+
+        try
+        {
+            std::cout << files_reindexer.reindex(changes) << std::flush;
+        }
+        catch (const std::exception & e)
+        {
+            std::cerr << "error reindexing: " << e.what() << '\n';
+        }
+    }
+}
+
+/// Saves timings to file.  The timings only order the translation
+/// units of the next run, so an error is reported and not thrown.
+void save_timings(const tu_timings & timings, const std::filesystem::path & file)
+{
+    try
+    {
+        timings.save(file);
+    }
+    catch (const std::exception & e)
+    {
+        std::cerr << "error saving timings: " << e.what() << '\n';
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    std::string build_dir;
+    std::vector<std::string> files_to_parse;
+    std::filesystem::path timings_file;
+    std::filesystem::path index_state_file;
+    bool incremental = false;
+    bool use_pch = false;
+    std::filesystem::path pch_dir;
+    std::filesystem::path ast_cache_dir;
+    std::uintmax_t ast_cache_size = 4096;
+    std::filesystem::path daemon_socket;
+    std::uintmax_t tu_cache_size = 4096;
+    bool watch = false;
+    std::chrono::milliseconds debounce {200};
+    traversal_engine engine = traversal_engine::visitor;
+    std::optional<shard> run_shard;
+    std::string coordinator_address;
+    std::string worker_address;
+    bool print_dedup_statistics = false;
+    argument_rewriter rewriter;
+    bool report_rewriting = false;
+
+    // whether each translation unit is parsed in a child process, and
+    // the time it may take there
+    bool isolate = false;
+    std::optional<std::chrono::duration<double>> tu_budget;
+    unsigned int jobs = 1;
+
+    // the most sources of a unity translation unit, 0 without --unity
+    std::size_t unity_size = 0;
+    std::optional<source_cache::invalidation> source_invalidation;
+
+    static const struct option long_options [] = {
+        {"src-dir", required_argument, nullptr, 0},
+        {"src-tree", required_argument, nullptr, 1},
+        {"src-file", required_argument, nullptr, 2},
+        {"raw", no_argument, nullptr,3},
+        {"ancestor", required_argument, nullptr, 4},
+        {"jobs", required_argument, nullptr, 'j'},
+        {"timings", required_argument, nullptr, 5},
+        {"incremental", no_argument, nullptr, 6},
+        {"index-state", required_argument, nullptr, 7},
+        {"engine", required_argument, nullptr, 8},
+        {"structure-only", no_argument, nullptr, 9},
+        {"pch", no_argument, nullptr, 10},
+        {"pch-dir", required_argument, nullptr, 11},
+        {"ast-cache", required_argument, nullptr, 12},
+        {"ast-cache-size", required_argument, nullptr, 13},
+        {"daemon", required_argument, nullptr, 14},
+        {"watch", no_argument, nullptr, 15},
+        {"debounce", required_argument, nullptr, 16},
+        {"shard", required_argument, nullptr, 17},
+        {"coordinator", required_argument, nullptr, 18},
+        {"worker", required_argument, nullptr, 19},
+        {"dedup-stats", no_argument, nullptr, 20},
+        {"keep-args", no_argument, nullptr, 21},
+        {"drop-arg", required_argument, nullptr, 22},
+        {"drop-arg-value", required_argument, nullptr, 23},
+        {"add-arg", required_argument, nullptr, 24},
+        {"rewrite-report", no_argument, nullptr, 25},
+        {"include", required_argument, nullptr, 26},
+        {"exclude", required_argument, nullptr, 27},
+        {"tu-timeout", required_argument, nullptr, 28},
+        {"isolate", no_argument, nullptr, 29},
+        {"tu-cache-size", required_argument, nullptr, 30},
+        {"single-file", no_argument, nullptr, 31},
+        {"unity", required_argument, nullptr, 32},
+        {"source-cache", required_argument, nullptr, 33},
+        {0,0,0,0}
+    };
+
+    ast_visitor_policy policy;
+    int option_index;
+    for(;;)
+    {
+        switch(::getopt_long(argc, argv, "s:t:d:f:j:phr",
                              long_options, &option_index))
         {
             case 'd':
@@ -1663,7 +3269,20 @@ int main(int argc, char ** argv)
             }
             case 'f':
             {
-                file_to_parse = optarg;
+                files_to_parse.push_back(optarg);
+                continue;
+            }
+            case 'j':
+            {
+                char * end = nullptr;
+                const unsigned long value = std::strtoul(optarg, &end, 10);
+                if (end == optarg || *end != '\0' || value == 0)
+                {
+                    std::cerr << "invalid number of jobs: " << optarg << '\n';
+                    return 3;
+                }
+
+                jobs = value;
                 continue;
             }
             case 'p':
@@ -1681,43 +3300,292 @@ int main(int argc, char ** argv)
                 policy.filter().push_back_src_dir(optarg);
                 continue;
             }
-            case 0:
+            case 0:
+            {
+                policy.filter().push_back_src_dir(optarg);
+                continue;
+            }
+            case 't':
+            {
+                policy.filter().push_back_src_tree(optarg);
+                continue;
+            }
+            case 1:
+            {
+                policy.filter().push_back_src_tree(optarg);
+                continue;
+            }
+            case 2:
+            {
+                policy.filter().push_back_src_file(optarg);
+                continue;
+            }
+            case 3:
+            {
+                policy.graph_raw(true);
+                continue;
+            }
+            case 4:
+            {
+                const std::string ancestor = optarg;
+                if (ancestor == "CallExpr")
+                {
+                    policy.ancestor_match(CXCursor_CallExpr);
+                    continue;
+                }
+                else
+                {
+                    std::cerr << "unknown ancestor kind\n";
+                    return 3;
+                }
+            }
+            case 5:
+            {
+                timings_file = optarg;
+                continue;
+            }
+            case 6:
+            {
+                incremental = true;
+                continue;
+            }
+            case 7:
+            {
+                index_state_file = optarg;
+                continue;
+            }
+            case 8:
+            {
+                const std::string engine_name = optarg;
+                if (engine_name == "visitor")
+                {
+                    engine = traversal_engine::visitor;
+                }
+                else if (engine_name == "indexer")
+                {
+                    engine = traversal_engine::indexer;
+                }
+                else
+                {
+                    std::cerr << "unknown engine: " << engine_name << '\n';
+                    return 3;
+                }
+
+                continue;
+            }
+            case 9:
+            {
+                policy.structure_only(true);
+                continue;
+            }
+            case 10:
+            {
+                use_pch = true;
+                continue;
+            }
+            case 11:
+            {
+                pch_dir = optarg;
+                continue;
+            }
+            case 12:
+            {
+                ast_cache_dir = optarg;
+                continue;
+            }
+            case 13:
+            {
+                char * end = nullptr;
+                const unsigned long long value = std::strtoull(optarg, &end, 10);
+                if (end == optarg || *end != '\0')
+                {
+                    std::cerr << "invalid AST cache size: " << optarg << '\n';
+                    return 3;
+                }
+
+                ast_cache_size = value;
+                continue;
+            }
+            case 14:
+            {
+                daemon_socket = optarg;
+                continue;
+            }
+            case 15:
+            {
+                watch = true;
+                continue;
+            }
+            case 16:
+            {
+                char * end = nullptr;
+                const unsigned long value = std::strtoul(optarg, &end, 10);
+                if (end == optarg || *end != '\0')
+                {
+                    std::cerr << "invalid debounce: " << optarg << '\n';
+                    return 3;
+                }
+
+                debounce = std::chrono::milliseconds(value);
+                continue;
+            }
+            case 17:
+            {
+                char * end = nullptr;
+                const unsigned long index = std::strtoul(optarg, &end, 10);
+                if (end == optarg || *end != '/')
+                {
+                    std::cerr << "invalid shard: " << optarg << '\n';
+                    return 3;
+                }
+
+                const char * count_arg = end + 1;
+                const unsigned long count = std::strtoul(count_arg, &end, 10);
+                if (end == count_arg || *end != '\0' || count == 0 || index >= count)
+                {
+                    std::cerr << "invalid shard: " << optarg << '\n';
+                    return 3;
+                }
+
+                run_shard = shard {static_cast<unsigned int>(index), static_cast<unsigned int>(count)};
+                continue;
+            }
+            case 18:
+            {
+                coordinator_address = optarg;
+                continue;
+            }
+            case 19:
+            {
+                worker_address = optarg;
+                continue;
+            }
+            case 20:
+            {
+                print_dedup_statistics = true;
+                continue;
+            }
+            case 21:
+            {
+                rewriter.keep_default_arguments();
+                continue;
+            }
+            case 22:
+            {
+                rewriter.remove(optarg);
+                continue;
+            }
+            case 23:
+            {
+                rewriter.remove_with_value(optarg);
+                continue;
+            }
+            case 24:
+            {
+                rewriter.add(optarg);
+                continue;
+            }
+            case 25:
+            {
+                report_rewriting = true;
+                continue;
+            }
+            case 26:
+            {
+                try
+                {
+                    policy.filter().push_back_include(optarg);
+                }
+                catch (const std::invalid_argument & e)
+                {
+                    std::cerr << "invalid include pattern: " << e.what() << '\n';
+                    return 3;
+                }
+
+                continue;
+            }
+            case 27:
+            {
+                try
+                {
+                    policy.filter().push_back_exclude(optarg);
+                }
+                catch (const std::invalid_argument & e)
+                {
+                    std::cerr << "invalid exclude pattern: " << e.what() << '\n';
+                    return 3;
+                }
+
+                continue;
+            }
+            case 28:
             {
-                policy.filter().push_back_src_dir(optarg);
+                char * end = nullptr;
+                const double value = std::strtod(optarg, &end);
+                if (end == optarg || *end != '\0' || !(value > 0))
+                {
+                    std::cerr << "invalid translation unit timeout: " << optarg << '\n';
+                    return 3;
+                }
+
+                tu_budget = std::chrono::duration<double>(value);
+                isolate = true;
                 continue;
             }
-            case 't':
+            case 29:
             {
-                policy.filter().push_back_src_tree(optarg);
+                isolate = true;
                 continue;
             }
-            case 1:
+            case 30:
             {
-                policy.filter().push_back_src_tree(optarg);
+                char * end = nullptr;
+                const unsigned long long value = std::strtoull(optarg, &end, 10);
+                if (end == optarg || *end != '\0')
+                {
+                    std::cerr << "invalid translation unit cache size: " << optarg << '\n';
+                    return 3;
+                }
+
+                tu_cache_size = value;
                 continue;
             }
-            case 2:
+            case 31:
             {
-                policy.filter().push_back_src_file(optarg);
+                policy.single_file(true);
                 continue;
             }
-            case 3:
+            case 32:
             {
-                policy.graph_raw(true);
+                char * end = nullptr;
+                const unsigned long value = std::strtoul(optarg, &end, 10);
+                if (end == optarg || *end != '\0' || value < 2)
+                {
+                    std::cerr << "invalid number of unity sources: " << optarg << '\n';
+                    return 3;
+                }
+
+                unity_size = value;
                 continue;
             }
-            case 4:
+            case 33:
             {
-                const std::string ancestor = optarg;
-                if (ancestor == "CallExpr")
+                const std::string invalidation = optarg;
+                if (invalidation == "mtime")
                 {
-                    policy.ancestor_match(CXCursor_CallExpr);
-                    continue;
+                    source_invalidation = source_cache::invalidation::mtime;
+                }
+                else if (invalidation == "inotify")
+                {
+                    source_invalidation = source_cache::invalidation::inotify;
                 }
                 else
                 {
-                    std::cerr << "unknown ancestor kind\n";
+                    std::cerr << "unknown source cache invalidation: " << invalidation << '\n';
+                    return 3;
                 }
+
+                continue;
             }
             case -1:
             {
@@ -1728,12 +3596,134 @@ int main(int argc, char ** argv)
         break;
     }
     
-    if (file_to_parse.empty() && build_dir.empty())
+    // Single files are parsed without a compile database, so nothing
+    // that reads one or records what it indexed applies.
+    if (policy.single_file() &&
+        (files_to_parse.empty() || !build_dir.empty() || incremental || !daemon_socket.empty() || watch ||
+         run_shard || unity_size > 0 || source_invalidation))
+    {
+        std::cerr << "--single-file needs -f and can't be combined with -d, --incremental, --watch, --daemon, "
+                     "--shard, --unity or --source-cache\n";
+        return 3;
+    }
+
+    if (files_to_parse.empty() && build_dir.empty())
     {
         std::cerr << "missing file or build directory to parse\n";
         return 3;
     }
 
+    if (engine == traversal_engine::indexer &&
+        (policy.print_ast() || policy.graph_raw() || policy.ancestor_match()))
+    {
+        std::cerr << "the indexer engine can't be combined with -p, --raw or --ancestor\n";
+        return 3;
+    }
+
+    if (engine == traversal_engine::indexer && !ast_cache_dir.empty())
+    {
+        std::cerr << "the indexer engine can't be combined with --ast-cache\n";
+        return 3;
+    }
+
+    if ((!daemon_socket.empty() || watch) && (build_dir.empty() || engine == traversal_engine::indexer))
+    {
+        std::cerr << "--daemon and --watch need -d and the visitor engine\n";
+        return 3;
+    }
+
+    if (!daemon_socket.empty() && watch)
+    {
+        std::cerr << "--daemon can't be combined with --watch\n";
+        return 3;
+    }
+
+    // Each shard's state only covers its own translation units, and
+    // the shards share one graph that they can't each replace parts of.
+    if (run_shard && (build_dir.empty() || incremental || !daemon_socket.empty() || watch))
+    {
+        std::cerr << "--shard needs -d and can't be combined with --incremental, --daemon or --watch\n";
+        return 3;
+    }
+
+    // Workers only report timings back, not the files they indexed.
+    if ((!coordinator_address.empty() || !worker_address.empty()) &&
+        (build_dir.empty() || run_shard || incremental || use_pch || !daemon_socket.empty() || watch))
+    {
+        std::cerr << "--coordinator and --worker need -d and can't be combined with "
+                     "--shard, --incremental, --pch, --daemon or --watch\n";
+        return 3;
+    }
+
+    // Children can't read node properties back from the graph, which
+    // --raw does.
+    if (isolate &&
+        (build_dir.empty() || policy.graph_raw() || !coordinator_address.empty() || !worker_address.empty() ||
+         !daemon_socket.empty() || watch))
+    {
+        std::cerr << "--isolate and --tu-timeout need -d and can't be combined with "
+                     "--raw, --coordinator, --worker, --daemon or --watch\n";
+        return 3;
+    }
+
+    // A unity translation unit is parsed and graphed by the visitor in
+    // the process that records the state of its sources.
+    if (unity_size > 0 &&
+        (build_dir.empty() || engine == traversal_engine::indexer || use_pch || !ast_cache_dir.empty() || isolate ||
+         !coordinator_address.empty() || !worker_address.empty()))
+    {
+        std::cerr << "--unity needs -d and the visitor engine and can't be combined with "
+                     "--pch, --ast-cache, --isolate, --tu-timeout, --coordinator or --worker\n";
+        return 3;
+    }
+
+    // Children and workers parse in other processes, and the indexer
+    // engine doesn't take unsaved files.
+    if (source_invalidation &&
+        (build_dir.empty() || engine == traversal_engine::indexer || isolate ||
+         !coordinator_address.empty() || !worker_address.empty()))
+    {
+        std::cerr << "--source-cache needs -d and the visitor engine and can't be combined with "
+                     "--isolate, --tu-timeout, --coordinator or --worker\n";
+        return 3;
+    }
+
+    if (!coordinator_address.empty() && !worker_address.empty())
+    {
+        std::cerr << "--coordinator can't be combined with --worker\n";
+        return 3;
+    }
+
+    // libclang doesn't resolve declarations correctly in a saved
+    // translation unit that was parsed with a precompiled header.
+    if (use_pch && !ast_cache_dir.empty())
+    {
+        std::cerr << "--pch can't be combined with --ast-cache\n";
+        return 3;
+    }
+
+    // A structure only graph has no calls, so its state can't be used
+    // to incrementally update a full graph and the other way around.
+    if (index_state_file.empty() && !build_dir.empty())
+    {
+        index_state_file = std::filesystem::path(build_dir) /
+            (policy.structure_only() ? "cpp-graph-structure-index" : "cpp-graph-index");
+    }
+
+    // An incremental run needs to know what the previous run indexed,
+    // otherwise everything is indexed again.
+    index_state state;
+    if (incremental && !build_dir.empty())
+    {
+        state.load(index_state_file);
+    }
+
+    if (incremental && state.empty())
+    {
+        std::cerr << "no index state found, indexing everything\n";
+        incremental = false;
+    }
+
     memgraph_init mg;
 
     mg::Client::Params params;
@@ -1746,8 +3736,14 @@ int main(int argc, char ** argv)
         return 2;
     }
 
-    client->Execute("MATCH (n) DETACH DELETE n;");
-    client->DiscardAll();
+    // The shards of a run write to the same graph, it's cleared before
+    // they're started rather than by each of them.  The coordinator
+    // clears the graph its workers write to.
+    if (!incremental && !run_shard && worker_address.empty())
+    {
+        client->Execute("MATCH (n) DETACH DELETE n;");
+        client->DiscardAll();
+    }
 
     client->Execute("CREATE INDEX ON :Namespace(universal_symbol_reference);");
     client->DiscardAll();
@@ -1767,46 +3763,393 @@ int main(int argc, char ** argv)
     client->Execute("CREATE INDEX ON :Destructor(universal_symbol_reference);");
     client->DiscardAll();
 
-    ngclang::object<CXIndex, ngclang::dispose_index> index = clang_createIndex(0,1);
+    client->Execute("CREATE INDEX ON :UnresolvedFunction(universal_symbol_reference);");
+    client->DiscardAll();
+
+    // Concurrent writers merge the same nodes, the constraints stop two
+    // of them from both creating one.  A writer whose merge fails its
+    // constraint retries it and matches the other's node.
+    static constexpr std::array unique_constraints {
+        "CREATE CONSTRAINT ON (n:Namespace) ASSERT n.universal_symbol_reference IS UNIQUE;",
+        "CREATE CONSTRAINT ON (n:Class) ASSERT n.universal_symbol_reference IS UNIQUE;",
+        "CREATE CONSTRAINT ON (n:Function) ASSERT n.universal_symbol_reference IS UNIQUE;",
+        "CREATE CONSTRAINT ON (n:MemberFunction) ASSERT n.universal_symbol_reference IS UNIQUE;",
+        "CREATE CONSTRAINT ON (n:Constructor) ASSERT n.universal_symbol_reference IS UNIQUE;",
+        "CREATE CONSTRAINT ON (n:Destructor) ASSERT n.universal_symbol_reference IS UNIQUE;",
+        "CREATE CONSTRAINT ON (n:UnresolvedFunction) ASSERT n.universal_symbol_reference IS UNIQUE;",
+        "CREATE CONSTRAINT ON (n:NamespaceDeclaration) ASSERT n.file, n.line, n.column IS UNIQUE;",
+        "CREATE CONSTRAINT ON (n:ClassDeclaration) ASSERT n.file, n.line, n.column IS UNIQUE;",
+        "CREATE CONSTRAINT ON (n:FunctionDeclaration) ASSERT n.file, n.line, n.column IS UNIQUE;",
+        "CREATE CONSTRAINT ON (n:FunctionDefinition) ASSERT n.file, n.line, n.column IS UNIQUE;",
+        "CREATE CONSTRAINT ON (n:MemberFunctionDeclaration) ASSERT n.file, n.line, n.column IS UNIQUE;",
+        "CREATE CONSTRAINT ON (n:MemberFunctionDefinition) ASSERT n.file, n.line, n.column IS UNIQUE;",
+        "CREATE CONSTRAINT ON (n:ConstructorDeclaration) ASSERT n.file, n.line, n.column IS UNIQUE;",
+        "CREATE CONSTRAINT ON (n:ConstructorDefinition) ASSERT n.file, n.line, n.column IS UNIQUE;",
+        "CREATE CONSTRAINT ON (n:DestructorDeclaration) ASSERT n.file, n.line, n.column IS UNIQUE;",
+        "CREATE CONSTRAINT ON (n:DestructorDefinition) ASSERT n.file, n.line, n.column IS UNIQUE;"
+    };
+
+    const bool concurrent_writers =
+        jobs > 1 || run_shard || !coordinator_address.empty() || !worker_address.empty();
+    if (concurrent_writers)
+    {
+        for (const char * constraint: unique_constraints)
+        {
+            try
+            {
+                client->Execute(constraint);
+                client->DiscardAll();
+            }
+            catch (const mg::MgException & e)
+            {
+                std::cerr << "error creating constraint: " << e.what() << '\n';
+                return 2;
+            }
+        }
+    }
 
-    if (!file_to_parse.empty())
+    if (policy.single_file())
+    {
+        index_single_files(single_files(files_to_parse, policy.filter()), params, policy, jobs);
+    }
+    else if (!files_to_parse.empty())
     {
-        parse_file(index.get(), file_to_parse, *client);
+        ngclang::object<CXIndex, ngclang::dispose_index> index = clang_createIndex(0,1);
+        ngmg::client_connection connection {std::ref(*client)};
+        for (const auto & file: files_to_parse)
+        {
+            parse_file(index.get(), file, connection);
+        }
     }
     else if (!build_dir.empty())
     {
-        CXCompilationDatabase_Error error_code = CXCompilationDatabase_NoError;
-        ngclang::object<CXCompilationDatabase, ngclang::dispose_compilation_database>
-            compilation_database =
-            clang_CompilationDatabase_fromDirectory(build_dir.c_str(),
-                                                    &error_code);
+        // Compile commands whose file doesn't match the specified
+        // filter are skipped while the compile database is read.  A
+        // worker finds the compile commands it's sent by their position
+        // in the compile database, so it reads all of them.
+        compile_database::filter database_filter;
+        if (worker_address.empty())
+        {
+            database_filter = [&policy] (const std::filesystem::path & file) {
+                return policy.filter().parse_file(file);
+            };
+        }
 
-        if (error_code != CXCompilationDatabase_NoError)
+        std::unique_ptr<compile_database> database;
+        try
+        {
+            database = std::make_unique<compile_database>(build_dir, database_filter);
+        }
+        catch (const std::exception & e)
         {
-            std::cerr << "error creating compilation database" << std::endl;
+            std::cerr << "error creating compilation database: " << e.what() << std::endl;
             return 3;
         }
 
-        ngclang::object<CXCompileCommands, ngclang::dispose_compile_commands> compile_commands =
-            clang_CompilationDatabase_getAllCompileCommands(compilation_database.get());
+        if (timings_file.empty())
+        {
+            timings_file = std::filesystem::path(build_dir) / "cpp-graph-timings";
+            if (run_shard)
+            {
+                timings_file += "-shard-" + std::to_string(run_shard->index) + "-of-" + std::to_string(run_shard->count);
+            }
+        }
+
+        tu_timings timings;
+        timings.load(timings_file);
+
+        if (pch_dir.empty())
+        {
+            pch_dir = std::filesystem::path(build_dir) / "cpp-graph-pch";
+        }
+
+        pch_cache pch {pch_dir};
+
+        std::optional<ast_cache> cache;
+        if (!ast_cache_dir.empty())
+        {
+            cache.emplace(ast_cache_dir, ast_cache_size * 1024 * 1024);
+        }
+
+        if (!worker_address.empty())
+        {
+            graphed_files graphed;
+            std::vector<std::exception_ptr> worker_errors(jobs);
+            {
+                std::vector<std::jthread> workers;
+                for (unsigned int i = 0; i < jobs; ++i)
+                {
+                    workers.emplace_back([&worker_address, &database, &rewriter, &graphed, &cache, &params, &policy, engine, &error = worker_errors[i]] () {
+                        try
+                        {
+                            index_assigned_commands(worker_address, *database, rewriter, graphed, cache ? &*cache : nullptr, params, policy, engine);
+                        }
+                        catch (...)
+                        {
+                            error = std::current_exception();
+                        }
+                    });
+                }
+            }
+
+            if (cache)
+            {
+                cache->evict();
+            }
+
+            for (auto & error: worker_errors)
+            {
+                if (error)
+                {
+                    std::rethrow_exception(error);
+                }
+            }
+
+            return 0;
+        }
+
+        // files whose nodes are removed before they're graphed again
+        std::set<std::string> stale_files;
+        if (incremental)
+        {
+            const std::vector<std::string> changed_files = state.changed_files();
+            stale_files.insert(changed_files.cbegin(), changed_files.cend());
+        }
+
+        tu_scheduler scheduler;
+        tu_deduplicator deduplicator;
+
+        std::optional<unity_batches> unity;
+        if (unity_size > 0)
+        {
+            unity.emplace(std::filesystem::path(build_dir) / "cpp-graph-unity", unity_size);
+        }
 
-        const unsigned sizeof_compile_commands = clang_CompileCommands_getSize(compile_commands.get());
+        std::optional<source_cache> sources;
+        if (source_invalidation)
+        {
+            try
+            {
+                sources.emplace(*source_invalidation);
+            }
+            catch (const std::exception & e)
+            {
+                std::cerr << "error creating source cache: " << e.what() << std::endl;
+                return 3;
+            }
+        }
 
-        for (unsigned i = 0; i < sizeof_compile_commands; ++i)
+        // the original and rewritten arguments of the translation units
+        // whose arguments were rewritten, for --rewrite-report
+        std::vector<std::pair<std::unique_ptr<compile_command>, std::unique_ptr<compile_command>>> rewritten_commands;
+        std::unordered_map<const compile_command *, std::size_t> command_indexes;
+        std::size_t unchanged = 0;
+        for (const auto & entry: database->entries())
         {
-            CXCompileCommand compile_command =
-                clang_CompileCommands_getCommand(compile_commands.get(), i);
+            auto commands = std::make_unique<compile_command>(entry);
+            if (run_shard && !run_shard->contains(*commands))
+            {
+                continue;
+            }
+
+            // Objects built from the same file with different output
+            // or code generation arguments are only parsed once.
+            if (!deduplicator.add(*commands))
+            {
+                continue;
+            }
+
+            if (rewriter.rewrite(*commands) && report_rewriting)
+            {
+                auto rewritten = std::make_unique<compile_command>(entry);
+                rewriter.rewrite(*rewritten);
+                rewritten_commands.emplace_back(std::make_unique<compile_command>(entry), std::move(rewritten));
+            }
+
+            if (incremental)
+            {
+                state.found(*commands);
+                if (state.unchanged(*commands))
+                {
+                    ++unchanged;
+                    continue;
+                }
+
+                std::error_code ec;
+                const std::filesystem::path main_file = std::filesystem::canonical(commands->path(), ec);
+                if (!ec)
+                {
+                    stale_files.insert(main_file.string());
+                }
+            }
+
+            state.invalidate(*commands);
 
-            const std::filesystem::path file_path(ngclang::to_string(clang_CompileCommand_getFilename(compile_command)));
-            if (!policy.filter().parse_file(file_path))
+            if (use_pch)
             {
-                // The file does not match the specified filter so
-                // don't parse.
+                pch.add(*commands);
+            }
+
+            if (!coordinator_address.empty())
+            {
+                command_indexes.emplace(commands.get(), entry.index);
+            }
+
+            if (unity)
+            {
+                unity->add(std::move(commands));
                 continue;
             }
 
-            std::cout << "parsing: " << file_path << std::endl;
-            parse_compile_command(index.get(), compile_command, *client, policy);
+            scheduler.push_back(std::move(commands));
+        }
+
+        if (unity)
+        {
+            for (auto & commands: unity->build())
+            {
+                scheduler.push_back(std::move(commands));
+            }
+        }
+
+        // The translation units that were removed from the compile
+        // database are removed from the graph with the files only they
+        // included.
+        if (incremental)
+        {
+            const std::vector<std::string> removed_files = state.erase_missing([&policy] (const std::string & file) {
+                return policy.filter().parse_file(file);
+            });
+            for (const auto & file: removed_files)
+            {
+                std::error_code ec;
+                const std::filesystem::path path = std::filesystem::canonical(file, ec);
+                stale_files.insert(ec ? file : path.string());
+            }
+        }
+
+        if (print_dedup_statistics)
+        {
+            deduplicator.print_statistics(std::cout);
+        }
+
+        const std::size_t sizeof_translation_units = scheduler.size();
+        scheduler.schedule(timings);
+
+        if (!coordinator_address.empty())
+        {
+            coordinate_workers(coordinator_address, scheduler, command_indexes, timings);
+            save_timings(timings, timings_file);
+            return 0;
+        }
+
+        if (use_pch)
+        {
+            ngclang::object<CXIndex, ngclang::dispose_index> index = clang_createIndex(0,1);
+            pch.build(index.get(), policy.parse_options());
+        }
+
+        if (incremental)
+        {
+            std::cout << "unchanged: " << unchanged << ", changed: " << scheduler.size() << std::endl;
+            delete_file_subgraph(*client, stale_files);
+        }
+
+        graphed_files graphed;
+        std::vector<std::exception_ptr> worker_errors(jobs);
+        if (isolate)
+        {
+            std::filesystem::path slow_tus_file = std::filesystem::path(build_dir) / "cpp-graph-slow-tus";
+            if (run_shard)
+            {
+                slow_tus_file += "-shard-" + std::to_string(run_shard->index) + "-of-" + std::to_string(run_shard->count);
+            }
+
+            try
+            {
+                index_compile_commands_in_children(scheduler, timings, state, graphed, pch, cache ? &*cache : nullptr,
+                                                   *client, policy, engine, jobs, tu_budget, slow_tus_file);
+            }
+            catch (...)
+            {
+                worker_errors.front() = std::current_exception();
+            }
+        }
+        else
+        {
+            std::vector<std::jthread> workers;
+            for (unsigned int i = 0; i < jobs; ++i)
+            {
+                workers.emplace_back([&scheduler, &timings, &state, &graphed, &pch, &unity, &cache, &sources, &params, &policy, engine, &error = worker_errors[i]] () {
+                    try
+                    {
+                        index_compile_commands(scheduler, timings, state, graphed, pch, unity ? &*unity : nullptr,
+                                               cache ? &*cache : nullptr, sources ? &*sources : nullptr,
+                                               params, policy, engine);
+                    }
+                    catch (...)
+                    {
+                        error = std::current_exception();
+                    }
+                });
+            }
+        }
+
+        save_timings(timings, timings_file);
+
+        if (cache)
+        {
+            cache->evict();
+        }
+
+        if (incremental)
+        {
+            delete_undeclared_symbols(*client);
+        }
+
+        for (auto & error: worker_errors)
+        {
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+
+        if (report_rewriting)
+        {
+            report_rewrite_savings(rewritten_commands, sizeof_translation_units, policy.parse_options());
+        }
+
+        // A shard's state would only cover part of the graph.
+        if (!run_shard)
+        {
+            try
+            {
+                state.save(index_state_file);
+            }
+            catch (const std::exception & e)
+            {
+                std::cerr << "error saving index state: " << e.what() << '\n';
+                if (daemon_socket.empty() && !watch)
+                {
+                    return 1;
+                }
+            }
+        }
+
+        if (!daemon_socket.empty() || watch)
+        {
+            reindexer files_reindexer {*database, rewriter, *client, policy, state, index_state_file,
+                                       tu_cache_size * 1024 * 1024};
+            std::cout << files_reindexer.preload() << std::flush;
+            if (watch)
+            {
+                watch_files(files_reindexer, state, debounce);
+            }
+            else
+            {
+                serve_reindex_requests(daemon_socket, files_reindexer);
+            }
         }
     }
 
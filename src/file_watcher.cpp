@@ -0,0 +1,143 @@
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include "file_watcher.hpp"
+#include <filesystem>
+#include <poll.h>
+#include <set>
+#include <string>
+#include <sys/inotify.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace
+{
+    constexpr std::uint32_t watch_mask =
+        IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_MOVED_FROM;
+}
+
+file_watcher::file_watcher():
+    _fd(::inotify_init1(IN_CLOEXEC))
+{
+    if (this->_fd < 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "inotify_init1");
+    }
+}
+
+file_watcher::~file_watcher()
+{
+    ::close(this->_fd);
+}
+
+bool
+file_watcher::add_directory(const std::filesystem::path & directory)
+{
+    const int wd = ::inotify_add_watch(this->_fd, directory.c_str(), watch_mask | IN_ONLYDIR);
+    if (wd < 0)
+    {
+        return false;
+    }
+
+    this->_directories[wd] = directory;
+    return true;
+}
+
+std::size_t
+file_watcher::size() const noexcept
+{
+    return this->_directories.size();
+}
+
+file_watcher::change_set
+file_watcher::wait(std::chrono::milliseconds debounce)
+{
+    change_set changes;
+    while (!this->read_events(-1, changes))
+    {}
+
+    while (this->read_events(static_cast<int>(debounce.count()), changes))
+    {}
+
+    return changes;
+}
+
+file_watcher::change_set
+file_watcher::changes()
+{
+    change_set changes;
+    while (this->read_events(0, changes))
+    {}
+
+    return changes;
+}
+
+bool
+file_watcher::read_events(int timeout, change_set & changes)
+{
+    pollfd fd {this->_fd, POLLIN, 0};
+    const int ready = ::poll(&fd, 1, timeout);
+    if (ready < 0)
+    {
+        if (errno == EINTR)
+        {
+            return false;
+        }
+
+        throw std::system_error(errno, std::generic_category(), "poll");
+    }
+
+    if (ready == 0)
+    {
+        return false;
+    }
+
+    alignas(inotify_event) char buffer[4096];
+    const ssize_t size = ::read(this->_fd, buffer, sizeof(buffer));
+    if (size < 0)
+    {
+        if (errno == EINTR || errno == EAGAIN)
+        {
+            return false;
+        }
+
+        throw std::system_error(errno, std::generic_category(), "read inotify events");
+    }
+
+    for (ssize_t offset = 0; offset < size;)
+    {
+        const auto * event = reinterpret_cast<const inotify_event *>(buffer + offset);
+        offset += sizeof(inotify_event) + event->len;
+
+        if (event->mask & IN_Q_OVERFLOW)
+        {
+            changes.overflow = true;
+            continue;
+        }
+
+        const auto directory = this->_directories.find(event->wd);
+        if (directory == this->_directories.end())
+        {
+            continue;
+        }
+
+        // The watch is removed when its directory is deleted or its
+        // file system is unmounted.
+        if (event->mask & IN_IGNORED)
+        {
+            changes.unwatched.insert(directory->second.string());
+            this->_directories.erase(directory);
+            continue;
+        }
+
+        if (event->len == 0 || (event->mask & IN_ISDIR))
+        {
+            continue;
+        }
+
+        changes.files.insert((directory->second / event->name).string());
+    }
+
+    return true;
+}
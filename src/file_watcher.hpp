@@ -0,0 +1,71 @@
+#ifndef FILE_WATCHER_HPP
+#define FILE_WATCHER_HPP
+
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <string>
+
+/** Watches directories with inotify for files that are written,
+ *  created, moved in or removed.
+ */
+class file_watcher
+{
+    public:
+
+    file_watcher();
+
+    ~file_watcher();
+
+    file_watcher(const file_watcher &) = delete;
+    file_watcher& operator = (const file_watcher &) = delete;
+
+    /// The changes inotify reported
+    struct change_set
+    {
+        /// The paths of the changed files
+        std::set<std::string> files;
+
+        /// The watched directories that were deleted or unmounted,
+        /// they are no longer watched
+        std::set<std::string> unwatched;
+
+        /// True if inotify's queue overflowed and changes were lost,
+        /// so any file in a watched directory may have changed
+        bool overflow = false;
+    };
+
+    /// Watches directory, returns false if it can't be watched
+    bool
+    add_directory(const std::filesystem::path & directory);
+
+    /// The number of watched directories
+    std::size_t
+    size() const noexcept;
+
+    /** Waits for a change and returns the changes.
+     *
+     *  Changes are collected until none happened for debounce, so a
+     *  burst of changes, like a build or a checkout, is returned at
+     *  once.
+     */
+    change_set
+    wait(std::chrono::milliseconds debounce);
+
+    /// Returns the changes since the last call, without waiting
+    change_set
+    changes();
+
+    private:
+
+    /// Reads the pending events into changes, waiting at most timeout,
+    /// returns false if no event arrived in time
+    bool
+    read_events(int timeout, change_set & changes);
+
+    int _fd = -1;
+    std::map<int, std::filesystem::path> _directories;
+};
+
+#endif
@@ -0,0 +1,178 @@
+#include <clang-c/Index.h>
+#include "function_labels.hpp"
+#include "ngclang.hpp"
+#include <stdexcept>
+#include <string>
+
+void
+function_labels(CXCursor cursor,
+                std::string * label,
+                std::string * decl_label,
+                std::string * def_label)
+{
+    ngclang::cursor_facts facts {cursor};
+    function_labels(facts, label, decl_label, def_label);
+}
+
+void
+function_labels(ngclang::cursor_facts & facts,
+                std::string * label,
+                std::string * decl_label,
+                std::string * def_label)
+{
+    switch (facts.kind())
+    {
+        case CXCursor_FunctionDecl:
+        {
+            if (label)
+            {
+                *label = "Function";
+            }
+            if (decl_label)
+            {
+                *decl_label = "FunctionDeclaration";
+            }
+            if (def_label)
+            {
+                *def_label = "FunctionDefinition";
+            }
+
+            break;
+        }
+        case CXCursor_FunctionTemplate:
+        {
+            CXCursor semantic_parent = facts.semantic_parent();
+            if (!clang_Cursor_isNull(semantic_parent))
+            {
+                const auto parent_kind = clang_getCursorKind(semantic_parent);
+                switch(parent_kind)
+                {
+                    case CXCursor_ClassDecl:
+                    {
+                        if (label)
+                        {
+                            *label = "MemberFunction";
+                        }
+                        if (decl_label)
+                        {
+                            *decl_label = "MemberFunctionDeclaration";
+                        }
+                        if (def_label)
+                        {
+                            *def_label = "MemberFunctionDefinition";
+                        }
+
+                        break;
+                    }
+                    case CXCursor_ClassTemplate:
+                    {
+                        if (label)
+                        {
+                            *label = "MemberFunction";
+                        }
+                        if (decl_label)
+                        {
+                            *decl_label = "MemberFunctionDeclaration";
+                        }
+                        if (def_label)
+                        {
+                            *def_label = "MemberFunctionDefinition";
+                        }
+
+                        break;
+                    }
+                    default:
+                    {
+                        if (label)
+                        {
+                            *label = "Function";
+                        }
+                        if (decl_label)
+                        {
+                            *decl_label = "FunctionDeclaration";
+                        }
+                        if (def_label)
+                        {
+                            *def_label = "FunctionDefinition";
+                        }
+
+                        break;
+                    }
+                }
+            }
+            else
+            {
+                if (label)
+                {
+                    *label = "Function";
+                }
+                if (decl_label)
+                {
+                    *decl_label = "FunctionDeclaration";
+                }
+                if (def_label)
+                {
+                    *def_label = "FunctionDefinition";
+                }
+
+            }
+
+            break;
+        }
+        case CXCursor_CXXMethod:
+        {
+            if (label)
+            {
+                *label = "MemberFunction";
+            }
+            if (decl_label)
+            {
+                *decl_label = "MemberFunctionDeclaration";
+            }
+            if (def_label)
+            {
+                *def_label = "MemberFunctionDefinition";
+            }
+
+            break;
+        }
+        case CXCursor_Constructor:
+        {
+            if (label)
+            {
+                *label = "Constructor";
+            }
+            if (decl_label)
+            {
+                *decl_label = "ConstructorDeclaration";
+            }
+            if (def_label)
+            {
+                *def_label = "ConstructorDefinition";
+            }
+
+            break;
+        }
+        case CXCursor_Destructor:
+        {
+            if (label)
+            {
+                *label = "Destructor";
+            }
+            if (decl_label)
+            {
+                *decl_label = "DestructorDeclaration";
+            }
+            if (def_label)
+            {
+                *def_label = "DestructorDefinition";
+            }
+
+            break;
+        }
+        default:
+        {
+            throw std::logic_error("not a function");
+        }
+    };
+}
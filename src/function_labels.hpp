@@ -0,0 +1,25 @@
+#ifndef FUNCTION_LABELS_HPP
+#define FUNCTION_LABELS_HPP
+
+#include <clang-c/Index.h>
+#include "ngclang.hpp"
+#include <string>
+
+/// Sets the node labels of a function, its declarations and its
+/// definitions based on the kind of function cursor is.  Throws
+/// std::logic_error if cursor is not a function.
+void
+function_labels(CXCursor cursor,
+                std::string * label,
+                std::string * decl_label,
+                std::string * def_label);
+
+/// As above, with the kind and semantic parent of the function taken
+/// from facts
+void
+function_labels(ngclang::cursor_facts & facts,
+                std::string * label,
+                std::string * decl_label,
+                std::string * def_label);
+
+#endif
@@ -0,0 +1,34 @@
+#include <functional>
+#include "graph_connection.hpp"
+#include "memgraph/cypher.hpp"
+#include <mgclient.hpp>
+#include "statement_executor.hpp"
+#include <string>
+
+ngmg::connection::~connection() = default;
+
+ngmg::client_connection::client_connection(std::reference_wrapper<mg::Client> client):
+    _client(&client.get())
+{}
+
+void
+ngmg::client_connection::write(const std::string & statement, bool existing_ok)
+{
+    ngmg::cypher::detail::execute_write(*this->_client, statement, existing_ok);
+}
+
+bool
+ngmg::client_connection::exists(const std::string & statement)
+{
+    ngmg::statement_executor executor(std::ref(*this->_client));
+    executor.execute(statement);
+
+    const auto row = this->_client->FetchOne();
+    return row && !row->empty();
+}
+
+mg::Client *
+ngmg::client_connection::client() noexcept
+{
+    return this->_client;
+}
@@ -0,0 +1,69 @@
+#ifndef GRAPH_CONNECTION_HPP
+#define GRAPH_CONNECTION_HPP
+
+#include <functional>
+#include <string>
+
+namespace mg
+{
+    class Client;
+}
+
+namespace ngmg
+{
+    /** Where the statements that build the graph are executed.
+     *
+     *  The graph is built with statements that write to it, and
+     *  statements that check whether a node or relationship exists
+     *  before it's created, so a connection only has to execute those
+     *  two kinds.
+     */
+    class connection
+    {
+        public:
+
+        virtual
+        ~connection();
+
+        /// Executes a statement that writes to the graph, see
+        /// ngmg::cypher::detail::execute_write
+        virtual
+        void
+        write(const std::string & statement, bool existing_ok) = 0;
+
+        /// Executes a statement and returns true if it returned a row
+        virtual
+        bool
+        exists(const std::string & statement) = 0;
+
+        /// The client statements are executed with, or nullptr if they
+        /// are executed by another process
+        virtual
+        mg::Client *
+        client() noexcept = 0;
+    };
+
+    /// A connection that executes statements with a memgraph client
+    class client_connection: public connection
+    {
+        public:
+
+        explicit
+        client_connection(std::reference_wrapper<mg::Client> client);
+
+        void
+        write(const std::string & statement, bool existing_ok) override;
+
+        bool
+        exists(const std::string & statement) override;
+
+        mg::Client *
+        client() noexcept override;
+
+        private:
+
+        mg::Client * _client;
+    };
+}
+
+#endif
@@ -0,0 +1,61 @@
+#include <clang-c/Index.h>
+#include "content_hash.hpp"
+#include "graphed_files.hpp"
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+std::optional<graphed_files::file_id>
+graphed_files::identify(CXTranslationUnit unit, CXFile file)
+{
+    CXFileUniqueID unique_id;
+    if (clang_getFileUniqueID(file, &unique_id) != 0)
+    {
+        return std::nullopt;
+    }
+
+    size_t size = 0;
+    char const * const contents = clang_getFileContents(unit, file, &size);
+    if (!contents)
+    {
+        return std::nullopt;
+    }
+
+    file_id id;
+    id.device = unique_id.data[0];
+    id.inode = unique_id.data[1];
+    id.mtime = unique_id.data[2];
+    id.content_hash = content_hash(std::string_view(contents, size));
+    return id;
+}
+
+graphed_files::graphed_files(const graphed_files * base):
+    _base(base)
+{}
+
+bool
+graphed_files::contains(const file_id & id) const
+{
+    if (this->_base && this->_base->contains(id))
+    {
+        return true;
+    }
+
+    const std::lock_guard lock(this->_mutex);
+    return this->_files.contains(id);
+}
+
+void
+graphed_files::insert(const std::vector<file_id> & ids)
+{
+    const std::lock_guard lock(this->_mutex);
+    this->_files.insert(ids.cbegin(), ids.cend());
+}
+
+std::vector<graphed_files::file_id>
+graphed_files::files() const
+{
+    const std::lock_guard lock(this->_mutex);
+    return {this->_files.cbegin(), this->_files.cend()};
+}
@@ -0,0 +1,67 @@
+#ifndef GRAPHED_FILES_HPP
+#define GRAPHED_FILES_HPP
+
+#include <clang-c/Index.h>
+#include <compare>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <vector>
+
+/** Files whose declarations have been completely graphed by a
+ *  translation unit in this session.
+ *
+ *  A file is identified by its libclang unique ID and the hash of its
+ *  contents, so an edited file is graphed again.
+ *
+ *  A set can be layered on a base set, it then also contains the files
+ *  of the base but only its own are inserted and listed.
+ */
+class graphed_files
+{
+    public:
+
+    struct file_id
+    {
+        std::uint64_t device = 0;
+        std::uint64_t inode = 0;
+        std::uint64_t mtime = 0;
+        std::uint64_t content_hash = 0;
+
+        auto operator <=> (const file_id &) const = default;
+    };
+
+    /// Returns the identity of file in unit, or nothing if libclang
+    /// can't provide one
+    static
+    std::optional<file_id>
+    identify(CXTranslationUnit unit, CXFile file);
+
+    graphed_files() = default;
+
+    /// Layers the set on base, which must outlive it
+    explicit
+    graphed_files(const graphed_files * base);
+
+    graphed_files(const graphed_files &) = delete;
+    graphed_files& operator = (const graphed_files &) = delete;
+
+    bool
+    contains(const file_id & id) const;
+
+    void
+    insert(const std::vector<file_id> & ids);
+
+    /// The files inserted into this set, not those of its base
+    std::vector<file_id>
+    files() const;
+
+    private:
+
+    const graphed_files * const _base = nullptr;
+    mutable std::mutex _mutex;
+    std::set<file_id> _files;
+};
+
+#endif
@@ -0,0 +1,351 @@
+#include <algorithm>
+#include "compile_command.hpp"
+#include "content_hash.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include "index_state.hpp"
+#include <mutex>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+// The state file is made up of the following lines:
+//
+// file <hash> <size> <mtime> <path>
+// tu <argument hash> <path>
+// include <path>
+//
+// include lines list the files included by the preceding tu line.
+
+namespace
+{
+    std::uint64_t
+    arguments_hash(const compile_command & command)
+    {
+        std::uint64_t hash = content_hash_seed;
+        for (std::size_t i = 0; i < command.size(); ++i)
+        {
+            // a precompiled header doesn't change what's indexed
+            if (std::string_view(command.array()[i]) == "-include-pch")
+            {
+                ++i;
+                continue;
+            }
+
+            // include the terminating null so argument boundaries
+            // contribute to the hash
+            const std::string_view arg = command.array()[i];
+            hash = content_hash(std::string_view(arg.data(), arg.size() + 1), hash);
+        }
+
+        return hash;
+    }
+}
+
+void
+index_state::load(const std::filesystem::path & file)
+{
+    std::ifstream stream(file);
+    if (!stream)
+    {
+        return;
+    }
+
+    const std::lock_guard lock(this->_mutex);
+    std::vector<std::string> * includes = nullptr;
+    std::string line;
+    while (std::getline(stream, line))
+    {
+        std::istringstream line_stream(line);
+        std::string type;
+        line_stream >> type;
+
+        if (type == "file")
+        {
+            file_entry entry;
+            std::string path;
+            line_stream >> entry.hash >> entry.size >> entry.mtime;
+            if (line_stream.get() == ' ' && std::getline(line_stream, path))
+            {
+                this->_files[path] = entry;
+            }
+        }
+        else if (type == "tu")
+        {
+            std::uint64_t hash;
+            std::string path;
+            line_stream >> hash;
+            if (line_stream.get() == ' ' && std::getline(line_stream, path))
+            {
+                includes = &this->_tus[{path, hash}];
+            }
+        }
+        else if (type == "include" && includes)
+        {
+            std::string path;
+            if (line_stream.get() == ' ' && std::getline(line_stream, path))
+            {
+                includes->push_back(path);
+            }
+        }
+    }
+}
+
+void
+index_state::save(const std::filesystem::path & file)
+{
+    std::filesystem::path tmp_file = file;
+    tmp_file += ".tmp";
+
+    {
+        std::ofstream stream(tmp_file, std::ios::trunc);
+        const std::lock_guard lock(this->_mutex);
+
+        std::set<std::string> files;
+        std::map<std::string, file_entry> saved_files;
+        for (const auto & [key, includes]: this->_tus)
+        {
+            if (!this->current(key.first) || this->_invalid_tus.contains(key))
+            {
+                // the main file was removed, or it wasn't graphed again
+                continue;
+            }
+
+            stream << "tu " << key.second << ' ' << key.first << '\n';
+            for (const auto & include: includes)
+            {
+                stream << "include " << include << '\n';
+                files.insert(include);
+            }
+        }
+
+        for (const auto & f: files)
+        {
+            const auto & entry = this->current(f);
+            if (entry)
+            {
+                stream << "file " << entry->hash << ' ' << entry->size << ' ' << entry->mtime << ' ' << f << '\n';
+                saved_files.emplace(f, *entry);
+            }
+        }
+
+        // Files are looked at again when they're next used.  The state
+        // in memory moves on even if it can't be written, so a
+        // daemon's next changes are found against it.
+        this->_files = std::move(saved_files);
+        this->_current_files.clear();
+
+        if (!stream)
+        {
+            throw std::runtime_error("error writing " + tmp_file.string());
+        }
+    }
+
+    std::filesystem::rename(tmp_file, file);
+}
+
+bool
+index_state::empty() const
+{
+    const std::lock_guard lock(this->_mutex);
+    return this->_tus.empty();
+}
+
+bool
+index_state::unchanged(const compile_command & command)
+{
+    const std::lock_guard lock(this->_mutex);
+    const auto tu = this->_tus.find({command.path().string(), arguments_hash(command)});
+    if (tu == this->_tus.end())
+    {
+        return false;
+    }
+
+    return std::all_of(tu->second.cbegin(), tu->second.cend(), [this] (const std::string & f) {
+        const auto previous = this->_files.find(f);
+        const auto & current = this->current(f);
+        return previous != this->_files.end() && current && current->hash == previous->second.hash;
+    });
+}
+
+void
+index_state::record(const compile_command & command, std::vector<std::string> files)
+{
+    std::sort(files.begin(), files.end());
+    files.erase(std::unique(files.begin(), files.end()), files.end());
+
+    const tu_key key {command.path().string(), arguments_hash(command)};
+    const std::lock_guard lock(this->_mutex);
+    this->_tus[key] = std::move(files);
+    this->_invalid_tus.erase(key);
+}
+
+void
+index_state::invalidate(const compile_command & command)
+{
+    const tu_key key {command.path().string(), arguments_hash(command)};
+    const std::lock_guard lock(this->_mutex);
+    this->_invalid_tus.insert(key);
+}
+
+void
+index_state::found(const compile_command & command)
+{
+    const tu_key key {command.path().string(), arguments_hash(command)};
+    const std::lock_guard lock(this->_mutex);
+    this->_found_tus.insert(key);
+}
+
+std::vector<std::string>
+index_state::erase_missing(const std::function<bool (const std::string &)> & selected)
+{
+    const std::lock_guard lock(this->_mutex);
+    std::set<std::string> files;
+    for (auto i = this->_tus.begin(); i != this->_tus.end();)
+    {
+        if (this->_found_tus.contains(i->first) || !selected(i->first.first))
+        {
+            ++i;
+            continue;
+        }
+
+        files.insert(i->first.first);
+        files.insert(i->second.cbegin(), i->second.cend());
+        i = this->_tus.erase(i);
+    }
+
+    for (const auto & [key, includes]: this->_tus)
+    {
+        for (const auto & include: includes)
+        {
+            files.erase(include);
+        }
+    }
+
+    return std::vector<std::string>(files.cbegin(), files.cend());
+}
+
+std::vector<std::string>
+index_state::includes(const compile_command & command) const
+{
+    const std::lock_guard lock(this->_mutex);
+    const auto tu = this->_tus.find({command.path().string(), arguments_hash(command)});
+    return (tu == this->_tus.end()) ? std::vector<std::string>() : tu->second;
+}
+
+std::vector<std::string>
+index_state::changed_files()
+{
+    const std::lock_guard lock(this->_mutex);
+    std::vector<std::string> files;
+    for (const auto & [f, previous]: this->_files)
+    {
+        const auto & current = this->current(f);
+        if (!current || current->hash != previous.hash)
+        {
+            files.push_back(f);
+        }
+    }
+
+    return files;
+}
+
+void
+index_state::forget(const std::set<std::string> & files)
+{
+    const std::lock_guard lock(this->_mutex);
+    for (const auto & f: files)
+    {
+        this->_current_files.erase(f);
+    }
+}
+
+void
+index_state::forget()
+{
+    const std::lock_guard lock(this->_mutex);
+    this->_current_files.clear();
+}
+
+std::vector<std::string>
+index_state::translation_units_including(const std::string & file) const
+{
+    const std::lock_guard lock(this->_mutex);
+    std::vector<std::string> tus;
+    for (const auto & [key, includes]: this->_tus)
+    {
+        if (std::binary_search(includes.cbegin(), includes.cend(), file))
+        {
+            tus.push_back(key.first);
+        }
+    }
+
+    return tus;
+}
+
+std::set<std::string>
+index_state::files() const
+{
+    const std::lock_guard lock(this->_mutex);
+    std::set<std::string> files;
+    for (const auto & [key, includes]: this->_tus)
+    {
+        files.insert(includes.cbegin(), includes.cend());
+    }
+
+    return files;
+}
+
+const std::optional<index_state::file_entry> &
+index_state::current(const std::string & file)
+{
+    const auto [i, inserted] = this->_current_files.try_emplace(file);
+    if (!inserted)
+    {
+        return i->second;
+    }
+
+    std::error_code ec;
+    const std::uintmax_t size = std::filesystem::file_size(file, ec);
+    if (ec)
+    {
+        return i->second;
+    }
+
+    const auto mtime = std::filesystem::last_write_time(file, ec);
+    if (ec)
+    {
+        return i->second;
+    }
+
+    file_entry entry;
+    entry.size = size;
+    entry.mtime = mtime.time_since_epoch().count();
+
+    // Only read files whose size or modification time changed.
+    const auto previous = this->_files.find(file);
+    if (previous != this->_files.end() &&
+        previous->second.size == entry.size &&
+        previous->second.mtime == entry.mtime)
+    {
+        entry.hash = previous->second.hash;
+        i->second = entry;
+        return i->second;
+    }
+
+    const auto hash = file_content_hash(file);
+    if (hash)
+    {
+        entry.hash = *hash;
+        i->second = entry;
+    }
+
+    return i->second;
+}
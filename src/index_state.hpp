@@ -0,0 +1,129 @@
+#ifndef INDEX_STATE_HPP
+#define INDEX_STATE_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+class compile_command;
+
+/** What the previous run indexed, used to only re-index translation
+ *  units that changed.
+ *
+ *  A translation unit is identified by its main file and a hash of its
+ *  arguments.  For each translation unit the files it includes are
+ *  recorded, and for each file the hash of its contents.
+ */
+class index_state
+{
+    public:
+
+    index_state() = default;
+
+    index_state(const index_state &) = delete;
+    index_state& operator = (const index_state &) = delete;
+
+    /// Loads the state in file, a missing file is not an error
+    void
+    load(const std::filesystem::path & file);
+
+    /// Saves the state, which then becomes the previous state even if
+    /// it can't be written.  Throws std::runtime_error or
+    /// std::filesystem::filesystem_error if it can't be written.
+    void
+    save(const std::filesystem::path & file);
+
+    /// True if no translation units are recorded
+    bool
+    empty() const;
+
+    /// True if command was indexed with the same arguments and none of
+    /// the files it includes changed since
+    bool
+    unchanged(const compile_command & command);
+
+    /// Records the files included by the translation unit of command
+    void
+    record(const compile_command & command, std::vector<std::string> files);
+
+    /// Leaves the translation unit of command out of the saved state
+    /// until it's recorded again, so one whose part of the graph was
+    /// removed but that failed to be graphed again is indexed next time
+    void
+    invalidate(const compile_command & command);
+
+    /// Marks the translation unit of command as still in the compile
+    /// database
+    void
+    found(const compile_command & command);
+
+    /** Forgets the recorded translation units that weren't found and
+     *  whose main file selected returns true for.
+     *
+     *  Returns their main files and the files that no other recorded
+     *  translation unit includes.
+     */
+    std::vector<std::string>
+    erase_missing(const std::function<bool (const std::string &)> & selected);
+
+    /// The files recorded for the translation unit of command, empty
+    /// if it isn't recorded
+    std::vector<std::string>
+    includes(const compile_command & command) const;
+
+    /// Recorded files whose contents changed or that no longer exist
+    std::vector<std::string>
+    changed_files();
+
+    /// Looks at files again the next time they're used, rather than
+    /// reusing their state from earlier in the run
+    void
+    forget(const std::set<std::string> & files);
+
+    /// Looks at every file again the next time it's used
+    void
+    forget();
+
+    /// The main files of the recorded translation units that include file
+    std::vector<std::string>
+    translation_units_including(const std::string & file) const;
+
+    /// The files included by the recorded translation units
+    std::set<std::string>
+    files() const;
+
+    private:
+
+    struct file_entry
+    {
+        std::uint64_t hash = 0;
+        std::uintmax_t size = 0;
+        std::int64_t mtime = 0;
+    };
+
+    using tu_key = std::pair<std::string, std::uint64_t>;
+
+    const std::optional<file_entry> &
+    current(const std::string & file);
+
+    mutable std::mutex _mutex;
+    std::map<tu_key, std::vector<std::string>> _tus;
+    std::map<std::string, file_entry> _files;
+
+    // the translation units being reindexed, and those found in the
+    // compile database during this run
+    std::set<tu_key> _invalid_tus;
+    std::set<tu_key> _found_tus;
+
+    // the state of each file looked at during this run
+    std::map<std::string, std::optional<file_entry>> _current_files;
+};
+
+#endif
@@ -0,0 +1,581 @@
+#include <clang-c/Index.h>
+#include "class_decl_node.hpp"
+#include "class_node.hpp"
+#include "compile_command.hpp"
+#include "edge_labels.hpp"
+#include <exception>
+#include "function_decl_def_node.hpp"
+#include "function_labels.hpp"
+#include "function_node.hpp"
+#include "graph_connection.hpp"
+#include "indexer.hpp"
+#include <iostream>
+#include "location_properties.hpp"
+#include "memgraph/cypher.hpp"
+#include <mgclient.hpp>
+#include "namespace_decl_node.hpp"
+#include "namespace_node.hpp"
+#include "ngclang.hpp"
+#include <string>
+#include "universal_symbol_reference_property.hpp"
+#include <utility>
+#include <vector>
+
+namespace
+{
+    /// Returns the names of the namespaces and classes cursor is
+    /// declared in separated by "::"
+    std::string
+    scope_name(CXCursor cursor)
+    {
+        std::vector<std::string> names;
+        for (CXCursor parent = clang_getCursorSemanticParent(cursor);
+             !clang_Cursor_isNull(parent);
+             parent = clang_getCursorSemanticParent(parent))
+        {
+            switch (clang_getCursorKind(parent))
+            {
+                case CXCursor_Namespace:
+                case CXCursor_ClassDecl:
+                case CXCursor_ClassTemplate:
+                {
+                    names.push_back(ngclang::to_string(parent, &clang_getCursorDisplayName));
+                    break;
+                }
+                default:
+                {
+                    break;
+                }
+            }
+        }
+
+        std::string name;
+        for (auto i = names.crbegin(); i != names.crend(); ++i)
+        {
+            if (!name.empty())
+            {
+                name += "::";
+            }
+
+            name += *i;
+        }
+
+        return name;
+    }
+
+    /// Returns the fully qualified name of a namespace or class
+    std::string
+    qualified_name(CXCursor cursor)
+    {
+        std::string name = scope_name(cursor);
+        if (!name.empty())
+        {
+            name += "::";
+        }
+
+        name += ngclang::to_string(cursor, &clang_getCursorDisplayName);
+        return name;
+    }
+
+    bool
+    in_system_header(CXIdxLoc location)
+    {
+        return clang_Location_isInSystemHeader(clang_indexLoc_getCXSourceLocation(location)) != 0;
+    }
+
+    bool
+    is_function(CXIdxEntityKind kind)
+    {
+        switch (kind)
+        {
+            case CXIdxEntity_Function:
+            case CXIdxEntity_CXXStaticMethod:
+            case CXIdxEntity_CXXInstanceMethod:
+            case CXIdxEntity_CXXConstructor:
+            case CXIdxEntity_CXXDestructor:
+            case CXIdxEntity_CXXConversionFunction:
+            {
+                return true;
+            }
+            default:
+            {
+                return false;
+            }
+        }
+    }
+}
+
+indexer::indexer(CXIndex index,
+                 std::reference_wrapper<ngmg::connection> connection,
+                 unsigned parse_options,
+                 file_filter filter):
+    _action(clang_IndexAction_create(index)),
+    _connection(&connection.get()),
+    _parse_options(parse_options),
+    _filter(std::move(filter))
+{}
+
+bool
+indexer::index(const compile_command & commands, std::vector<std::string> * includes)
+{
+    IndexerCallbacks callbacks = {};
+    callbacks.abortQuery = &indexer::abort_query;
+    callbacks.indexDeclaration = &indexer::index_declaration;
+    if (!(this->_parse_options & CXTranslationUnit_SkipFunctionBodies))
+    {
+        callbacks.indexEntityReference = &indexer::index_entity_reference;
+    }
+
+    // CXFile handles are only valid within a translation unit
+    this->_skip_files.clear();
+
+    ngclang::translation_unit_t unit {nullptr};
+    const int error =
+        clang_indexSourceFileFullArgv(
+            this->_action.get(),
+            this,
+            &callbacks,
+            sizeof(callbacks),
+            // CXIndexOpt_SuppressRedundantRefs is not used because it
+            // drops calls to functions that were already referenced
+            // or are declared in the same file.
+            CXIndexOpt_SkipParsedBodiesInSession | CXIndexOpt_SuppressWarnings,
+            nullptr,
+            commands.array(),
+            commands.size(),
+            nullptr,
+            0,
+            includes ? &unit.get() : nullptr,
+            this->_parse_options);
+
+    if (this->_error)
+    {
+        const std::exception_ptr callback_error = this->_error;
+        this->_error = nullptr;
+        std::rethrow_exception(callback_error);
+    }
+
+    if (error != 0)
+    {
+        std::cerr << "error parsing file\n";
+        return false;
+    }
+
+    if (includes && unit.get())
+    {
+        *includes = ngclang::included_files(unit.get());
+    }
+
+    return true;
+}
+
+int
+indexer::abort_query(CXClientData client_data, void *)
+{
+    const indexer & i = *(reinterpret_cast<indexer *>(client_data));
+    return i._error ? 1 : 0;
+}
+
+void
+indexer::index_declaration(CXClientData client_data, const CXIdxDeclInfo * info)
+{
+    indexer & i = *(reinterpret_cast<indexer *>(client_data));
+    if (i._error)
+    {
+        return;
+    }
+
+    // Exceptions can't propagate through libclang, so the first one is
+    // kept and rethrown once indexing is aborted.
+    try
+    {
+        i.graph_declaration(*info);
+    }
+    catch (...)
+    {
+        i._error = std::current_exception();
+    }
+}
+
+void
+indexer::index_entity_reference(CXClientData client_data, const CXIdxEntityRefInfo * info)
+{
+    indexer & i = *(reinterpret_cast<indexer *>(client_data));
+    if (i._error)
+    {
+        return;
+    }
+
+    try
+    {
+        i.graph_reference(*info);
+    }
+    catch (...)
+    {
+        i._error = std::current_exception();
+    }
+}
+
+bool
+indexer::skip_location(CXIdxLoc location)
+{
+    if (!this->_filter)
+    {
+        return false;
+    }
+
+    CXFile file = nullptr;
+    clang_indexLoc_getFileLocation(location, nullptr, &file, nullptr, nullptr, nullptr);
+    if (!file)
+    {
+        return false;
+    }
+
+    const auto [i, inserted] = this->_skip_files.try_emplace(file, false);
+    if (inserted)
+    {
+        i->second = !this->_filter(file);
+    }
+
+    return i->second;
+}
+
+void
+indexer::graph_declaration(const CXIdxDeclInfo & info)
+{
+    if (info.isImplicit || !info.entityInfo || in_system_header(info.loc) || this->skip_location(info.loc))
+    {
+        return;
+    }
+
+    switch (clang_getCursorKind(info.cursor))
+    {
+        case CXCursor_Namespace:
+        {
+            this->graph_namespace(info);
+            break;
+        }
+        case CXCursor_ClassDecl:
+        case CXCursor_ClassTemplate:
+        {
+            this->graph_class(info);
+            break;
+        }
+        case CXCursor_FunctionDecl:
+        case CXCursor_FunctionTemplate:
+        case CXCursor_Constructor:
+        case CXCursor_Destructor:
+        {
+            if (this->graph_function(info))
+            {
+                this->graph_parent(info);
+            }
+
+            break;
+        }
+        case CXCursor_CXXMethod:
+        {
+            if (this->graph_function(info))
+            {
+                this->graph_parent(info);
+                this->graph_overrides(info.cursor);
+            }
+
+            break;
+        }
+        default:
+        {
+            break;
+        }
+    }
+
+    const CXIdxCXXClassDeclInfo * class_info = clang_index_getCXXClassDeclInfo(&info);
+    if (!class_info)
+    {
+        return;
+    }
+
+    universal_symbol_reference_property child_usr;
+    child_usr.prop = info.entityInfo->USR ? info.entityInfo->USR : "";
+
+    for (unsigned i = 0; i < class_info->numBases; ++i)
+    {
+        const CXIdxEntityInfo * base = class_info->bases[i]->base;
+        if (!base || !base->USR)
+        {
+            continue;
+        }
+
+        universal_symbol_reference_property base_usr;
+        base_usr.prop = base->USR;
+        const location_properties specifier_loc {class_info->bases[i]->cursor};
+
+        if (ngmg::cypher::relationship_exists(*this->_connection,
+                                              inherits_label,
+                                              child_usr.tuple(),
+                                              class_node::label(),
+                                              base_usr.tuple(),
+                                              class_node::label(),
+                                              ngmg::cypher::relationship_type::directed,
+                                              std::tie(specifier_loc.file_prop)))
+        {
+            continue;
+        }
+
+        ngmg::cypher::create_relate(*this->_connection,
+                                    inherits_label,
+                                    child_usr.tuple(),
+                                    class_node::label(),
+                                    base_usr.tuple(),
+                                    class_node::label(),
+                                    ngmg::cypher::relationship_type::directed,
+                                    std::tie(specifier_loc.file_prop));
+    }
+}
+
+void
+indexer::graph_reference(const CXIdxEntityRefInfo & info)
+{
+    if (!(info.role & CXSymbolRole_Call) ||
+        !info.parentEntity ||
+        !info.referencedEntity ||
+        !is_function(info.parentEntity->kind) ||
+        !info.parentEntity->USR ||
+        !info.referencedEntity->USR ||
+        in_system_header(info.loc) ||
+        this->skip_location(info.loc))
+    {
+        return;
+    }
+
+    // The reference is to the callee's name, the start of its extent is
+    // where the call expression starts.
+    const location_properties cursor_loc {clang_getRangeStart(clang_getCursorExtent(info.cursor))};
+    universal_symbol_reference_property caller_usr;
+    caller_usr.prop = info.parentEntity->USR;
+    universal_symbol_reference_property callee_usr;
+    callee_usr.prop = info.referencedEntity->USR;
+
+    if (ngmg::cypher::relationship_exists(*this->_connection,
+                                          calls_label,
+                                          ngmg::cypher::relationship_type::directed,
+                                          cursor_loc.tuple()))
+    {
+        return;
+    }
+
+    ngmg::cypher::create_relate(*this->_connection,
+                                calls_label,
+                                caller_usr.tuple(),
+                                callee_usr.tuple(),
+                                ngmg::cypher::relationship_type::directed,
+                                cursor_loc.tuple());
+}
+
+void
+indexer::graph_namespace(const CXIdxDeclInfo & info)
+{
+    const CXCursor cursor = info.cursor;
+    namespace_decl_node namespace_decl;
+    namespace_decl.location.fill(cursor);
+
+    if (ngmg::cypher::node_exists(*this->_connection,
+                                  namespace_decl.label(),
+                                  namespace_decl.location.tuple()))
+    {
+        return;
+    }
+
+    const std::string fq_name = qualified_name(cursor);
+    namespace_decl.names.fill_with_fq_name(cursor, fq_name);
+
+    ngmg::cypher::merge_node(*this->_connection,
+                             namespace_decl.label(),
+                             namespace_decl.location.tuple(),
+                             namespace_decl.tuple());
+
+    namespace_node namespace_node;
+    namespace_node.usr.fill(cursor);
+    if (!ngmg::cypher::node_exists(*this->_connection,
+                                   namespace_node.label(),
+                                   namespace_node.usr.tuple()))
+    {
+        namespace_node.names.fill_with_fq_name(cursor, fq_name);
+        ngmg::cypher::merge_node(*this->_connection,
+                                 namespace_node.label(),
+                                 namespace_node.usr.tuple(),
+                                 namespace_node.tuple());
+    }
+
+    ngmg::cypher::create_relate(*this->_connection,
+                                declares_label,
+                                namespace_decl.location.tuple(),
+                                namespace_decl.label(),
+                                namespace_node.usr.tuple(),
+                                namespace_node.label());
+
+    this->graph_parent(info);
+}
+
+void
+indexer::graph_class(const CXIdxDeclInfo & info)
+{
+    const CXCursor cursor = info.cursor;
+    class_decl_node class_decl;
+    class_decl.location.fill(cursor);
+    if (ngmg::cypher::node_exists(*this->_connection,
+                                  class_decl.label(),
+                                  class_decl.location.tuple()))
+    {
+        return;
+    }
+
+    const std::string fq_name = qualified_name(cursor);
+    class_decl.names.fill_with_fq_name(cursor, fq_name);
+
+    ngmg::cypher::merge_node(*this->_connection,
+                             class_decl.label(),
+                             class_decl.location.tuple(),
+                             class_decl.tuple());
+
+    class_node class_node;
+    class_node.usr.fill(cursor);
+
+    if (!ngmg::cypher::node_exists(*this->_connection,
+                                   class_node.label(),
+                                   class_node.usr.tuple()))
+    {
+        class_node.names.fill_with_fq_name(cursor, fq_name);
+        class_node.is_template.fill(cursor);
+        ngmg::cypher::merge_node(*this->_connection,
+                                 class_node.label(),
+                                 class_node.usr.tuple(),
+                                 class_node.tuple());
+    }
+
+    ngmg::cypher::create_relate(*this->_connection,
+                                declares_label,
+                                class_decl.location.tuple(),
+                                class_decl.label(),
+                                class_node.usr.tuple(),
+                                class_node.label());
+
+    this->graph_parent(info);
+}
+
+bool
+indexer::graph_function(const CXIdxDeclInfo & info)
+{
+    const CXCursor cursor = info.cursor;
+    std::string function_label;
+    std::string function_dec_label;
+    std::string function_def_label;
+    function_labels(cursor, &function_label, &function_dec_label, &function_def_label);
+
+    const std::string fq_namespace = scope_name(cursor);
+    bool created = false;
+
+    function_node func_node {function_label};
+    func_node.usr.fill(cursor);
+
+    if (!ngmg::cypher::node_exists(*this->_connection,
+                                   func_node.label(),
+                                   func_node.usr.tuple()))
+    {
+        func_node.is_template.fill(cursor);
+        func_node.names.fill_with_fq_namespace(cursor, fq_namespace);
+        ngmg::cypher::merge_node(*this->_connection,
+                                 func_node.label(),
+                                 func_node.usr.tuple(),
+                                 func_node.tuple());
+    }
+
+    function_decl_def_node decl_def_node {info.isDefinition ? function_def_label : function_dec_label};
+    decl_def_node.location.fill(cursor);
+
+    if (!ngmg::cypher::node_exists(*this->_connection,
+                                   decl_def_node.label(),
+                                   decl_def_node.location.tuple()))
+    {
+        decl_def_node.names.fill_with_fq_namespace(cursor, fq_namespace);
+        ngmg::cypher::merge_node(*this->_connection,
+                                 decl_def_node.label(),
+                                 decl_def_node.location.tuple(),
+                                 decl_def_node.tuple());
+
+        ngmg::cypher::create_relate(*this->_connection,
+                                    info.isDefinition ? defines_label : declares_label,
+                                    decl_def_node.location.tuple(),
+                                    decl_def_node.label(),
+                                    func_node.usr.tuple(),
+                                    func_node.label());
+        created = true;
+    }
+
+    return created;
+}
+
+void
+indexer::graph_overrides(CXCursor cursor)
+{
+    ngclang::overridden_cursors_t overrides;
+    unsigned num_overrides;
+    clang_getOverriddenCursors(cursor, &overrides.get(), &num_overrides);
+
+    const universal_symbol_reference_property cursor_usr {cursor};
+    const location_properties cursor_loc {cursor};
+    const ngmg::cypher::label member_func_label {"MemberFunction"};
+
+    for(unsigned i = 0; i < num_overrides; ++i)
+    {
+        const universal_symbol_reference_property override_usr {overrides.get()[i]};
+        ngmg::cypher::create_relate(*this->_connection,
+                                    overrides_label,
+                                    cursor_usr.tuple(),
+                                    member_func_label,
+                                    override_usr.tuple(),
+                                    member_func_label,
+                                    ngmg::cypher::relationship_type::directed,
+                                    std::tie(cursor_loc.file_prop));
+    }
+}
+
+void
+indexer::graph_parent(const CXIdxDeclInfo & info)
+{
+    const universal_symbol_reference_property cursor_usr {info.cursor};
+    const auto parent_usr = [&info]() {
+        CXCursor semantic_parent = clang_getCursorSemanticParent(info.cursor);
+        if (clang_Cursor_isNull(semantic_parent) && info.lexicalContainer)
+        {
+            return universal_symbol_reference_property {info.lexicalContainer->cursor};
+        }
+        else
+        {
+            return universal_symbol_reference_property {semantic_parent};
+        }
+    }();
+
+    if (parent_usr.prop.value().empty() || cursor_usr.prop.value().empty())
+    {
+        return;
+    }
+
+    const location_properties cursor_loc {info.cursor};
+    if (ngmg::cypher::relationship_exists(*this->_connection,
+                                          has_label,
+                                          parent_usr.tuple(),
+                                          cursor_usr.tuple(),
+                                          ngmg::cypher::relationship_type::directed,
+                                          std::tie(cursor_loc.file_prop)))
+    {
+        return;
+    }
+
+    ngmg::cypher::create_relate(*this->_connection,
+                                has_label,
+                                parent_usr.tuple(),
+                                cursor_usr.tuple(),
+                                ngmg::cypher::relationship_type::directed,
+                                std::tie(cursor_loc.file_prop));
+}
@@ -0,0 +1,114 @@
+#ifndef INDEXER_HPP
+#define INDEXER_HPP
+
+#include <clang-c/Index.h>
+#include <exception>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ngclang.hpp"
+
+class compile_command;
+
+namespace ngmg
+{
+    class connection;
+}
+
+/** Graphs translation units with libclang's indexer API.
+ *
+ *  Instead of visiting every cursor, declarations and references are
+ *  reported by libclang.  The same nodes and relationships are created
+ *  as with ast_visitor.
+ *
+ *  Function bodies in headers are only indexed once per indexer, so a
+ *  worker should use a single indexer for all of its translation units.
+ */
+class indexer
+{
+    public:
+
+    /// Returns true if the declarations and references in file are
+    /// graphed
+    using file_filter = std::function<bool (CXFile file)>;
+
+    /** Translation units are parsed with parse_options.  If they
+     *  include CXTranslationUnit_SkipFunctionBodies, references aren't
+     *  indexed so no calls are graphed.
+     *
+     *  If filter is set, declarations and references in the files it
+     *  rejects are ignored.  It's called once per file of a
+     *  translation unit.
+     */
+    indexer(CXIndex index,
+            std::reference_wrapper<ngmg::connection> connection,
+            unsigned parse_options,
+            file_filter filter = {});
+
+    indexer(const indexer &) = delete;
+    indexer& operator = (const indexer &) = delete;
+
+    /** Indexes and graphs the translation unit of commands.
+     *
+     *  If includes is not null, it's filled with the main file and all
+     *  the files it includes.  Returns false if the translation unit
+     *  could not be parsed.
+     */
+    bool
+    index(const compile_command & commands, std::vector<std::string> * includes = nullptr);
+
+    private:
+
+    static
+    int
+    abort_query(CXClientData client_data, void *);
+
+    static
+    void
+    index_declaration(CXClientData client_data, const CXIdxDeclInfo * info);
+
+    static
+    void
+    index_entity_reference(CXClientData client_data, const CXIdxEntityRefInfo * info);
+
+    /// True if location is in a file the filter rejects
+    bool
+    skip_location(CXIdxLoc location);
+
+    void
+    graph_declaration(const CXIdxDeclInfo & info);
+
+    void
+    graph_reference(const CXIdxEntityRefInfo & info);
+
+    void
+    graph_namespace(const CXIdxDeclInfo & info);
+
+    void
+    graph_class(const CXIdxDeclInfo & info);
+
+    /// Returns true if the function's declaration or definition node
+    /// was created
+    bool
+    graph_function(const CXIdxDeclInfo & info);
+
+    void
+    graph_overrides(CXCursor cursor);
+
+    void
+    graph_parent(const CXIdxDeclInfo & info);
+
+    ngclang::index_action_t _action;
+    ngmg::connection * const _connection = nullptr;
+    const unsigned _parse_options;
+    const file_filter _filter;
+
+    // whether each file of the translation unit being indexed is skipped
+    std::unordered_map<CXFile, bool> _skip_files;
+
+    // the first error thrown by a callback, it aborts indexing
+    std::exception_ptr _error;
+};
+
+#endif
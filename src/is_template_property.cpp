@@ -9,7 +9,12 @@ is_template_property::is_template_property():
 void
 is_template_property::fill(CXCursor cursor)
 {
-    const CXCursorKind kind = clang_getCursorKind(cursor);
+    this->fill(clang_getCursorKind(cursor));
+}
+
+void
+is_template_property::fill(CXCursorKind kind)
+{
     this->prop =
         (kind == CXCursor_ClassTemplate ||
          kind == CXCursor_FunctionTemplate ||
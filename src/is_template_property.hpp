@@ -22,6 +22,9 @@ class is_template_property
 
     void
     fill(CXCursor cursor);
+
+    void
+    fill(CXCursorKind kind);
 };
 
 #endif
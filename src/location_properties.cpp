@@ -14,11 +14,27 @@ location_properties::location_properties(CXCursor cursor):
     this->fill(cursor);
 }
 
+location_properties::location_properties(CXSourceLocation location):
+    location_properties ()
+{
+    this->fill(location);
+}
+
 void
 location_properties::fill(CXCursor cursor)
 {
-    const ngclang::cursor_location location {cursor};
+    this->fill(clang_getCursorLocation(cursor));
+}
 
+void
+location_properties::fill(CXSourceLocation source_location)
+{
+    this->fill(ngclang::cursor_location {source_location});
+}
+
+void
+location_properties::fill(const ngclang::cursor_location & location)
+{
     this->line_prop = location.line();
     this->column_prop = location.column();
     this->file_prop = location.file();
@@ -3,6 +3,7 @@
 
 #include <clang-c/Index.h>
 #include "memgraph/cypher/property.hpp"
+#include "ngclang.hpp"
 #include <string>
 #include <tuple>
 
@@ -14,6 +15,9 @@ class location_properties
 
     location_properties(CXCursor cursor);
 
+    explicit
+    location_properties(CXSourceLocation location);
+
     ngmg::cypher::property<int> line_prop;
     ngmg::cypher::property<int> column_prop;
     ngmg::cypher::property<std::string> file_prop;
@@ -28,6 +32,12 @@ class location_properties
 
     void
     fill(CXCursor cursor);
+
+    void
+    fill(CXSourceLocation location);
+
+    void
+    fill(const ngclang::cursor_location & location);
 };
 
 #endif
@@ -1,6 +1,7 @@
 #include "cypher.hpp"
 #include <mgclient.hpp>
 #include <optional>
+#include <string>
 #include <type_traits>
 
 std::optional<mg::Value>
@@ -22,21 +23,35 @@ ngmg::cypher::detail::fetch_node(ngmg::statement_executor & executor)
     return std::optional<mg::Value> {std::move(value)};
 }
 
-std::optional<mg::Value>
-ngmg::cypher::detail::fetch_relationship(ngmg::statement_executor & executor)
+void
+ngmg::cypher::detail::execute_write(mg::Client & client, const std::string & statement, bool existing_ok)
 {
-    const std::optional<std::vector<mg::Value>> maybe_result = executor.client().FetchOne();
-    if (!maybe_result || maybe_result->size() < 1)
-    {
-        return std::optional<mg::Value> {};
-    }
-
-    const std::vector<mg::Value> & result = *maybe_result;
-    const mg::Value & value = result[0];
-    if (value.type() != mg::Value::Type::Relationship)
+    constexpr int max_attempts = 10;
+    for (int attempt = 1;; ++attempt)
     {
-        throw std::logic_error("invalid type match");
+        try
+        {
+            ngmg::statement_executor executor(std::ref(client));
+            executor.execute(statement);
+            executor.discard();
+            return;
+        }
+        catch (const mg::TransientException &)
+        {
+            if (attempt == max_attempts)
+            {
+                throw;
+            }
+        }
+        catch (const mg::ClientException &)
+        {
+            // A merge whose node another client committed first fails
+            // its unique constraint, and matches that node when it's
+            // executed again.
+            if (!existing_ok || attempt == max_attempts)
+            {
+                throw;
+            }
+        }
     }
-
-    return std::optional<mg::Value> {std::move(value)};
 }
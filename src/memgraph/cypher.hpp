@@ -12,6 +12,7 @@
 #include "cypher/return_clause.hpp"
 #include "cypher/set_clause.hpp"
 #include "cypher/variable.hpp"
+#include "../graph_connection.hpp"
 #include <mgclient.hpp>
 #include <sstream>
 #include "../statement_executor.hpp"
@@ -92,13 +93,20 @@ namespace ngmg::cypher
         std::optional<mg::Value>
         fetch_node(ngmg::statement_executor & executor);
 
-        std::optional<mg::Value>
-        fetch_relationship(ngmg::statement_executor & executor);
+        /** Executes a statement that writes to the graph.
+         *
+         *  A statement that conflicts with a concurrent client's write
+         *  is retried.  If existing_ok is true the statement merges a
+         *  node, and it's also retried when it fails because another
+         *  client created the node first.
+         */
+        void
+        execute_write(mg::Client & client, const std::string & statement, bool existing_ok = false);
 
+        /// The statement that returns the nodes matching match_props
         template <ngmg::cypher::PropertyTuple MatchProps>
-        std::optional<mg::Value>
-        fetch_node(ngmg::statement_executor & executor,
-                   MatchProps match_props)
+        std::string
+        match_node_statement(const MatchProps & match_props)
         {
             const ngmg::cypher::node_variable match_node_var {"n"};
             const ngmg::cypher::node_expression match_node_expr
@@ -114,16 +122,15 @@ namespace ngmg::cypher
 
             std::stringstream ss;
             ngmg::cypher::detail::write_clauses(ss, match_clause, return_clause);
-            executor.execute(ss.str());
-
-            return ngmg::cypher::detail::fetch_node(executor);
+            return ss.str();
         }
 
+        /// The statement that returns the nodes with label matching
+        /// match_props
         template <ngmg::cypher::PropertyTuple MatchProps>
-        std::optional<mg::Value>
-        fetch_node(ngmg::statement_executor & executor,
-                   const ngmg::cypher::label & label,
-                   const MatchProps match_props)
+        std::string
+        match_node_statement(const ngmg::cypher::label & label,
+                             const MatchProps & match_props)
         {
             const ngmg::cypher::node_variable match_node_var {"n"};
             const ngmg::cypher::node_expression match_node_expr
@@ -140,8 +147,15 @@ namespace ngmg::cypher
 
             std::stringstream ss;
             ngmg::cypher::detail::write_clauses(ss, match_clause, return_clause);
-            executor.execute(ss.str());
+            return ss.str();
+        }
 
+        template <ngmg::cypher::PropertyTuple MatchProps>
+        std::optional<mg::Value>
+        fetch_node(ngmg::statement_executor & executor,
+                   MatchProps match_props)
+        {
+            executor.execute(ngmg::cypher::detail::match_node_statement(match_props));
             return ngmg::cypher::detail::fetch_node(executor);
         }
     }
@@ -155,20 +169,19 @@ namespace ngmg::cypher
 
     template <class ... Args>
     void
-    execute(mg::Client & client, Args && ... args)
+    execute(ngmg::connection & connection, Args && ... args)
     {
         std::stringstream ss;
         ngmg::cypher::write_clauses(ss, std::forward<Args>(args)...);
 
-        ngmg::statement_executor executor(std::ref(client));
-        executor.execute(ss.str());
+        connection.write(ss.str(), false);
     }
 
     template <ngmg::cypher::PropertyTuple Src,
               ngmg::cypher::PropertyTuple Dst,
               ngmg::cypher::PropertyTuple Props = std::tuple<>>
     void
-    create_relate(mg::Client & client,
+    create_relate(ngmg::connection & connection,
                   const ngmg::cypher::label & rel_label,
                   const Src & src,
                   const ngmg::cypher::label & src_label,
@@ -213,14 +226,14 @@ namespace ngmg::cypher
                 std::tie(relationship_expr)
             };
 
-        ngmg::cypher::execute(client, match_clause, create_clause);
+        ngmg::cypher::execute(connection, match_clause, create_clause);
     }
 
     template <ngmg::cypher::PropertyTuple Src,
               ngmg::cypher::PropertyTuple Dst,
               ngmg::cypher::PropertyTuple Props = std::tuple<>>
     void
-    create_relate(mg::Client & client,
+    create_relate(ngmg::connection & connection,
                   const ngmg::cypher::label & rel_label,
                   const Src & src,
                   const Dst & dst,
@@ -261,14 +274,14 @@ namespace ngmg::cypher
                 std::tie(relationship_expr)
             };
 
-        ngmg::cypher::execute(client, match_clause, create_clause);
+        ngmg::cypher::execute(connection, match_clause, create_clause);
     }
 
     template <ngmg::cypher::PropertyTuple Src,
               ngmg::cypher::PropertyTuple Dst,
               ngmg::cypher::PropertyTuple Props = std::tuple<>>
     void
-    merge_relate(mg::Client & client,
+    merge_relate(ngmg::connection & connection,
                  const ngmg::cypher::label & label,
                  const Src & src,
                  const Dst & dst,
@@ -309,13 +322,13 @@ namespace ngmg::cypher
                 std::tie(relationship_expr)
             };
 
-        ngmg::cypher::execute(client, match_clause, merge_clause);
+        ngmg::cypher::execute(connection, match_clause, merge_clause);
     }
 
     template <ngmg::cypher::PropertyTuple MatchProps,
               ngmg::cypher::PropertyTuple SetProps>
     void
-    match_set(mg::Client & client,
+    match_set(ngmg::connection & connection,
               const MatchProps & match_props,
               const SetProps & set_props)
     {
@@ -333,17 +346,23 @@ namespace ngmg::cypher
                 set_props
             };
 
-        ngmg::cypher::execute(client, match_clause, set_clause);
+        ngmg::cypher::execute(connection, match_clause, set_clause);
     }
 
     template <ngmg::cypher::PropertyTuple MatchProps,
               ngmg::cypher::PropertyTuple ReturnProps>
     bool
-    node_return(mg::Client & client,
+    node_return(ngmg::connection & connection,
                 const MatchProps & match_props,
                 ReturnProps return_props)
     {
-        ngmg::statement_executor executor(std::ref(client));
+        mg::Client * const client = connection.client();
+        if (!client)
+        {
+            throw std::logic_error("node properties can only be returned by a memgraph client");
+        }
+
+        ngmg::statement_executor executor(std::ref(*client));
         const std::optional<mg::Value> value = ngmg::cypher::detail::fetch_node(executor, match_props);
 
         if (!value)
@@ -355,7 +374,7 @@ namespace ngmg::cypher
         const mg::ConstMap properties = node.properties();
         std::apply([&properties] (auto & ... p) {cypher::detail::fill_properties(properties, p...);}, return_props);
 
-        const auto empty_result = client.FetchOne();
+        const auto empty_result = client->FetchOne();
         if (empty_result)
         {
             throw std::logic_error("more than one node matched query");
@@ -366,32 +385,26 @@ namespace ngmg::cypher
 
     template <ngmg::cypher::PropertyTuple MatchProps>
     bool
-    node_exists(mg::Client & client,
+    node_exists(ngmg::connection & connection,
                 const MatchProps & match_props)
     {
-        ngmg::statement_executor executor(std::ref(client));
-        const std::optional<mg::Value> value = ngmg::cypher::detail::fetch_node(executor, match_props);
-
-        return value.has_value();
+        return connection.exists(ngmg::cypher::detail::match_node_statement(match_props));
     }
 
     template <ngmg::cypher::PropertyTuple MatchProps>
     bool
-    node_exists(mg::Client & client,
+    node_exists(ngmg::connection & connection,
                 const ngmg::cypher::label & label,
                 const MatchProps & match_props)
     {
-        ngmg::statement_executor executor(std::ref(client));
-        const std::optional<mg::Value> value = ngmg::cypher::detail::fetch_node(executor, label, match_props);
-
-        return value.has_value();
+        return connection.exists(ngmg::cypher::detail::match_node_statement(label, match_props));
     }
 
     template <ngmg::cypher::PropertyTuple SrcProps,
               ngmg::cypher::PropertyTuple DstProps,
               ngmg::cypher::PropertyTuple EdgeProps = std::tuple<>>
     bool
-    relationship_exists(mg::Client & client,
+    relationship_exists(ngmg::connection & connection,
                         const ngmg::cypher::label & edge_label,
                         const SrcProps & src_props,
                         const DstProps & dst_props,
@@ -430,21 +443,15 @@ namespace ngmg::cypher
 
         const ngmg::cypher::return_clause return_clause {std::cref(rel_var)};
 
-        ngmg::statement_executor executor(std::ref(client));
         std::stringstream ss;
-
         ngmg::cypher::detail::write_clauses(ss, match_clause, return_clause);
 
-        executor.execute(ss.str());
-        const std::optional<mg::Value> relationship =
-            ngmg::cypher::detail::fetch_relationship(executor);
-
-        return relationship.has_value();
+        return connection.exists(ss.str());
     }
 
     template <ngmg::cypher::PropertyTuple EdgeProps = std::tuple<>>
     bool
-    relationship_exists(mg::Client & client,
+    relationship_exists(ngmg::connection & connection,
                         const ngmg::cypher::label & edge_label,
                         const ngmg::cypher::relationship_type type = ngmg::cypher::relationship_type::directed,
                         const EdgeProps & edge_props = std::tuple<> {})
@@ -470,23 +477,17 @@ namespace ngmg::cypher
 
         const ngmg::cypher::return_clause return_clause {std::cref(rel_var)};
 
-        ngmg::statement_executor executor(std::ref(client));
         std::stringstream ss;
-
         ngmg::cypher::detail::write_clauses(ss, match_clause, return_clause);
 
-        executor.execute(ss.str());
-        const std::optional<mg::Value> relationship =
-            ngmg::cypher::detail::fetch_relationship(executor);
-
-        return relationship.has_value();
+        return connection.exists(ss.str());
     }
 
     template <ngmg::cypher::PropertyTuple SrcProps,
         ngmg::cypher::PropertyTuple DstProps,
         ngmg::cypher::PropertyTuple EdgeProps = std::tuple<>>
     bool
-    relationship_exists(mg::Client & client,
+    relationship_exists(ngmg::connection & connection,
                         const ngmg::cypher::label & edge_label,
                         const SrcProps & src_props,
                         const ngmg::cypher::label & src_label,
@@ -529,50 +530,67 @@ namespace ngmg::cypher
 
         const ngmg::cypher::return_clause return_clause {std::cref(rel_var)};
 
-        ngmg::statement_executor executor(std::ref(client));
         std::stringstream ss;
-
         ngmg::cypher::detail::write_clauses(ss, match_clause, return_clause);
 
-        executor.execute(ss.str());
-        const std::optional<mg::Value> relationship =
-            ngmg::cypher::detail::fetch_relationship(executor);
-
-        return relationship.has_value();
+        return connection.exists(ss.str());
     }
 
-    template <ngmg::cypher::PropertyTuple Props>
+    /** Creates a node with label_set, props and property_set unless a
+     *  node with label_set and match_props exists.
+     *
+     *  The node is merged, so a node that another client created in
+     *  between is matched rather than created again.
+     */
+    template <ngmg::cypher::PropertyTuple MatchProps,
+              ngmg::cypher::PropertyTuple Props>
     void
-    create_node(mg::Client & client,
-                const std::set<ngmg::cypher::label> & label_set,
-                const Props & props,
-                const ngmg::cypher::property_set & property_set)
+    merge_node(ngmg::connection & connection,
+               const std::set<ngmg::cypher::label> & label_set,
+               const MatchProps & match_props,
+               const Props & props,
+               const ngmg::cypher::property_set & property_set)
     {
-        const ngmg::cypher::node_expression create_node_expr
+        const ngmg::cypher::node_variable node_var {"n"};
+        const ngmg::cypher::node_expression merge_node_expr
             {
+                std::cref(node_var),
                 std::cref(label_set),
-                props,
-                std::cref(property_set)
+                match_props
             };
-        const ngmg::cypher::create_clause node_create {std::tie(create_node_expr)};
 
-        ngmg::cypher::execute(client, node_create);
+        std::stringstream ss;
+        ss << "merge ";
+        merge_node_expr.write(ss);
+        ss << " on create set " << node_var.name() << " += ";
+        ngmg::cypher::write_property_collections(ss, props, property_set);
+        connection.write(ss.str(), true);
     }
 
-    template <ngmg::cypher::PropertyTuple Props>
+    /// Creates a node with label and props unless a node with label
+    /// and match_props exists, see above
+    template <ngmg::cypher::PropertyTuple MatchProps,
+              ngmg::cypher::PropertyTuple Props>
     void
-    create_node(mg::Client & client,
-                const ngmg::cypher::label & label,
-                const Props & props)
+    merge_node(ngmg::connection & connection,
+               const ngmg::cypher::label & label,
+               const MatchProps & match_props,
+               const Props & props)
     {
-        const ngmg::cypher::node_expression create_node_expr
+        const ngmg::cypher::node_variable node_var {"n"};
+        const ngmg::cypher::node_expression merge_node_expr
             {
+                std::cref(node_var),
                 std::cref(label),
-                props
+                match_props
             };
-        const ngmg::cypher::create_clause node_create {std::tie(create_node_expr)};
 
-        ngmg::cypher::execute(client, node_create);
+        std::stringstream ss;
+        ss << "merge ";
+        merge_node_expr.write(ss);
+        ss << " on create set " << node_var.name() << " += ";
+        ngmg::cypher::write_properties(ss, props);
+        connection.write(ss.str(), true);
     }
 }
 
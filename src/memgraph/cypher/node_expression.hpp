@@ -59,6 +59,10 @@ namespace ngmg::cypher
                         std::reference_wrapper<const ngmg::cypher::label> label,
                         const Props & props);
 
+        node_expression(std::reference_wrapper<const ngmg::cypher::node_variable> var,
+                        std::reference_wrapper<const std::set<ngmg::cypher::label>> label_set,
+                        const Props & props);
+
         void
         write(std::ostream & stream) const;
 
@@ -134,6 +138,14 @@ namespace ngmg::cypher
         _props {props}
     {}
 
+    template <ngmg::cypher::PropertyTuple Props>
+    node_expression<Props>::node_expression(std::reference_wrapper<const ngmg::cypher::node_variable> var,
+                                            std::reference_wrapper<const std::set<ngmg::cypher::label>> label_set,
+                                            const Props & props):
+        node_expression_base(&var.get(), nullptr, nullptr, &label_set.get()),
+        _props {props}
+    {}
+
     template <ngmg::cypher::PropertyTuple Props>
     void
     node_expression<Props>::write(std::ostream & stream) const
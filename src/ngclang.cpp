@@ -2,6 +2,8 @@
 #include <clang-c/Index.h>
 #include "ngclang.hpp"
 #include <string>
+#include <string_view>
+#include <vector>
 
 ngclang::universal_symbol_reference::universal_symbol_reference(CXCursor cursor):
     _string(ngclang::to_string(cursor, &clang_getCursorUSR))
@@ -13,10 +15,12 @@ ngclang::universal_symbol_reference::string() const noexcept
     return this->_string;
 }
 
-ngclang::cursor_location::cursor_location(CXCursor cursor)
-{
-    const CXSourceLocation location = clang_getCursorLocation(cursor);
+ngclang::cursor_location::cursor_location(CXCursor cursor):
+    cursor_location(clang_getCursorLocation(cursor))
+{}
 
+ngclang::cursor_location::cursor_location(CXSourceLocation location)
+{
     CXFile file;
     clang_getExpansionLocation(location,
                                &file,
@@ -28,6 +32,14 @@ ngclang::cursor_location::cursor_location(CXCursor cursor)
     this->_file = ngclang::to_string(path.get());
 }
 
+ngclang::cursor_location::cursor_location(CXFile file, unsigned int line, unsigned int column):
+    _line(line),
+    _column(column)
+{
+    ngclang::string_t path = clang_File_tryGetRealPathName(file);
+    this->_file = ngclang::to_string(path.get());
+}
+
 const std::string &
 ngclang::cursor_location::file() const noexcept
 {
@@ -46,6 +58,91 @@ ngclang::cursor_location::column() const noexcept
     return this->_column;
 }
 
+ngclang::cursor_facts::cursor_facts(CXCursor cursor) noexcept:
+    _cursor(cursor)
+{}
+
+CXCursor
+ngclang::cursor_facts::cursor() const noexcept
+{
+    return this->_cursor;
+}
+
+CXCursorKind
+ngclang::cursor_facts::kind()
+{
+    if (!this->_kind)
+    {
+        this->_kind = clang_getCursorKind(this->_cursor);
+    }
+
+    return *this->_kind;
+}
+
+CXSourceLocation
+ngclang::cursor_facts::source_location()
+{
+    if (!this->_source_location)
+    {
+        this->_source_location = clang_getCursorLocation(this->_cursor);
+    }
+
+    return *this->_source_location;
+}
+
+CXFile
+ngclang::cursor_facts::file()
+{
+    this->expand();
+    return this->_file;
+}
+
+const ngclang::cursor_location &
+ngclang::cursor_facts::location()
+{
+    if (!this->_location)
+    {
+        this->expand();
+        this->_location.emplace(this->_file, this->_line, this->_column);
+    }
+
+    return *this->_location;
+}
+
+const std::string &
+ngclang::cursor_facts::universal_symbol_reference()
+{
+    if (!this->_universal_symbol_reference)
+    {
+        this->_universal_symbol_reference = ngclang::to_string(this->_cursor, &clang_getCursorUSR);
+    }
+
+    return *this->_universal_symbol_reference;
+}
+
+CXCursor
+ngclang::cursor_facts::semantic_parent()
+{
+    if (!this->_semantic_parent)
+    {
+        this->_semantic_parent = clang_getCursorSemanticParent(this->_cursor);
+    }
+
+    return *this->_semantic_parent;
+}
+
+void
+ngclang::cursor_facts::expand()
+{
+    if (this->_expanded)
+    {
+        return;
+    }
+
+    clang_getExpansionLocation(this->source_location(), &this->_file, &this->_line, &this->_column, nullptr);
+    this->_expanded = true;
+}
+
 std::string
 ngclang::to_string(CXString cxstring)
 {
@@ -70,6 +167,178 @@ ngclang::to_string(CXCursor c, CXString (*f)(CXCursor))
     return to_string(string.get());
 }
 
+std::string
+ngclang::file_path(CXFile file)
+{
+    ngclang::string_t path = clang_File_tryGetRealPathName(file);
+    std::string file_path = ngclang::to_string(path.get());
+    if (file_path.empty())
+    {
+        ngclang::string_t name = clang_getFileName(file);
+        file_path = ngclang::to_string(name.get());
+    }
+
+    return file_path;
+}
+
+namespace
+{
+    void
+    collect_inclusion(CXFile included_file,
+                      CXSourceLocation *,
+                      unsigned,
+                      CXClientData client_data)
+    {
+        auto & files = *(reinterpret_cast<std::vector<std::string> *>(client_data));
+        files.push_back(ngclang::file_path(included_file));
+    }
+
+    CXCursor
+    first_child(CXCursor cursor)
+    {
+        CXCursor child = clang_getNullCursor();
+        clang_visitChildren(cursor,
+                            [] (CXCursor c, CXCursor, CXClientData client_data) {
+                                *(reinterpret_cast<CXCursor *>(client_data)) = c;
+                                return CXChildVisit_Break;
+                            },
+                            &child);
+        return child;
+    }
+
+    /// Returns the spelling of the last identifier in cursor's extent
+    std::string
+    last_identifier(CXCursor cursor)
+    {
+        CXTranslationUnit unit = clang_Cursor_getTranslationUnit(cursor);
+        CXToken * tokens = nullptr;
+        unsigned sizeof_tokens = 0;
+        clang_tokenize(unit, clang_getCursorExtent(cursor), &tokens, &sizeof_tokens);
+
+        std::string identifier;
+        for (unsigned i = sizeof_tokens; i > 0; --i)
+        {
+            if (clang_getTokenKind(tokens[i - 1]) == CXToken_Identifier)
+            {
+                identifier = ngclang::to_string(clang_getTokenSpelling(unit, tokens[i - 1]));
+                break;
+            }
+        }
+
+        clang_disposeTokens(unit, tokens, sizeof_tokens);
+        return identifier;
+    }
+}
+
+std::vector<std::string>
+ngclang::included_files(CXTranslationUnit unit)
+{
+    std::vector<std::string> files;
+    clang_getInclusions(unit, &collect_inclusion, &files);
+    return files;
+}
+
+bool
+ngclang::has_errors(CXTranslationUnit unit)
+{
+    const unsigned sizeof_diagnostics = clang_getNumDiagnostics(unit);
+    for (unsigned i = 0; i < sizeof_diagnostics; ++i)
+    {
+        CXDiagnostic diagnostic = clang_getDiagnostic(unit, i);
+        const CXDiagnosticSeverity severity = clang_getDiagnosticSeverity(diagnostic);
+        clang_disposeDiagnostic(diagnostic);
+
+        if (severity >= CXDiagnostic_Error)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool
+ngclang::has_skipped_body(CXCursor cursor)
+{
+    if (clang_isCursorDefinition(cursor))
+    {
+        return false;
+    }
+
+    CXFile file = nullptr;
+    unsigned offset = 0;
+    clang_getSpellingLocation(clang_getRangeEnd(clang_getCursorExtent(cursor)), &file, nullptr, nullptr, &offset);
+    if (!file)
+    {
+        return false;
+    }
+
+    std::size_t size = 0;
+    const char * contents = clang_getFileContents(clang_Cursor_getTranslationUnit(cursor), file, &size);
+    if (!contents || offset >= size)
+    {
+        return false;
+    }
+
+    std::string_view rest {contents + offset, size - offset};
+    const std::size_t next = rest.find_first_not_of(" \t\r\n\f\v");
+    if (next == std::string_view::npos)
+    {
+        return false;
+    }
+
+    // a body, a constructor's initializer list or a function try block
+    rest.remove_prefix(next);
+    return rest.starts_with('{') || rest.starts_with(':') || rest.starts_with("try");
+}
+
+bool
+ngclang::is_recovered_call(CXCursor cursor)
+{
+    if (clang_getCursorKind(cursor) != CXCursor_UnexposedExpr)
+    {
+        return false;
+    }
+
+    // The callee of the recovered call is a reference to the set of
+    // declarations the name lookup found, which is empty.
+    const CXCursor callee = first_child(cursor);
+    return clang_getCursorKind(callee) == CXCursor_DeclRefExpr &&
+        clang_getCursorKind(clang_getCursorReferenced(callee)) == CXCursor_OverloadedDeclRef;
+}
+
+std::string
+ngclang::unresolved_callee_name(CXCursor cursor)
+{
+    CXCursor callee = first_child(cursor);
+    while (clang_getCursorKind(callee) == CXCursor_UnexposedExpr)
+    {
+        callee = first_child(callee);
+    }
+
+    const CXCursorKind kind = clang_getCursorKind(callee);
+    if (kind != CXCursor_DeclRefExpr && kind != CXCursor_MemberRefExpr && kind != CXCursor_OverloadedDeclRef)
+    {
+        return {};
+    }
+
+    std::string name = ngclang::to_string(callee, &clang_getCursorSpelling);
+    if (name.empty())
+    {
+        const CXCursor referenced = clang_getCursorReferenced(callee);
+        if (!clang_Cursor_isNull(referenced))
+        {
+            name = ngclang::to_string(referenced, &clang_getCursorSpelling);
+        }
+    }
+
+    if (name.empty() && kind == CXCursor_MemberRefExpr)
+    {
+        name = last_identifier(callee);
+    }
+
+    return name;
+}
 
 void
 ngclang::dispose_string::operator() (CXString cxstring) const noexcept
@@ -95,6 +364,11 @@ ngclang::dispose_index::operator() (CXIndex index) const noexcept
     clang_disposeIndex(index);
 }
 
+void
+ngclang::dispose_index_action::operator() (CXIndexAction action) const noexcept
+{
+    clang_IndexAction_dispose(action);
+}
 
 void
 ngclang::dispose_translation_unit::operator() (CXTranslationUnit tu) const noexcept
@@ -3,7 +3,9 @@
 
 #include <clang-c/CXCompilationDatabase.h>
 #include <clang-c/Index.h>
+#include <optional>
 #include <string>
+#include <vector>
 
 namespace ngclang
 {
@@ -13,6 +15,44 @@ namespace ngclang
     std::string
     to_string(CXCursor c, CXString (*f)(CXCursor));
 
+    /// Returns the real path of file, or its name if it has no real path
+    std::string
+    file_path(CXFile file);
+
+    /// Returns the paths of the main file of unit and all the files it includes
+    std::vector<std::string>
+    included_files(CXTranslationUnit unit);
+
+    /// True if parsing unit reported an error
+    bool
+    has_errors(CXTranslationUnit unit);
+
+    /** Returns true if cursor is a function definition whose body was
+     *  skipped by CXTranslationUnit_SkipFunctionBodies.
+     *
+     *  libclang doesn't report these as definitions, so the source
+     *  following the declarator is checked for the start of a body.
+     */
+    bool
+    has_skipped_body(CXCursor cursor);
+
+    /// True if cursor is the expression libclang recovers a call to an
+    /// undeclared function as
+    bool
+    is_recovered_call(CXCursor cursor);
+
+    /** Returns the name of the function called by cursor, a call that
+     *  libclang couldn't resolve, or an empty string if the callee
+     *  isn't named.
+     *
+     *  cursor is a call expression, or an expression for which
+     *  is_recovered_call is true.  The callee of a member call on an
+     *  object of an unknown type is only known by the last identifier
+     *  of the member expression.
+     */
+    std::string
+    unresolved_callee_name(CXCursor cursor);
+
     template<class T, class D>
     class object
     {
@@ -88,6 +128,13 @@ namespace ngclang
         explicit
         cursor_location(CXCursor c);
 
+        explicit
+        cursor_location(CXSourceLocation location);
+
+        /// The location line and column of file, an expansion location
+        /// that was already looked up
+        cursor_location(CXFile file, unsigned int line, unsigned int column);
+
         cursor_location() = default;
 
         const std::string &
@@ -106,6 +153,68 @@ namespace ngclang
         unsigned int _column = {};
     };
 
+    /** The properties of a cursor that graphing it reads more than
+     *  once.
+     *
+     *  Each property is asked of libclang the first time it's needed
+     *  and kept for the rest of the cursor's visit, so libclang is asked
+     *  for it once however many nodes and relationships are graphed for
+     *  the cursor.
+     */
+    class cursor_facts
+    {
+        public:
+
+        explicit
+        cursor_facts(CXCursor cursor) noexcept;
+
+        cursor_facts(const cursor_facts &) = delete;
+        cursor_facts& operator = (const cursor_facts &) = delete;
+
+        CXCursor
+        cursor() const noexcept;
+
+        CXCursorKind
+        kind();
+
+        CXSourceLocation
+        source_location();
+
+        /// The file the cursor's location expands to, null if there is
+        /// none
+        CXFile
+        file();
+
+        const cursor_location &
+        location();
+
+        const std::string &
+        universal_symbol_reference();
+
+        /// A null cursor if the cursor has no semantic parent
+        CXCursor
+        semantic_parent();
+
+        private:
+
+        void
+        expand();
+
+        CXCursor _cursor;
+        std::optional<CXCursorKind> _kind;
+        std::optional<CXSourceLocation> _source_location;
+
+        // the expansion location, looked up once for file and location
+        bool _expanded = false;
+        CXFile _file = nullptr;
+        unsigned int _line = 0;
+        unsigned int _column = 0;
+
+        std::optional<cursor_location> _location;
+        std::optional<std::string> _universal_symbol_reference;
+        std::optional<CXCursor> _semantic_parent;
+    };
+
     struct dispose_string
     {
         void
@@ -130,6 +239,12 @@ namespace ngclang
         operator () (CXIndex) const noexcept;
     };
 
+    struct dispose_index_action
+    {
+        void
+        operator () (CXIndexAction) const noexcept;
+    };
+
     struct dispose_translation_unit
     {
         void
@@ -143,6 +258,7 @@ namespace ngclang
     };
 
     using translation_unit_t = ngclang::object<CXTranslationUnit, ngclang::dispose_translation_unit>;
+    using index_action_t = ngclang::object<CXIndexAction, ngclang::dispose_index_action>;
     using string_t = ngclang::object<CXString, ngclang::dispose_string>;
     using overridden_cursors_t = ngclang::object<CXCursor*, ngclang::dispose_overridden_cursors>;
 }
@@ -0,0 +1,1087 @@
+#include <algorithm>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include "path_matcher.hpp"
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Patterns are parsed into syntax trees, the trees are compiled into
+// one nondeterministic automaton with a final state per pattern, and
+// the subset construction turns that into the deterministic automaton
+// that paths are matched with.
+
+namespace
+{
+    using byte_set = std::bitset<256>;
+
+    constexpr unsigned unbounded = std::numeric_limits<unsigned>::max();
+
+    // larger counted repetitions are rejected
+    constexpr unsigned max_repetition = 255;
+
+    // patterns compiling into more states are rejected
+    constexpr std::size_t max_states = 1 << 16;
+
+    constexpr std::uint8_t include_flag = 1;
+    constexpr std::uint8_t exclude_flag = 2;
+
+    struct node
+    {
+        enum class type
+        {
+            bytes,
+            concat,
+            alternate,
+            repeat
+        };
+
+        type t = type::concat;
+        byte_set bytes;
+        std::vector<node> children;
+        unsigned min = 0;
+        unsigned max = 0;
+    };
+
+    node
+    bytes_node(const byte_set & bytes)
+    {
+        node n;
+        n.t = node::type::bytes;
+        n.bytes = bytes;
+        return n;
+    }
+
+    node
+    byte_node(unsigned char byte)
+    {
+        byte_set bytes;
+        bytes.set(byte);
+        return bytes_node(bytes);
+    }
+
+    node
+    repeat_node(node child, unsigned min, unsigned max)
+    {
+        node n;
+        n.t = node::type::repeat;
+        n.min = min;
+        n.max = max;
+        n.children.push_back(std::move(child));
+        return n;
+    }
+
+    node
+    concat_node(std::vector<node> children)
+    {
+        node n;
+        n.t = node::type::concat;
+        n.children = std::move(children);
+        return n;
+    }
+
+    byte_set
+    any_byte()
+    {
+        return byte_set().set();
+    }
+
+    byte_set
+    any_but_slash()
+    {
+        return any_byte().reset('/');
+    }
+
+    /// Sets the bytes of the character class name, as in [:alpha:]
+    bool
+    set_named_class(std::string_view name, byte_set & bytes)
+    {
+        for (unsigned c = 0; c < 128; ++c)
+        {
+            const bool alpha = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+            const bool digit = c >= '0' && c <= '9';
+            const bool space = c == ' ' || (c >= '\t' && c <= '\r');
+            bool member = false;
+            if (name == "alpha")
+            {
+                member = alpha;
+            }
+            else if (name == "digit")
+            {
+                member = digit;
+            }
+            else if (name == "alnum")
+            {
+                member = alpha || digit;
+            }
+            else if (name == "upper")
+            {
+                member = c >= 'A' && c <= 'Z';
+            }
+            else if (name == "lower")
+            {
+                member = c >= 'a' && c <= 'z';
+            }
+            else if (name == "space")
+            {
+                member = space;
+            }
+            else if (name == "xdigit")
+            {
+                member = digit || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+            }
+            else if (name == "punct")
+            {
+                member = c > ' ' && c < 127 && !alpha && !digit;
+            }
+            else
+            {
+                return false;
+            }
+
+            if (member)
+            {
+                bytes.set(c);
+            }
+        }
+
+        return true;
+    }
+
+    /// The bytes of the escape sequences \d, \w and \s and their
+    /// complements, or none for any other escaped character
+    bool
+    set_escape_class(char c, byte_set & bytes)
+    {
+        byte_set members;
+        switch (c)
+        {
+            case 'd':
+            case 'D':
+            {
+                set_named_class("digit", members);
+                break;
+            }
+            case 'w':
+            case 'W':
+            {
+                set_named_class("alnum", members);
+                members.set('_');
+                break;
+            }
+            case 's':
+            case 'S':
+            {
+                set_named_class("space", members);
+                break;
+            }
+            default:
+            {
+                return false;
+            }
+        }
+
+        bytes |= (c >= 'a') ? members : ~members;
+        return true;
+    }
+
+    unsigned char
+    escaped_byte(char c)
+    {
+        switch (c)
+        {
+            case 'n':
+            {
+                return '\n';
+            }
+            case 't':
+            {
+                return '\t';
+            }
+            default:
+            {
+                return static_cast<unsigned char>(c);
+            }
+        }
+    }
+
+    class pattern_parser
+    {
+        public:
+
+        explicit
+        pattern_parser(std::string_view pattern):
+            _source(pattern),
+            _pattern(pattern)
+        {}
+
+        /// Parses a regular expression, matched anywhere in a path
+        /// unless anchored
+        node
+        regex()
+        {
+            bool anchored_start = false;
+            if (this->_pattern.starts_with('^'))
+            {
+                anchored_start = true;
+                this->_pattern.remove_prefix(1);
+            }
+
+            bool anchored_end = false;
+            if (this->_pattern.ends_with('$'))
+            {
+                // a '$' preceded by an odd number of backslashes is
+                // escaped
+                std::size_t backslashes = 0;
+                for (std::size_t i = this->_pattern.size() - 1; i > 0 && this->_pattern[i - 1] == '\\'; --i)
+                {
+                    ++backslashes;
+                }
+
+                if (backslashes % 2 == 0)
+                {
+                    anchored_end = true;
+                    this->_pattern.remove_suffix(1);
+                }
+            }
+
+            node expression = this->alternation();
+            if (this->_position != this->_pattern.size())
+            {
+                this->fail("unmatched ')'");
+            }
+
+            std::vector<node> children;
+            if (!anchored_start)
+            {
+                children.push_back(repeat_node(bytes_node(any_byte()), 0, unbounded));
+            }
+
+            children.push_back(std::move(expression));
+            if (!anchored_end)
+            {
+                children.push_back(repeat_node(bytes_node(any_byte()), 0, unbounded));
+            }
+
+            return concat_node(std::move(children));
+        }
+
+        /// Parses a glob, matching a whole path, a part of it after a
+        /// '/' or a directory the path is in
+        node
+        glob()
+        {
+            while (this->_pattern.size() > 1 && this->_pattern.ends_with('/'))
+            {
+                this->_pattern.remove_suffix(1);
+            }
+
+            std::vector<node> children;
+            if (!this->_pattern.starts_with('/'))
+            {
+                children.push_back(repeat_node(bytes_node(any_byte()), 0, unbounded));
+                children.push_back(byte_node('/'));
+            }
+
+            while (this->_position < this->_pattern.size())
+            {
+                const char c = this->_pattern[this->_position++];
+                switch (c)
+                {
+                    case '*':
+                    {
+                        const std::size_t star = this->_position - 1;
+                        if (this->_position < this->_pattern.size() && this->_pattern[this->_position] == '*')
+                        {
+                            while (this->_position < this->_pattern.size() && this->_pattern[this->_position] == '*')
+                            {
+                                ++this->_position;
+                            }
+
+                            const std::size_t start = this->_position;
+                            const bool component_start = star == 0 || this->_pattern[star - 1] == '/';
+                            if (component_start && start < this->_pattern.size() && this->_pattern[start] == '/')
+                            {
+                                // "**/" matches no directories or any
+                                // number of them
+                                ++this->_position;
+                                children.push_back(
+                                    repeat_node(
+                                        concat_node({repeat_node(bytes_node(any_byte()), 0, unbounded),
+                                                     byte_node('/')}),
+                                        0,
+                                        1));
+                            }
+                            else
+                            {
+                                children.push_back(repeat_node(bytes_node(any_byte()), 0, unbounded));
+                            }
+                        }
+                        else
+                        {
+                            children.push_back(repeat_node(bytes_node(any_but_slash()), 0, unbounded));
+                        }
+
+                        break;
+                    }
+                    case '?':
+                    {
+                        children.push_back(bytes_node(any_but_slash()));
+                        break;
+                    }
+                    case '[':
+                    {
+                        byte_set bytes = this->bracket('!');
+                        bytes.reset('/');
+                        children.push_back(bytes_node(bytes));
+                        break;
+                    }
+                    case '\\':
+                    {
+                        if (this->_position == this->_pattern.size())
+                        {
+                            this->fail("trailing backslash");
+                        }
+
+                        children.push_back(byte_node(this->_pattern[this->_position++]));
+                        break;
+                    }
+                    default:
+                    {
+                        children.push_back(byte_node(c));
+                        break;
+                    }
+                }
+            }
+
+            // a matching directory matches everything underneath it
+            children.push_back(
+                repeat_node(
+                    concat_node({byte_node('/'), repeat_node(bytes_node(any_byte()), 0, unbounded)}),
+                    0,
+                    1));
+
+            return concat_node(std::move(children));
+        }
+
+        private:
+
+        [[noreturn]]
+        void
+        fail(const std::string & message) const
+        {
+            throw std::invalid_argument(message + " in pattern " + std::string(this->_source));
+        }
+
+        bool
+        at_end() const noexcept
+        {
+            return this->_position == this->_pattern.size();
+        }
+
+        char
+        peek() const noexcept
+        {
+            return this->_pattern[this->_position];
+        }
+
+        node
+        alternation()
+        {
+            node alternatives;
+            alternatives.t = node::type::alternate;
+            alternatives.children.push_back(this->concatenation());
+            while (!this->at_end() && this->peek() == '|')
+            {
+                ++this->_position;
+                alternatives.children.push_back(this->concatenation());
+            }
+
+            if (alternatives.children.size() == 1)
+            {
+                return std::move(alternatives.children.front());
+            }
+
+            return alternatives;
+        }
+
+        node
+        concatenation()
+        {
+            std::vector<node> children;
+            while (!this->at_end() && this->peek() != '|' && this->peek() != ')')
+            {
+                children.push_back(this->repetition());
+            }
+
+            if (children.size() == 1)
+            {
+                return std::move(children.front());
+            }
+
+            return concat_node(std::move(children));
+        }
+
+        node
+        repetition()
+        {
+            node n = this->atom();
+            while (!this->at_end())
+            {
+                unsigned min = 0;
+                unsigned max = 0;
+                const char c = this->peek();
+                if (c == '*')
+                {
+                    max = unbounded;
+                }
+                else if (c == '+')
+                {
+                    min = 1;
+                    max = unbounded;
+                }
+                else if (c == '?')
+                {
+                    max = 1;
+                }
+                else if (c != '{' || !this->count(min, max))
+                {
+                    break;
+                }
+
+                if (c != '{')
+                {
+                    ++this->_position;
+                }
+
+                n = repeat_node(std::move(n), min, max);
+            }
+
+            return n;
+        }
+
+        /// Parses a {min}, {min,} or {min,max} repetition, returns false
+        /// and leaves the position at the '{' if there isn't one
+        bool
+        count(unsigned & min, unsigned & max)
+        {
+            const std::size_t start = this->_position;
+            ++this->_position;
+            if (!this->number(min))
+            {
+                this->_position = start;
+                return false;
+            }
+
+            max = min;
+            if (!this->at_end() && this->peek() == ',')
+            {
+                ++this->_position;
+                if (!this->number(max))
+                {
+                    max = unbounded;
+                }
+            }
+
+            if (this->at_end() || this->peek() != '}')
+            {
+                this->_position = start;
+                return false;
+            }
+
+            ++this->_position;
+            if (min > max || min > max_repetition || (max != unbounded && max > max_repetition))
+            {
+                this->fail("invalid repetition count");
+            }
+
+            return true;
+        }
+
+        bool
+        number(unsigned & value)
+        {
+            const std::size_t start = this->_position;
+            value = 0;
+            while (!this->at_end() && this->peek() >= '0' && this->peek() <= '9')
+            {
+                value = std::min(value * 10 + (this->peek() - '0'), max_repetition + 1);
+                ++this->_position;
+            }
+
+            return this->_position != start;
+        }
+
+        node
+        atom()
+        {
+            const char c = this->_pattern[this->_position++];
+            switch (c)
+            {
+                case '(':
+                {
+                    if (this->_pattern.substr(this->_position).starts_with("?:"))
+                    {
+                        this->_position += 2;
+                    }
+
+                    node group = this->alternation();
+                    if (this->at_end())
+                    {
+                        this->fail("unmatched '('");
+                    }
+
+                    ++this->_position;
+                    return group;
+                }
+                case '[':
+                {
+                    return bytes_node(this->bracket('^'));
+                }
+                case '.':
+                {
+                    return bytes_node(any_byte());
+                }
+                case '\\':
+                {
+                    if (this->at_end())
+                    {
+                        this->fail("trailing backslash");
+                    }
+
+                    const char escaped = this->_pattern[this->_position++];
+                    byte_set bytes;
+                    if (set_escape_class(escaped, bytes))
+                    {
+                        return bytes_node(bytes);
+                    }
+
+                    return byte_node(escaped_byte(escaped));
+                }
+                case '*':
+                case '+':
+                case '?':
+                {
+                    this->fail("nothing to repeat");
+                }
+                case '^':
+                case '$':
+                {
+                    this->fail("anchors are only supported at the start and end");
+                }
+                default:
+                {
+                    return byte_node(c);
+                }
+            }
+        }
+
+        /// Parses a bracket expression after its '[', negated by a
+        /// leading negation character or '^'
+        byte_set
+        bracket(char negation)
+        {
+            byte_set bytes;
+            bool negated = false;
+            if (!this->at_end() && (this->peek() == negation || this->peek() == '^'))
+            {
+                negated = true;
+                ++this->_position;
+            }
+
+            bool first = true;
+            while (true)
+            {
+                if (this->at_end())
+                {
+                    this->fail("unmatched '['");
+                }
+
+                char c = this->_pattern[this->_position++];
+                if (c == ']' && !first)
+                {
+                    break;
+                }
+
+                first = false;
+                if (c == '[' && !this->at_end() && this->peek() == ':')
+                {
+                    const std::size_t end = this->_pattern.find(":]", this->_position + 1);
+                    if (end == std::string_view::npos ||
+                        !set_named_class(this->_pattern.substr(this->_position + 1, end - this->_position - 1), bytes))
+                    {
+                        this->fail("invalid character class");
+                    }
+
+                    this->_position = end + 2;
+                    continue;
+                }
+
+                if (c == '\\')
+                {
+                    if (this->at_end())
+                    {
+                        this->fail("trailing backslash");
+                    }
+
+                    c = this->_pattern[this->_position++];
+                    if (set_escape_class(c, bytes))
+                    {
+                        continue;
+                    }
+
+                    c = static_cast<char>(escaped_byte(c));
+                }
+
+                unsigned char last = static_cast<unsigned char>(c);
+                if (this->_position + 1 < this->_pattern.size() &&
+                    this->peek() == '-' &&
+                    this->_pattern[this->_position + 1] != ']')
+                {
+                    ++this->_position;
+                    char end = this->_pattern[this->_position++];
+                    if (end == '\\' && !this->at_end())
+                    {
+                        end = static_cast<char>(escaped_byte(this->_pattern[this->_position++]));
+                    }
+
+                    last = static_cast<unsigned char>(end);
+                    if (last < static_cast<unsigned char>(c))
+                    {
+                        this->fail("invalid range");
+                    }
+                }
+
+                for (unsigned b = static_cast<unsigned char>(c); b <= last; ++b)
+                {
+                    bytes.set(b);
+                }
+            }
+
+            return negated ? ~bytes : bytes;
+        }
+
+        // the whole pattern and the part of it being parsed
+        std::string_view _source;
+        std::string_view _pattern;
+        std::size_t _position = 0;
+    };
+
+    class nfa
+    {
+        public:
+
+        static constexpr std::size_t none = std::numeric_limits<std::size_t>::max();
+
+        struct state
+        {
+            // bytes leading to next
+            byte_set bytes;
+            std::size_t next = none;
+            std::vector<std::size_t> epsilon;
+            std::uint8_t accept = 0;
+
+            // the kind of the pattern the state is part of
+            std::uint8_t pattern = 0;
+        };
+
+        nfa():
+            _states(1)
+        {}
+
+        /// Adds a pattern reachable from the start state
+        void
+        add(const node & pattern, std::uint8_t accept)
+        {
+            const std::size_t first = this->_states.size();
+            const auto [start, end] = this->build(pattern);
+            this->_states[end].accept |= accept;
+            this->_states.front().epsilon.push_back(start);
+            for (std::size_t i = first; i < this->_states.size(); ++i)
+            {
+                this->_states[i].pattern = accept;
+            }
+        }
+
+        /// Adds a state that matches accept whatever follows
+        std::size_t
+        add_sink(std::uint8_t accept)
+        {
+            const std::size_t sink = this->add_state();
+            this->_states[sink].bytes = any_byte();
+            this->_states[sink].next = sink;
+            this->_states[sink].accept = accept;
+            return sink;
+        }
+
+        const std::vector<state> &
+        states() const noexcept
+        {
+            return this->_states;
+        }
+
+        private:
+
+        std::size_t
+        add_state()
+        {
+            if (this->_states.size() == max_states)
+            {
+                throw std::invalid_argument("the patterns are too large");
+            }
+
+            this->_states.emplace_back();
+            return this->_states.size() - 1;
+        }
+
+        /// Returns the start and end states of n
+        std::pair<std::size_t, std::size_t>
+        build(const node & n)
+        {
+            switch (n.t)
+            {
+                case node::type::bytes:
+                {
+                    const std::size_t start = this->add_state();
+                    const std::size_t end = this->add_state();
+                    this->_states[start].bytes = n.bytes;
+                    this->_states[start].next = end;
+                    return {start, end};
+                }
+                case node::type::concat:
+                {
+                    const std::size_t start = this->add_state();
+                    std::size_t end = start;
+                    for (const node & child: n.children)
+                    {
+                        const auto [child_start, child_end] = this->build(child);
+                        this->_states[end].epsilon.push_back(child_start);
+                        end = child_end;
+                    }
+
+                    return {start, end};
+                }
+                case node::type::alternate:
+                {
+                    const std::size_t start = this->add_state();
+                    const std::size_t end = this->add_state();
+                    for (const node & child: n.children)
+                    {
+                        const auto [child_start, child_end] = this->build(child);
+                        this->_states[start].epsilon.push_back(child_start);
+                        this->_states[child_end].epsilon.push_back(end);
+                    }
+
+                    return {start, end};
+                }
+                case node::type::repeat:
+                {
+                    const node & child = n.children.front();
+                    const std::size_t start = this->add_state();
+                    std::size_t end = start;
+                    for (unsigned i = 0; i < n.min; ++i)
+                    {
+                        const auto [child_start, child_end] = this->build(child);
+                        this->_states[end].epsilon.push_back(child_start);
+                        end = child_end;
+                    }
+
+                    if (n.max == unbounded)
+                    {
+                        const auto [child_start, child_end] = this->build(child);
+                        const std::size_t loop_end = this->add_state();
+                        this->_states[end].epsilon.push_back(child_start);
+                        this->_states[end].epsilon.push_back(loop_end);
+                        this->_states[child_end].epsilon.push_back(child_start);
+                        this->_states[child_end].epsilon.push_back(loop_end);
+                        return {start, loop_end};
+                    }
+
+                    // each optional repetition can skip the remaining ones
+                    const std::size_t repeat_end = this->add_state();
+                    for (unsigned i = n.min; i < n.max; ++i)
+                    {
+                        const auto [child_start, child_end] = this->build(child);
+                        this->_states[end].epsilon.push_back(child_start);
+                        this->_states[end].epsilon.push_back(repeat_end);
+                        end = child_end;
+                    }
+
+                    this->_states[end].epsilon.push_back(repeat_end);
+                    return {start, repeat_end};
+                }
+            }
+
+            return {none, none};
+        }
+
+        std::vector<state> _states;
+    };
+
+    /// Adds the states reachable from states without reading a byte,
+    /// and sorts them
+    void
+    close(const nfa & automaton, std::vector<std::size_t> & states, std::vector<bool> & seen)
+    {
+        std::fill(seen.begin(), seen.end(), false);
+        for (const std::size_t s: states)
+        {
+            seen[s] = true;
+        }
+
+        for (std::size_t i = 0; i < states.size(); ++i)
+        {
+            for (const std::size_t next: automaton.states()[states[i]].epsilon)
+            {
+                if (!seen[next])
+                {
+                    seen[next] = true;
+                    states.push_back(next);
+                }
+            }
+        }
+
+        std::sort(states.begin(), states.end());
+    }
+
+    /** Marks the states from which every path is matched by a pattern
+     *  of kind accept.
+     *
+     *  A state is marked if it matches the end of a path and, for every
+     *  byte, a state reachable from it without reading a byte reads it
+     *  into a marked state.  This finds the states after a pattern has
+     *  matched a directory, but not every state that always matches.
+     */
+    std::vector<bool>
+    always_matching(const nfa & automaton, std::uint8_t accept)
+    {
+        const std::vector<nfa::state> & states = automaton.states();
+        std::vector<std::vector<std::size_t>> closures(states.size());
+        std::vector<bool> seen(states.size());
+        std::vector<bool> marked(states.size());
+        for (std::size_t s = 0; s < states.size(); ++s)
+        {
+            closures[s].push_back(s);
+            close(automaton, closures[s], seen);
+            marked[s] = std::any_of(closures[s].begin(), closures[s].end(), [&](std::size_t t)
+            {
+                return (states[t].accept & accept) != 0;
+            });
+        }
+
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (std::size_t s = 0; s < states.size(); ++s)
+            {
+                if (!marked[s])
+                {
+                    continue;
+                }
+
+                byte_set covered;
+                for (const std::size_t t: closures[s])
+                {
+                    if (states[t].next != nfa::none && marked[states[t].next])
+                    {
+                        covered |= states[t].bytes;
+                    }
+                }
+
+                if (!covered.all())
+                {
+                    marked[s] = false;
+                    changed = true;
+                }
+            }
+        }
+
+        return marked;
+    }
+}
+
+path_matcher::path_matcher():
+    _transitions(2, 0),
+    _accepts(2, 0)
+{}
+
+bool
+path_matcher::empty() const noexcept
+{
+    return this->_patterns.empty();
+}
+
+void
+path_matcher::add(std::string_view pattern, kind k)
+{
+    this->_patterns.emplace_back(pattern, k);
+    try
+    {
+        this->compile();
+    }
+    catch (...)
+    {
+        this->_patterns.pop_back();
+        throw;
+    }
+}
+
+bool
+path_matcher::selects(std::string_view path) const noexcept
+{
+    if (this->_patterns.empty())
+    {
+        return true;
+    }
+
+    std::uint32_t state = 1;
+    for (const char c: path)
+    {
+        state = this->_transitions[state * this->_class_count + this->_classes[static_cast<unsigned char>(c)]];
+        if (state == 0)
+        {
+            break;
+        }
+    }
+
+    const std::uint8_t accepts = this->_accepts[state];
+    if (accepts & exclude_flag)
+    {
+        return false;
+    }
+
+    return !this->_has_includes || (accepts & include_flag);
+}
+
+void
+path_matcher::compile()
+{
+    nfa automaton;
+    bool has_includes = false;
+    for (const auto & [pattern, k]: this->_patterns)
+    {
+        const std::string_view regex_prefix = "re:";
+        pattern_parser parser {pattern.starts_with(regex_prefix) ?
+                               std::string_view(pattern).substr(regex_prefix.size()) :
+                               std::string_view(pattern)};
+        const node tree = pattern.starts_with(regex_prefix) ? parser.regex() : parser.glob();
+        automaton.add(tree, k == kind::include ? include_flag : exclude_flag);
+        has_includes = has_includes || k == kind::include;
+    }
+
+    // Once a path is known to be excluded, or to be included, the
+    // states of the patterns that can't change that are replaced by a
+    // sink.  Otherwise every combination of the patterns' progress
+    // would become a state.
+    const std::size_t include_sink = automaton.add_sink(include_flag);
+    const std::size_t exclude_sink = automaton.add_sink(exclude_flag);
+    const std::vector<bool> always_included = always_matching(automaton, include_flag);
+    const std::vector<bool> always_excluded = always_matching(automaton, exclude_flag);
+
+    const std::vector<nfa::state> & states = automaton.states();
+
+    // Bytes are split into the classes that every transition either
+    // contains completely or not at all.
+    std::array<std::uint16_t, 256> classes {};
+    std::size_t class_count = 1;
+    for (const nfa::state & s: states)
+    {
+        if (s.next == nfa::none)
+        {
+            continue;
+        }
+
+        std::map<std::pair<std::uint16_t, bool>, std::uint16_t> split;
+        for (unsigned b = 0; b < 256; ++b)
+        {
+            const auto [i, inserted] =
+                split.try_emplace({classes[b], s.bytes.test(b)}, static_cast<std::uint16_t>(split.size()));
+            classes[b] = i->second;
+        }
+
+        class_count = split.size();
+    }
+
+    std::vector<unsigned> representatives(class_count);
+    for (unsigned b = 256; b-- > 0;)
+    {
+        representatives[classes[b]] = b;
+    }
+
+    // the dead state is the empty set of states
+    std::vector<std::uint32_t> transitions(class_count, 0);
+    std::vector<std::uint8_t> accepts(1, 0);
+    std::map<std::vector<std::size_t>, std::uint32_t> ids {{{}, 0}};
+    std::vector<std::vector<std::size_t>> pending;
+    std::vector<bool> seen(states.size());
+
+    const auto id = [&](std::vector<std::size_t> set)
+    {
+        close(automaton, set, seen);
+        const auto marked = [&](const std::vector<bool> & always)
+        {
+            return std::any_of(set.begin(), set.end(), [&](std::size_t s) { return always[s]; });
+        };
+
+        if (marked(always_excluded))
+        {
+            set = {exclude_sink};
+        }
+        else if (marked(always_included))
+        {
+            std::erase_if(set, [&](std::size_t s) { return s == include_sink || states[s].pattern == include_flag; });
+            set.insert(std::upper_bound(set.begin(), set.end(), include_sink), include_sink);
+        }
+        const auto [i, inserted] = ids.try_emplace(set, static_cast<std::uint32_t>(ids.size()));
+        if (inserted)
+        {
+            if (ids.size() > max_states)
+            {
+                throw std::invalid_argument("the patterns are too complex");
+            }
+
+            std::uint8_t accept = 0;
+            for (const std::size_t s: set)
+            {
+                accept |= states[s].accept;
+            }
+
+            accepts.push_back(accept);
+            transitions.resize(transitions.size() + class_count, 0);
+            pending.push_back(std::move(set));
+        }
+
+        return i->second;
+    };
+
+    id({0});
+    for (std::uint32_t current = 1; current < ids.size(); ++current)
+    {
+        const std::vector<std::size_t> set = std::move(pending[current - 1]);
+        for (std::size_t c = 0; c < class_count; ++c)
+        {
+            std::vector<std::size_t> next;
+            for (const std::size_t s: set)
+            {
+                if (states[s].next != nfa::none && states[s].bytes.test(representatives[c]))
+                {
+                    next.push_back(states[s].next);
+                }
+            }
+
+            transitions[current * class_count + c] = next.empty() ? 0 : id(std::move(next));
+        }
+    }
+
+    this->_has_includes = has_includes;
+    this->_classes = classes;
+    this->_class_count = class_count;
+    this->_transitions = std::move(transitions);
+    this->_accepts = std::move(accepts);
+}
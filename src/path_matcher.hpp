@@ -0,0 +1,80 @@
+#ifndef PATH_MATCHER_HPP
+#define PATH_MATCHER_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/** Include and exclude patterns compiled into a single automaton.
+ *
+ *  Patterns are globs, or extended regular expressions when prefixed
+ *  with "re:".  All of them are compiled into one deterministic
+ *  automaton over the bytes of a path, so a path is matched against
+ *  every pattern in a single pass with one table lookup per byte, and
+ *  without allocating.
+ *
+ *  A glob matches an absolute path if it matches the whole path, a
+ *  part of it that starts after a '/', or a directory the path is in,
+ *  so "*.pb.cc" matches generated files anywhere and "third_party"
+ *  matches everything in third_party directories.  '*' and '?' don't
+ *  match '/' while "**" does, and "**" followed by a '/' matches any
+ *  number of directories.  A glob starting with '/' only matches from
+ *  the root.
+ *
+ *  A regular expression matches anywhere in the path unless it's
+ *  anchored with a leading '^' or a trailing '$', which are the only
+ *  anchors supported.
+ */
+class path_matcher
+{
+    public:
+
+    enum class kind
+    {
+        include,
+        exclude
+    };
+
+    path_matcher();
+
+    bool
+    empty() const noexcept;
+
+    /** Adds pattern and compiles the automaton again.
+     *
+     *  Throws std::invalid_argument if pattern isn't a valid glob or
+     *  regular expression, and leaves the matcher unchanged.
+     */
+    void
+    add(std::string_view pattern, kind k);
+
+    /// True if path matches an include pattern, or there are none, and
+    /// doesn't match an exclude pattern
+    bool
+    selects(std::string_view path) const noexcept;
+
+    private:
+
+    void
+    compile();
+
+    std::vector<std::pair<std::string, kind>> _patterns;
+    bool _has_includes = false;
+
+    // bytes that no pattern tells apart share a class
+    std::array<std::uint16_t, 256> _classes {};
+    std::size_t _class_count = 1;
+
+    // the next state of each state and byte class, state 0 is the dead
+    // state and state 1 the start state
+    std::vector<std::uint32_t> _transitions;
+
+    // the kinds of patterns matched when a path ends in each state
+    std::vector<std::uint8_t> _accepts;
+};
+
+#endif
@@ -0,0 +1,105 @@
+#include <cstddef>
+#include "path_trie.hpp"
+#include <string>
+#include <string_view>
+
+namespace
+{
+    /// Returns the next component of path at or after position and
+    /// moves position past it, empty components are skipped
+    std::string_view
+    next_component(std::string_view path, std::size_t & position) noexcept
+    {
+        while (position < path.size() && path[position] == '/')
+        {
+            ++position;
+        }
+
+        const std::size_t start = position;
+        while (position < path.size() && path[position] != '/')
+        {
+            ++position;
+        }
+
+        return path.substr(start, position - start);
+    }
+}
+
+path_trie::path_trie():
+    _nodes(1)
+{}
+
+bool
+path_trie::empty() const noexcept
+{
+    return this->_nodes.size() == 1 && !this->_nodes.front().tree;
+}
+
+void
+path_trie::insert(std::string_view path, kind k)
+{
+    std::size_t n = 0;
+    std::size_t position = 0;
+    for (std::string_view component = next_component(path, position);
+         !component.empty();
+         component = next_component(path, position))
+    {
+        const auto i = this->_nodes[n].children.find(component);
+        if (i != this->_nodes[n].children.end())
+        {
+            n = i->second;
+            continue;
+        }
+
+        const std::size_t child = this->_nodes.size();
+        this->_nodes.emplace_back();
+        this->_nodes[n].children.emplace(component, child);
+        n = child;
+    }
+
+    node & inserted = this->_nodes[n];
+    switch (k)
+    {
+        case kind::file:
+            inserted.file = true;
+            break;
+        case kind::directory:
+            inserted.directory = true;
+            break;
+        case kind::tree:
+            inserted.tree = true;
+            break;
+    }
+}
+
+bool
+path_trie::contains(std::string_view path) const
+{
+    const node * n = &this->_nodes.front();
+    std::size_t position = 0;
+    std::string_view component = next_component(path, position);
+    while (!component.empty())
+    {
+        if (n->tree)
+        {
+            return true;
+        }
+
+        const std::string_view next = next_component(path, position);
+        if (next.empty() && n->directory)
+        {
+            return true;
+        }
+
+        const auto i = n->children.find(component);
+        if (i == n->children.end())
+        {
+            return false;
+        }
+
+        n = &this->_nodes[i->second];
+        component = next;
+    }
+
+    return n->tree || n->file;
+}
@@ -0,0 +1,57 @@
+#ifndef PATH_TRIE_HPP
+#define PATH_TRIE_HPP
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/** A set of absolute paths matched one component at a time.
+ *
+ *  A path is inserted as a file, matching only itself, as a directory,
+ *  matching the files directly in it, or as a tree, matching everything
+ *  underneath it.  Looking a path up doesn't touch the file system, so
+ *  paths are compared as they're spelled.
+ */
+class path_trie
+{
+    public:
+
+    enum class kind
+    {
+        file,
+        directory,
+        tree
+    };
+
+    path_trie();
+
+    bool
+    empty() const noexcept;
+
+    /// Inserts path, which must be absolute and lexically normal
+    void
+    insert(std::string_view path, kind k);
+
+    /// True if any inserted path matches path, which must be absolute
+    /// and lexically normal
+    bool
+    contains(std::string_view path) const;
+
+    private:
+
+    struct node
+    {
+        // indexes of the nodes of each component under this node
+        std::map<std::string, std::size_t, std::less<>> children;
+        bool file = false;
+        bool directory = false;
+        bool tree = false;
+    };
+
+    std::vector<node> _nodes;
+};
+
+#endif
@@ -0,0 +1,401 @@
+#include <algorithm>
+#include <cctype>
+#include <clang-c/Index.h>
+#include "compile_command.hpp"
+#include "content_hash.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include "ngclang.hpp"
+#include <optional>
+#include "pch_cache.hpp"
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+// Each line of a precompiled header's dependency file is the size and
+// modification time of a file in the precompiled header followed by
+// its path.
+
+namespace
+{
+    bool
+    is_space(char c)
+    {
+        return std::isspace(static_cast<unsigned char>(c));
+    }
+
+    /// Returns the arguments of command without its main file and the
+    /// arguments that name its outputs
+    std::vector<std::string>
+    group_arguments(const compile_command & command)
+    {
+        const std::string path = command.path().string();
+        std::vector<std::string> arguments;
+        for (std::size_t i = 0; i < command.size(); ++i)
+        {
+            const std::string_view argument = command.array()[i];
+            if (argument == command.file() || argument == path ||
+                argument == "-c" || argument == "-MD" || argument == "-MMD")
+            {
+                continue;
+            }
+
+            if (argument == "-o" || argument == "-MF" || argument == "-MT" || argument == "-MQ")
+            {
+                ++i;
+                continue;
+            }
+
+            arguments.emplace_back(argument);
+        }
+
+        return arguments;
+    }
+
+    /// Translation units are grouped by their arguments and their
+    /// first include, so one unusual file doesn't leave its whole flag
+    /// set without a common prefix
+    std::string
+    group_key(const std::string & directory,
+              const std::vector<std::string> & arguments,
+              const std::string & first_include)
+    {
+        std::string key = directory;
+        for (const auto & argument: arguments)
+        {
+            key += '\0';
+            key += argument;
+        }
+
+        key += '\0';
+        key += first_include;
+        return key;
+    }
+
+    /** Returns the include directives file starts with.
+     *
+     *  Quoted includes found next to file are made absolute so the
+     *  directives can be used from another directory.  Blank lines,
+     *  line comments and #pragma once don't end the includes.
+     */
+    std::vector<std::string>
+    leading_includes(const std::filesystem::path & file)
+    {
+        std::vector<std::string> includes;
+        std::ifstream stream(file);
+        std::string line;
+        while (std::getline(stream, line))
+        {
+            auto i = std::find_if_not(line.cbegin(), line.cend(), is_space);
+            const std::string_view rest {i, line.cend()};
+            if (rest.empty() || rest.starts_with("//"))
+            {
+                continue;
+            }
+
+            if (*i != '#')
+            {
+                break;
+            }
+
+            i = std::find_if_not(i + 1, line.cend(), is_space);
+            const std::string_view directive {i, line.cend()};
+            if (directive.starts_with("pragma") &&
+                directive.find("once") != std::string_view::npos)
+            {
+                continue;
+            }
+
+            constexpr std::string_view include_directive = "include";
+            if (!directive.starts_with(include_directive))
+            {
+                break;
+            }
+
+            i = std::find_if_not(i + include_directive.size(), line.cend(), is_space);
+            if (i == line.cend() || (*i != '"' && *i != '<'))
+            {
+                break;
+            }
+
+            const char close = (*i == '"') ? '"' : '>';
+            const auto end = std::find(i + 1, line.cend(), close);
+            if (end == line.cend())
+            {
+                break;
+            }
+
+            const std::string name {i + 1, end};
+            if (close == '"')
+            {
+                std::error_code ec;
+                const auto local = std::filesystem::canonical(file.parent_path() / name, ec);
+                if (!ec)
+                {
+                    includes.push_back("#include \"" + local.string() + '"');
+                    continue;
+                }
+            }
+
+            includes.push_back("#include " + std::string(i, end + 1));
+        }
+
+        return includes;
+    }
+
+    /// Returns the size and modification time of file
+    std::optional<std::pair<std::uintmax_t, std::int64_t>>
+    file_version(const std::filesystem::path & file)
+    {
+        std::error_code ec;
+        const std::uintmax_t size = std::filesystem::file_size(file, ec);
+        if (ec)
+        {
+            return std::nullopt;
+        }
+
+        const auto mtime = std::filesystem::last_write_time(file, ec);
+        if (ec)
+        {
+            return std::nullopt;
+        }
+
+        return std::make_pair(size, static_cast<std::int64_t>(mtime.time_since_epoch().count()));
+    }
+
+    /// Reads the files of an up to date precompiled header's dependency
+    /// file, returns false if any of them changed
+    bool
+    read_dependencies(const std::filesystem::path & file, std::vector<std::string> & files)
+    {
+        std::ifstream stream(file);
+        if (!stream)
+        {
+            return false;
+        }
+
+        std::uintmax_t size;
+        std::int64_t mtime;
+        std::string path;
+        while (stream >> size >> mtime && stream.get() == ' ' && std::getline(stream, path))
+        {
+            const auto version = file_version(path);
+            if (!version || version->first != size || version->second != mtime)
+            {
+                return false;
+            }
+
+            files.push_back(path);
+        }
+
+        return stream.eof();
+    }
+
+    void
+    write_dependencies(const std::filesystem::path & file, const std::vector<std::string> & files)
+    {
+        std::filesystem::path tmp_file = file;
+        tmp_file += ".tmp";
+
+        {
+            std::ofstream stream(tmp_file, std::ios::trunc);
+            for (const auto & f: files)
+            {
+                const auto version = file_version(f);
+                if (version)
+                {
+                    stream << version->first << ' ' << version->second << ' ' << f << '\n';
+                }
+            }
+
+            if (!stream)
+            {
+                throw std::runtime_error("error writing " + tmp_file.string());
+            }
+        }
+
+        std::filesystem::rename(tmp_file, file);
+    }
+}
+
+pch_cache::pch_cache(std::filesystem::path directory):
+    _directory(std::move(directory))
+{}
+
+void
+pch_cache::add(const compile_command & command)
+{
+    if (command.empty())
+    {
+        return;
+    }
+
+    std::vector<std::string> includes = leading_includes(command.path());
+    if (includes.empty())
+    {
+        return;
+    }
+
+    std::vector<std::string> arguments = group_arguments(command);
+    const std::string key = group_key(command.directory(), arguments, includes.front());
+
+    auto [i, inserted] = this->_groups.try_emplace(key);
+    group & g = i->second;
+    if (inserted)
+    {
+        g.directory = command.directory();
+        g.arguments = std::move(arguments);
+        g.prefix = std::move(includes);
+    }
+    else
+    {
+        const auto mismatch = std::mismatch(g.prefix.begin(), g.prefix.end(),
+                                            includes.begin(), includes.end());
+        g.prefix.erase(mismatch.first, g.prefix.end());
+    }
+
+    ++g.size;
+}
+
+void
+pch_cache::build(CXIndex index, unsigned parse_options)
+{
+    for (auto & [key, g]: this->_groups)
+    {
+        // A precompiled header only saves time when it's used more
+        // than once.
+        if (g.size < 2 || g.prefix.empty())
+        {
+            continue;
+        }
+
+        std::uint64_t hash = content_hash(key);
+        for (const auto & include: g.prefix)
+        {
+            hash = content_hash(include, hash);
+        }
+        hash = content_hash(std::to_string(parse_options), hash);
+
+        std::ostringstream name;
+        name << std::hex << std::setw(16) << std::setfill('0') << hash;
+        g.pch = this->_directory / (name.str() + ".pch");
+
+        std::filesystem::path dependencies = g.pch;
+        dependencies.replace_extension(".deps");
+
+        std::error_code ec;
+        if (std::filesystem::exists(g.pch, ec) && read_dependencies(dependencies, g.files))
+        {
+            continue;
+        }
+
+        g.files.clear();
+        if (!this->build(index, parse_options, g))
+        {
+            std::cerr << "error building precompiled header " << g.pch << '\n';
+            g.pch.clear();
+            g.files.clear();
+            continue;
+        }
+
+        write_dependencies(dependencies, g.files);
+    }
+}
+
+bool
+pch_cache::build(CXIndex index, unsigned parse_options, group & g) const
+{
+    std::filesystem::create_directories(this->_directory);
+
+    std::filesystem::path header = g.pch;
+    header.replace_extension(".hpp");
+    {
+        std::ofstream stream(header, std::ios::trunc);
+        for (const auto & include: g.prefix)
+        {
+            stream << include << '\n';
+        }
+
+        if (!stream)
+        {
+            return false;
+        }
+    }
+
+    std::cout << "building pch: " << header << " for " << g.size << " translation units" << std::endl;
+
+    std::vector<std::string> arguments = g.arguments;
+    arguments.push_back("-x");
+    arguments.push_back("c++-header");
+    arguments.push_back(header.string());
+
+    std::vector<const char *> argv;
+    argv.reserve(arguments.size());
+    for (const auto & argument: arguments)
+    {
+        argv.push_back(argument.c_str());
+    }
+
+    ngclang::translation_unit_t unit;
+    const CXErrorCode error =
+        clang_parseTranslationUnit2FullArgv(
+            index,
+            nullptr,
+            argv.data(),
+            argv.size(),
+            nullptr,
+            0,
+            parse_options | CXTranslationUnit_Incomplete | CXTranslationUnit_ForSerialization,
+            &unit.get());
+
+    if (error != CXError_Success || ngclang::has_errors(unit.get()))
+    {
+        return false;
+    }
+
+    std::filesystem::path tmp_file = g.pch;
+    tmp_file += ".tmp";
+    if (clang_saveTranslationUnit(unit.get(), tmp_file.c_str(), CXSaveTranslationUnit_None) != CXSaveError_None)
+    {
+        return false;
+    }
+
+    std::filesystem::rename(tmp_file, g.pch);
+
+    const std::string header_path = std::filesystem::canonical(header).string();
+    g.files = ngclang::included_files(unit.get());
+    std::erase(g.files, header_path);
+
+    return true;
+}
+
+std::vector<std::string>
+pch_cache::apply(compile_command & command) const
+{
+    if (command.empty())
+    {
+        return {};
+    }
+
+    const std::vector<std::string> includes = leading_includes(command.path());
+    if (includes.empty())
+    {
+        return {};
+    }
+
+    const auto i = this->_groups.find(group_key(command.directory(), group_arguments(command), includes.front()));
+    if (i == this->_groups.end() || i->second.pch.empty())
+    {
+        return {};
+    }
+
+    command.insert_arguments(1, {"-include-pch", i->second.pch.string()});
+    return i->second.files;
+}
@@ -0,0 +1,82 @@
+#ifndef PCH_CACHE_HPP
+#define PCH_CACHE_HPP
+
+#include <clang-c/Index.h>
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+class compile_command;
+
+/** Precompiled headers for the includes translation units start with.
+ *
+ *  Compile commands are grouped by their arguments, ignoring the main
+ *  file and output arguments, and by the first file their main file
+ *  includes.  When the translation units of a group start with the
+ *  same includes, a precompiled header is built for those includes and
+ *  passed to each of them with -include-pch, so they're only parsed
+ *  once.
+ *
+ *  Precompiled headers are kept in a cache directory and reused by
+ *  later runs until one of the files they include changes.
+ */
+class pch_cache
+{
+    public:
+
+    explicit
+    pch_cache(std::filesystem::path directory);
+
+    pch_cache(const pch_cache &) = delete;
+    pch_cache& operator = (const pch_cache &) = delete;
+
+    /// Records the arguments of command and the includes its main file
+    /// starts with
+    void
+    add(const compile_command & command);
+
+    /** Builds or reuses the precompiled header of each group of
+     *  translation units that start with the same includes.
+     *
+     *  Translation units are parsed with parse_options.  A group whose
+     *  precompiled header fails to build is parsed without one.
+     */
+    void
+    build(CXIndex index, unsigned parse_options);
+
+    /** Adds -include-pch to command if its group has a precompiled
+     *  header.
+     *
+     *  Returns the files in the precompiled header, libclang doesn't
+     *  report them as included by the translation unit.
+     */
+    std::vector<std::string>
+    apply(compile_command & command) const;
+
+    private:
+
+    struct group
+    {
+        std::string directory;
+
+        // the arguments without the main file and output arguments
+        std::vector<std::string> arguments;
+
+        // the includes all the group's main files start with
+        std::vector<std::string> prefix;
+        std::size_t size = 0;
+
+        std::filesystem::path pch;
+        std::vector<std::string> files;
+    };
+
+    bool
+    build(CXIndex index, unsigned parse_options, group & g) const;
+
+    std::filesystem::path _directory;
+    std::map<std::string, group> _groups;
+};
+
+#endif
@@ -0,0 +1,299 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <linux/futex.h>
+#include <new>
+#include "shared_channel.hpp"
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace
+{
+    static_assert(std::atomic<std::uint32_t>::is_always_lock_free);
+    static_assert(std::atomic<std::int64_t>::is_always_lock_free);
+
+    // the length of a statement followed by its kind
+    constexpr std::uint32_t record_header_size = sizeof(std::uint32_t) + 1;
+
+    /// Waits until word isn't value, or timeout passed
+    void
+    futex_wait(const std::atomic<std::uint32_t> & word, std::uint32_t value, const timespec & timeout) noexcept
+    {
+        // Not FUTEX_WAIT_PRIVATE, the word is shared with another
+        // process.
+        ::syscall(SYS_futex, reinterpret_cast<const std::uint32_t *>(&word), FUTEX_WAIT, value, &timeout, nullptr, 0);
+    }
+
+    void
+    futex_wake(const std::atomic<std::uint32_t> & word) noexcept
+    {
+        ::syscall(SYS_futex, reinterpret_cast<const std::uint32_t *>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+}
+
+/// The part of the shared memory before the buffer.  Positions in the
+/// buffer only grow, wrapping at 2^32, and the capacity is a power of
+/// two, so a position modulo the capacity is an offset in the buffer.
+struct shared_channel::control
+{
+    // the end of the statements sent, written by the child
+    alignas(64) std::atomic<std::uint32_t> head {0};
+
+    // the end of the statements received, written by the parent
+    alignas(64) std::atomic<std::uint32_t> tail {0};
+
+    // set by the child before it waits for tail to change
+    std::atomic<std::uint32_t> writer_waiting {0};
+
+    // the number of replies, the child waits for it to change
+    alignas(64) std::atomic<std::uint32_t> replies {0};
+    std::atomic<std::uint32_t> reply {0};
+
+    // the time the child waited for the parent, and when its current
+    // wait started or 0, written by the child.  The steady clock is
+    // the same in both processes.
+    alignas(64) std::atomic<std::int64_t> waited {0};
+    std::atomic<std::int64_t> waiting_since {0};
+};
+
+shared_channel::shared_channel(std::size_t capacity):
+    _capacity(std::bit_ceil(static_cast<std::uint32_t>(std::clamp<std::size_t>(capacity, 4096, 1u << 30)))),
+    _mapped_size(sizeof(control) + _capacity),
+    _parent(::getpid())
+{
+    void * memory = ::mmap(nullptr, this->_mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+    {
+        throw std::system_error(errno, std::generic_category(), "error mapping shared channel");
+    }
+
+    this->_signal = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (this->_signal < 0)
+    {
+        const int error = errno;
+        ::munmap(memory, this->_mapped_size);
+        throw std::system_error(error, std::generic_category(), "error creating shared channel signal");
+    }
+
+    this->_control = new (memory) control;
+    this->_data = static_cast<char *>(memory) + sizeof(control);
+}
+
+shared_channel::~shared_channel()
+{
+    this->_control->~control();
+    ::munmap(this->_control, this->_mapped_size);
+    ::close(this->_signal);
+}
+
+void
+shared_channel::send(record_kind kind, std::string_view statement)
+{
+    if (statement.size() > this->_capacity - record_header_size)
+    {
+        throw std::length_error("statement longer than the shared channel");
+    }
+
+    const std::uint32_t size = record_header_size + statement.size();
+
+    // Only the child writes head.
+    const std::uint32_t head = this->_control->head.load(std::memory_order_relaxed);
+    while (this->_capacity - (head - this->_control->tail.load()) < size)
+    {
+        // Either the parent sees that the child waits after it moved
+        // tail, or the child sees the new tail.
+        this->_control->writer_waiting.store(1);
+        const std::uint32_t tail = this->_control->tail.load();
+        if (this->_capacity - (head - tail) >= size)
+        {
+            break;
+        }
+
+        this->wait(this->_control->tail, tail);
+    }
+
+    const std::uint32_t length = statement.size();
+    char header[record_header_size];
+    std::memcpy(header, &length, sizeof(length));
+    header[sizeof(length)] = static_cast<char>(kind);
+
+    this->copy_in(head, header, record_header_size);
+    this->copy_in(head + record_header_size, statement.data(), length);
+    this->_control->head.store(head + size);
+
+    // If the parent didn't receive everything before this statement,
+    // it's still receiving and gets to it without a signal.
+    if (this->_control->tail.load() == head)
+    {
+        const std::uint64_t one = 1;
+        if (::write(this->_signal, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        {
+            throw std::system_error(errno, std::generic_category(), "error signalling shared channel");
+        }
+    }
+}
+
+bool
+shared_channel::request(std::string_view statement)
+{
+    const std::uint32_t replies = this->_control->replies.load();
+    this->send(record_kind::exists, statement);
+    while (this->_control->replies.load() == replies)
+    {
+        this->wait(this->_control->replies, replies);
+    }
+
+    return this->_control->reply.load() != 0;
+}
+
+int
+shared_channel::signal() const noexcept
+{
+    return this->_signal;
+}
+
+void
+shared_channel::acknowledge() noexcept
+{
+    std::uint64_t count;
+    [[maybe_unused]] const auto result = ::read(this->_signal, &count, sizeof(count));
+}
+
+bool
+shared_channel::empty() const noexcept
+{
+    return this->_control->head.load() == this->_control->tail.load(std::memory_order_relaxed);
+}
+
+std::chrono::steady_clock::duration
+shared_channel::waited() const noexcept
+{
+    const std::int64_t waited = this->_control->waited.load();
+    const std::int64_t since = this->_control->waiting_since.load();
+    const std::int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
+    return std::chrono::steady_clock::duration(waited + (since != 0 ? now - since : 0));
+}
+
+bool
+shared_channel::receive(record_kind & kind, std::string & statement)
+{
+    // Only the parent writes tail.
+    const std::uint32_t tail = this->_control->tail.load(std::memory_order_relaxed);
+    const std::uint32_t available = this->_control->head.load() - tail;
+    if (available == 0)
+    {
+        return false;
+    }
+
+    char header[record_header_size] {};
+    std::uint32_t length = 0;
+    if (available >= record_header_size)
+    {
+        this->copy_out(tail, header, record_header_size);
+        std::memcpy(&length, header, sizeof(length));
+    }
+
+    const auto raw_kind = static_cast<std::uint8_t>(header[sizeof(length)]);
+    if (available < record_header_size ||
+        length > available - record_header_size ||
+        raw_kind > static_cast<std::uint8_t>(record_kind::exists))
+    {
+        throw std::runtime_error("invalid statement in shared channel");
+    }
+
+    kind = static_cast<record_kind>(raw_kind);
+    statement.resize(length);
+    this->copy_out(tail + record_header_size, statement.data(), length);
+    this->_control->tail.store(tail + record_header_size + length);
+
+    if (this->_control->writer_waiting.exchange(0) != 0)
+    {
+        futex_wake(this->_control->tail);
+    }
+
+    return true;
+}
+
+void
+shared_channel::reply(bool exists) noexcept
+{
+    this->_control->reply.store(exists ? 1 : 0);
+    this->_control->replies.fetch_add(1);
+    futex_wake(this->_control->replies);
+}
+
+void
+shared_channel::wait(const std::atomic<std::uint32_t> & word, std::uint32_t value) const
+{
+    // A child whose parent exited is reparented, and would otherwise
+    // wait forever.
+    const timespec timeout {1, 0};
+    const std::int64_t start = std::chrono::steady_clock::now().time_since_epoch().count();
+    this->_control->waiting_since.store(start);
+    futex_wait(word, value, timeout);
+    const std::int64_t end = std::chrono::steady_clock::now().time_since_epoch().count();
+    // Cleared before the time is added, so the parent, which reads
+    // them the other way around, doesn't count a wait twice.
+    this->_control->waiting_since.store(0);
+    this->_control->waited.fetch_add(end - start);
+    if (::getppid() != this->_parent)
+    {
+        throw std::runtime_error("parent process exited");
+    }
+}
+
+void
+shared_channel::copy_in(std::uint32_t position, const char * data, std::uint32_t size) noexcept
+{
+    const std::uint32_t offset = position & (this->_capacity - 1);
+    const std::uint32_t first = std::min(size, this->_capacity - offset);
+    std::memcpy(this->_data + offset, data, first);
+    std::memcpy(this->_data, data + first, size - first);
+}
+
+void
+shared_channel::copy_out(std::uint32_t position, char * data, std::uint32_t size) const noexcept
+{
+    const std::uint32_t offset = position & (this->_capacity - 1);
+    const std::uint32_t first = std::min(size, this->_capacity - offset);
+    std::memcpy(data, this->_data + offset, first);
+    std::memcpy(data + first, this->_data, size - first);
+}
+
+ngmg::channel_connection::channel_connection(std::reference_wrapper<shared_channel> channel):
+    _channel(&channel.get())
+{}
+
+void
+ngmg::channel_connection::write(const std::string & statement, bool existing_ok)
+{
+    this->_channel->send(existing_ok ? shared_channel::record_kind::write_existing_ok :
+                                       shared_channel::record_kind::write,
+                         statement);
+}
+
+bool
+ngmg::channel_connection::exists(const std::string & statement)
+{
+    return this->_channel->request(statement);
+}
+
+mg::Client *
+ngmg::channel_connection::client() noexcept
+{
+    return nullptr;
+}
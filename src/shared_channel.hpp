@@ -0,0 +1,149 @@
+#ifndef SHARED_CHANNEL_HPP
+#define SHARED_CHANNEL_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include "graph_connection.hpp"
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+
+/** Graph statements sent by a child process to its parent through
+ *  shared memory.
+ *
+ *  The parent creates a channel before forking the child.  The child
+ *  appends statements to a ring buffer in memory both processes map,
+ *  and the parent executes them in order with its own memgraph
+ *  client, so statements aren't copied through a pipe or socket.  A
+ *  statement that checks whether a node or relationship exists blocks
+ *  the child until the parent replies.
+ *
+ *  The parent polls an eventfd that the child only signals when it
+ *  appends to an empty buffer, and the child waits for space and for
+ *  replies on futexes.  A statement is only visible to the parent
+ *  once it's completely written, so a child that crashes or is killed
+ *  leaves the statements before the one it was writing.
+ *
+ *  There is one writer, the child, and one reader, the parent.
+ */
+class shared_channel
+{
+    public:
+
+    enum class record_kind: std::uint8_t
+    {
+        write,
+
+        // a merge of a node another client may create first, which is
+        // retried when it fails so it matches that node
+        write_existing_ok,
+
+        // a statement whose reply is whether it returned a row
+        exists
+    };
+
+    /// Maps a buffer of at least capacity bytes.  Throws
+    /// std::system_error if it can't be mapped.
+    explicit
+    shared_channel(std::size_t capacity = 1 << 20);
+
+    shared_channel(const shared_channel &) = delete;
+    shared_channel& operator = (const shared_channel &) = delete;
+
+    ~shared_channel();
+
+    /// Appends statement, called by the child.  Waits while the
+    /// buffer is full.
+    void
+    send(record_kind kind, std::string_view statement);
+
+    /// Appends an exists statement and returns the parent's reply,
+    /// called by the child
+    bool
+    request(std::string_view statement);
+
+    /// The eventfd signalled when the child appends to an empty buffer,
+    /// to poll
+    int
+    signal() const noexcept;
+
+    /// Resets the signal once it was polled, call before receiving
+    void
+    acknowledge() noexcept;
+
+    bool
+    empty() const noexcept;
+
+    /// The time the child spent waiting for replies and for space in
+    /// the buffer, including a wait that hasn't ended
+    std::chrono::steady_clock::duration
+    waited() const noexcept;
+
+    /** Removes the next statement, called by the parent.
+     *
+     *  Returns false if the buffer is empty.  Throws
+     *  std::runtime_error if the child wrote something that isn't a
+     *  statement.
+     */
+    bool
+    receive(record_kind & kind, std::string & statement);
+
+    /// Replies to the exists statement received last
+    void
+    reply(bool exists) noexcept;
+
+    private:
+
+    struct control;
+
+    /// Waits until the shared word changes from value and adds the
+    /// time to waited(), throws std::runtime_error if the parent
+    /// exited, called by the child
+    void
+    wait(const std::atomic<std::uint32_t> & word, std::uint32_t value) const;
+
+    void
+    copy_in(std::uint32_t position, const char * data, std::uint32_t size) noexcept;
+
+    void
+    copy_out(std::uint32_t position, char * data, std::uint32_t size) const noexcept;
+
+    control * _control = nullptr;
+    char * _data = nullptr;
+    std::uint32_t _capacity = 0;
+    std::size_t _mapped_size = 0;
+    int _signal = -1;
+    pid_t _parent = -1;
+};
+
+namespace ngmg
+{
+    /// A connection whose statements are executed by the parent
+    /// process, sent through a shared_channel
+    class channel_connection: public connection
+    {
+        public:
+
+        explicit
+        channel_connection(std::reference_wrapper<shared_channel> channel);
+
+        void
+        write(const std::string & statement, bool existing_ok) override;
+
+        bool
+        exists(const std::string & statement) override;
+
+        /// Returns nullptr, the parent has the client
+        mg::Client *
+        client() noexcept override;
+
+        private:
+
+        shared_channel * _channel;
+    };
+}
+
+#endif
@@ -0,0 +1,162 @@
+#include <cerrno>
+#include <filesystem>
+#include <netdb.h>
+#include "socket_address.hpp"
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace
+{
+    bool
+    is_tcp_address(const std::string & address)
+    {
+        return address.find(':') != std::string::npos && address.find('/') == std::string::npos;
+    }
+
+    /// Creates a socket for the first address of host and port that
+    /// setup succeeds for
+    template <class Setup>
+    int
+    tcp_socket(const std::string & address, bool passive, Setup setup)
+    {
+        const std::string::size_type colon = address.rfind(':');
+        const std::string host = address.substr(0, colon);
+        const std::string port = address.substr(colon + 1);
+
+        addrinfo hints {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = passive ? AI_PASSIVE : 0;
+
+        addrinfo * addresses = nullptr;
+        const int error = ::getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &addresses);
+        if (error != 0)
+        {
+            throw std::runtime_error(address + ": " + ::gai_strerror(error));
+        }
+
+        int last_error = 0;
+        int fd = -1;
+        for (const addrinfo * a = addresses; a; a = a->ai_next)
+        {
+            fd = ::socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC, a->ai_protocol);
+            if (fd < 0)
+            {
+                last_error = errno;
+                continue;
+            }
+
+            if (setup(fd, a->ai_addr, a->ai_addrlen))
+            {
+                break;
+            }
+
+            last_error = errno;
+            ::close(fd);
+            fd = -1;
+        }
+
+        ::freeaddrinfo(addresses);
+        if (fd < 0)
+        {
+            throw std::system_error(last_error, std::generic_category(), address);
+        }
+
+        return fd;
+    }
+
+    sockaddr_un
+    unix_address(const std::string & path)
+    {
+        sockaddr_un address {};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path))
+        {
+            throw std::system_error(std::make_error_code(std::errc::filename_too_long), path);
+        }
+
+        path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+        return address;
+    }
+}
+
+int
+listen_socket(const std::string & address)
+{
+    if (is_tcp_address(address))
+    {
+        return tcp_socket(address, true, [] (int fd, const sockaddr * a, socklen_t size) {
+            const int reuse = 1;
+            ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+            return ::bind(fd, a, size) == 0 && ::listen(fd, 64) == 0;
+        });
+    }
+
+    const sockaddr_un unix = unix_address(address);
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "socket");
+    }
+
+    std::error_code ec;
+    if (std::filesystem::is_socket(address, ec))
+    {
+        std::filesystem::remove(address, ec);
+    }
+
+    // Only the owner may connect.  Nothing can connect before listen,
+    // so the socket's mode is set in between.
+    if (::bind(fd, reinterpret_cast<const sockaddr *>(&unix), sizeof(unix)) < 0 ||
+        ::chmod(address.c_str(), S_IRUSR | S_IWUSR) < 0 ||
+        ::listen(fd, 64) < 0)
+    {
+        const int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), address);
+    }
+
+    return fd;
+}
+
+int
+connect_socket(const std::string & address)
+{
+    if (is_tcp_address(address))
+    {
+        return tcp_socket(address, false, [] (int fd, const sockaddr * a, socklen_t size) {
+            return ::connect(fd, a, size) == 0;
+        });
+    }
+
+    const sockaddr_un unix = unix_address(address);
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "socket");
+    }
+
+    if (::connect(fd, reinterpret_cast<const sockaddr *>(&unix), sizeof(unix)) < 0)
+    {
+        const int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), address);
+    }
+
+    return fd;
+}
+
+void
+remove_socket(const std::string & address) noexcept
+{
+    if (!is_tcp_address(address))
+    {
+        std::error_code ec;
+        std::filesystem::remove(address, ec);
+    }
+}
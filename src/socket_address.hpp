@@ -0,0 +1,31 @@
+#ifndef SOCKET_ADDRESS_HPP
+#define SOCKET_ADDRESS_HPP
+
+#include <string>
+
+/** Stream sockets named by an address string.
+ *
+ *  An address with a colon and no slash is a TCP address, host:port,
+ *  where an empty host is the loopback address when connecting and
+ *  every address when listening.  Any other address is the path of a
+ *  Unix domain socket.
+ *
+ *  A Unix domain socket only accepts connections from its owner.  A
+ *  TCP socket listening on :port accepts them from any host that can
+ *  reach it, with no authentication.
+ */
+
+/// Returns a socket listening on address, a Unix domain socket left
+/// at address by a previous listener is replaced
+int
+listen_socket(const std::string & address);
+
+/// Returns a socket connected to address
+int
+connect_socket(const std::string & address);
+
+/// Removes the Unix domain socket listen_socket created for address
+void
+remove_socket(const std::string & address) noexcept;
+
+#endif
@@ -0,0 +1,262 @@
+#include <cerrno>
+#include <clang-c/Index.h>
+#include <cstddef>
+#include <cstdint>
+#include <fcntl.h>
+#include "file_watcher.hpp"
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <set>
+#include "source_cache.hpp"
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    std::int64_t
+    modification_time(const struct stat & status) noexcept
+    {
+        return static_cast<std::int64_t>(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec;
+    }
+}
+
+/// The contents of a cached file, read into memory
+struct source_cache::cached_file
+{
+    /// Throws std::system_error if path can't be read
+    cached_file(std::string file, bool watched_file):
+        path(std::move(file)),
+        watched(watched_file)
+    {
+        const int fd = ::open(this->path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            throw std::system_error(errno, std::generic_category(), this->path);
+        }
+
+        struct stat status;
+        if (::fstat(fd, &status) < 0)
+        {
+            const int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), this->path);
+        }
+
+        this->mtime = modification_time(status);
+        this->contents = std::make_unique_for_overwrite<char []>(status.st_size);
+
+        // A file that's truncated while it's read is kept as far as it
+        // was read, its modification time tells it changed.
+        const std::size_t size = status.st_size;
+        while (this->size < size)
+        {
+            const ssize_t read = ::read(fd, this->contents.get() + this->size, size - this->size);
+            if (read < 0 && errno == EINTR)
+            {
+                continue;
+            }
+
+            if (read < 0)
+            {
+                const int error = errno;
+                ::close(fd);
+                throw std::system_error(error, std::generic_category(), this->path);
+            }
+
+            if (read == 0)
+            {
+                break;
+            }
+
+            this->size += read;
+        }
+
+        ::close(fd);
+    }
+
+    cached_file(const cached_file &) = delete;
+    cached_file& operator = (const cached_file &) = delete;
+
+    /// True if the file has the modification time and size it was
+    /// read with
+    bool
+    unchanged() const noexcept
+    {
+        struct stat status;
+        return ::stat(this->path.c_str(), &status) == 0 &&
+            static_cast<std::size_t>(status.st_size) == this->size &&
+            modification_time(status) == this->mtime;
+    }
+
+    const std::string path;
+    std::unique_ptr<char []> contents;
+    std::size_t size = 0;
+    std::int64_t mtime = 0;
+
+    // whether inotify reports the changes of the file
+    const bool watched;
+};
+
+CXUnsavedFile *
+source_cache::snapshot::files() noexcept
+{
+    return this->_files.empty() ? nullptr : this->_files.data();
+}
+
+unsigned
+source_cache::snapshot::size() const noexcept
+{
+    return this->_files.size();
+}
+
+source_cache::source_cache(invalidation mode):
+    _invalidation(mode)
+{
+    if (this->_invalidation == invalidation::inotify)
+    {
+        this->_watcher = std::make_unique<file_watcher>();
+    }
+}
+
+source_cache::~source_cache() = default;
+
+source_cache::snapshot
+source_cache::find(const std::vector<std::string> & files)
+{
+    snapshot found;
+    {
+        const std::lock_guard lock(this->_mutex);
+        if (this->_watcher)
+        {
+            const file_watcher::change_set changes = this->_watcher->changes();
+            for (const auto & changed: changes.files)
+            {
+                this->_files.erase(changed);
+            }
+
+            // After an overflow any watched file may have changed, and
+            // files in directories that are no longer watched are
+            // watched again when they're added.
+            for (const auto & directory: changes.unwatched)
+            {
+                this->_watched.erase(directory);
+            }
+
+            if (changes.overflow || !changes.unwatched.empty())
+            {
+                std::erase_if(this->_files, [&changes] (const auto & file) {
+                    return file.second->watched &&
+                        (changes.overflow ||
+                         changes.unwatched.contains(std::filesystem::path(file.first).parent_path().string()));
+                });
+            }
+        }
+
+        std::unordered_set<std::string_view> seen;
+        for (const auto & file: files)
+        {
+            const auto i = this->_files.find(file);
+            if (i != this->_files.end() && seen.insert(file).second)
+            {
+                found._cached_files.push_back(i->second);
+            }
+        }
+    }
+
+    // The files inotify doesn't watch are checked without holding the
+    // lock, so the other workers aren't waiting for their stat calls.
+    std::vector<std::shared_ptr<const cached_file>> changed;
+    std::erase_if(found._cached_files, [&changed] (const std::shared_ptr<const cached_file> & f) {
+        if (f->watched || f->unchanged())
+        {
+            return false;
+        }
+
+        changed.push_back(f);
+        return true;
+    });
+
+    if (!changed.empty())
+    {
+        const std::lock_guard lock(this->_mutex);
+        for (const auto & f: changed)
+        {
+            const auto i = this->_files.find(f->path);
+            if (i != this->_files.end() && i->second == f)
+            {
+                this->_files.erase(i);
+            }
+        }
+    }
+
+    found._files.reserve(found._cached_files.size());
+    for (const auto & f: found._cached_files)
+    {
+        found._files.push_back({f->path.c_str(), f->size ? f->contents.get() : "", static_cast<unsigned long>(f->size)});
+    }
+
+    return found;
+}
+
+void
+source_cache::add(const std::vector<std::string> & files)
+{
+    for (const auto & file: files)
+    {
+        bool watched = false;
+        {
+            const std::lock_guard lock(this->_mutex);
+            if (this->_files.contains(file))
+            {
+                continue;
+            }
+
+            // The directory is watched before the file is read, so a
+            // change after it's read isn't missed.
+            watched = this->watch(std::filesystem::path(file).parent_path().string());
+        }
+
+        std::shared_ptr<const cached_file> cached;
+        try
+        {
+            cached = std::make_shared<const cached_file>(file, watched);
+        }
+        catch (const std::system_error &)
+        {
+            continue;
+        }
+
+        const std::lock_guard lock(this->_mutex);
+        this->_files.try_emplace(file, std::move(cached));
+    }
+}
+
+bool
+source_cache::watch(const std::string & directory)
+{
+    if (!this->_watcher || this->_unwatched.contains(directory))
+    {
+        return false;
+    }
+
+    if (this->_watched.contains(directory))
+    {
+        return true;
+    }
+
+    if (!this->_watcher->add_directory(directory))
+    {
+        this->_unwatched.insert(directory);
+        return false;
+    }
+
+    this->_watched.insert(directory);
+    return true;
+}
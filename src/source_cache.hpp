@@ -0,0 +1,98 @@
+#ifndef SOURCE_CACHE_HPP
+#define SOURCE_CACHE_HPP
+
+#include <clang-c/Index.h>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class file_watcher;
+
+/** The contents of the sources and headers translation units include,
+ *  shared by the workers of a process.
+ *
+ *  Each file is read once and passed to libclang as an unsaved file,
+ *  so translation units parsed after the first one that included it
+ *  don't read it again.  libclang still opens the file when it looks an
+ *  include up, but doesn't read it.
+ *
+ *  With mtime invalidation a file is dropped from the cache when its
+ *  modification time or size changes, with inotify invalidation when
+ *  inotify reports that it changed, and every watched file is dropped
+ *  when inotify loses events.  Files in directories that can't be
+ *  watched are checked by modification time.
+ */
+class source_cache
+{
+    struct cached_file;
+
+    public:
+
+    enum class invalidation
+    {
+        mtime,
+        inotify
+    };
+
+    /// Unsaved files for one parse, their contents stay valid while
+    /// the snapshot exists
+    class snapshot
+    {
+        public:
+
+        CXUnsavedFile *
+        files() noexcept;
+
+        unsigned
+        size() const noexcept;
+
+        private:
+
+        friend class source_cache;
+
+        std::vector<std::shared_ptr<const cached_file>> _cached_files;
+        std::vector<CXUnsavedFile> _files;
+    };
+
+    /// Throws std::system_error if inotify invalidation is asked for and
+    /// inotify can't be used
+    explicit
+    source_cache(invalidation mode);
+
+    ~source_cache();
+
+    source_cache(const source_cache &) = delete;
+    source_cache& operator = (const source_cache &) = delete;
+
+    /// Returns the cached contents of those of files that haven't
+    /// changed since they were read
+    snapshot
+    find(const std::vector<std::string> & files);
+
+    /// Reads the files that aren't cached, files that can't be read
+    /// are skipped
+    void
+    add(const std::vector<std::string> & files);
+
+    private:
+
+    /// Returns true if the changes in directory are reported by inotify
+    bool
+    watch(const std::string & directory);
+
+    const invalidation _invalidation;
+
+    mutable std::mutex _mutex;
+    std::unique_ptr<file_watcher> _watcher;
+
+    // the directories inotify watches and those it can't
+    std::set<std::string> _watched;
+    std::set<std::string> _unwatched;
+
+    std::unordered_map<std::string, std::shared_ptr<const cached_file>> _files;
+};
+
+#endif
@@ -33,6 +33,16 @@ ngmg::statement_executor::execute(const std::string & statement, const mg::Const
     }
 }
 
+void
+ngmg::statement_executor::discard()
+{
+    if (this->_discard_all)
+    {
+        this->_discard_all = false;
+        this->_client->DiscardAll();
+    }
+}
+
 mg::Client &
 ngmg::statement_executor::client() noexcept
 {
@@ -40,6 +40,11 @@ namespace ngmg
         void
         execute(const std::string & statement, const mg::ConstMap & params);
 
+        /// Discards the results of the executed statement, unlike the
+        /// destructor this reports errors the statement ran into
+        void
+        discard();
+
         mg::Client &
         client() noexcept;
 
@@ -0,0 +1,109 @@
+#include <clang-c/Index.h>
+#include "compile_command.hpp"
+#include <cstddef>
+#include <list>
+#include <map>
+#include <memory>
+#include "ngclang.hpp"
+#include <string>
+#include "translation_units.hpp"
+
+namespace
+{
+    /// The memory libclang uses for unit, without the source files it
+    /// maps, which the kernel can drop
+    std::size_t
+    memory_usage(CXTranslationUnit unit)
+    {
+        CXTUResourceUsage usage = clang_getCXTUResourceUsage(unit);
+        std::size_t memory = 0;
+        for (unsigned i = 0; i < usage.numEntries; ++i)
+        {
+            if (usage.entries[i].kind != CXTUResourceUsage_SourceManager_Membuffer_MMap)
+            {
+                memory += usage.entries[i].amount;
+            }
+        }
+
+        clang_disposeCXTUResourceUsage(usage);
+        return memory;
+    }
+}
+
+translation_units::translation_units(std::size_t memory_limit):
+    _memory_limit(memory_limit)
+{}
+
+CXTranslationUnit
+translation_units::parse(CXIndex index, const compile_command & command, unsigned parse_options)
+{
+    const std::string key = command.path().string();
+    auto i = this->_units.find(key);
+    if (i != this->_units.end())
+    {
+        CXTranslationUnit unit = i->second.translation_unit->get();
+        if (clang_reparseTranslationUnit(unit, 0, nullptr, clang_defaultReparseOptions(unit)) == 0)
+        {
+            this->touch(i, memory_usage(unit));
+            return unit;
+        }
+
+        // A translation unit that failed to reparse can only be disposed.
+        this->_memory_used -= i->second.memory;
+        this->_recently_parsed.erase(i->second.use);
+        this->_units.erase(i);
+    }
+
+    auto translation_unit = std::make_unique<ngclang::translation_unit_t>(nullptr);
+    const CXErrorCode error =
+        clang_parseTranslationUnit2FullArgv(
+            index,
+            nullptr,
+            command.array(),
+            command.size(),
+            nullptr,
+            0,
+            parse_options | CXTranslationUnit_PrecompiledPreamble | CXTranslationUnit_CreatePreambleOnFirstParse,
+            &translation_unit->get());
+
+    if (error != CXError_Success)
+    {
+        return nullptr;
+    }
+
+    CXTranslationUnit parsed = translation_unit->get();
+    this->_recently_parsed.push_front(key);
+    i = this->_units.emplace(key, unit {std::move(translation_unit), 0, this->_recently_parsed.begin()}).first;
+    this->touch(i, memory_usage(parsed));
+    return parsed;
+}
+
+std::size_t
+translation_units::memory_used() const noexcept
+{
+    return this->_memory_used;
+}
+
+std::size_t
+translation_units::size() const noexcept
+{
+    return this->_units.size();
+}
+
+void
+translation_units::touch(std::map<std::string, unit>::iterator i, std::size_t memory)
+{
+    this->_memory_used = this->_memory_used - i->second.memory + memory;
+    i->second.memory = memory;
+    this->_recently_parsed.splice(this->_recently_parsed.begin(), this->_recently_parsed, i->second.use);
+
+    // The unit just parsed is kept even if it's larger than the limit
+    // on its own, it's returned to the caller.
+    while (this->_memory_used > this->_memory_limit && this->_recently_parsed.size() > 1)
+    {
+        const auto evicted = this->_units.find(this->_recently_parsed.back());
+        this->_memory_used -= evicted->second.memory;
+        this->_units.erase(evicted);
+        this->_recently_parsed.pop_back();
+    }
+}
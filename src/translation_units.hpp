@@ -0,0 +1,78 @@
+#ifndef TRANSLATION_UNITS_HPP
+#define TRANSLATION_UNITS_HPP
+
+#include <clang-c/Index.h>
+#include <cstddef>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include "ngclang.hpp"
+
+class compile_command;
+
+/** Parsed translation units kept alive between parses.
+ *
+ *  A translation unit is parsed the first time it's requested, with a
+ *  precompiled preamble that's created right away, and later requests
+ *  reparse it with clang_reparseTranslationUnit, which reuses the
+ *  preamble so only the files after it are parsed again.
+ *
+ *  The translation units are kept while the memory libclang reports
+ *  for them stays under a limit, past it the least recently parsed
+ *  ones are disposed.
+ */
+class translation_units
+{
+    public:
+
+    explicit
+    translation_units(std::size_t memory_limit);
+
+    translation_units(const translation_units &) = delete;
+    translation_units& operator = (const translation_units &) = delete;
+
+    /** Returns the up to date translation unit of command, or nullptr
+     *  if it can't be parsed.
+     *
+     *  The translation unit is owned by this object and is valid until
+     *  the next call.
+     */
+    CXTranslationUnit
+    parse(CXIndex index, const compile_command & command, unsigned parse_options);
+
+    /// The memory used by the translation units kept
+    std::size_t
+    memory_used() const noexcept;
+
+    /// The number of translation units kept
+    std::size_t
+    size() const noexcept;
+
+    private:
+
+    struct unit
+    {
+        std::unique_ptr<ngclang::translation_unit_t> translation_unit;
+        std::size_t memory = 0;
+
+        // the unit's position in _recently_parsed
+        std::list<std::string>::iterator use;
+    };
+
+    /// Records that the unit at i was parsed and now uses memory, and
+    /// disposes of the least recently parsed other units until the
+    /// limit is kept
+    void
+    touch(std::map<std::string, unit>::iterator i, std::size_t memory);
+
+    std::map<std::string, unit> _units;
+
+    // the keys of _units, the most recently parsed first
+    std::list<std::string> _recently_parsed;
+
+    const std::size_t _memory_limit;
+    std::size_t _memory_used = 0;
+};
+
+#endif
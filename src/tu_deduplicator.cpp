@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <array>
+#include "compile_command.hpp"
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include "tu_deduplicator.hpp"
+#include <utility>
+#include <vector>
+
+namespace
+{
+    /// Arguments whose value is the next argument and that don't
+    /// change the parse
+    constexpr std::array ignored_with_value {
+        std::string_view("-o"),
+        std::string_view("-MF"),
+        std::string_view("-MT"),
+        std::string_view("-MQ")
+    };
+
+    /// Arguments that don't change the parse
+    constexpr std::array ignored {
+        std::string_view("-c"),
+        std::string_view("-MD"),
+        std::string_view("-MMD"),
+        std::string_view("-MP"),
+        std::string_view("-fPIC"),
+        std::string_view("-fpic"),
+        std::string_view("-fPIE"),
+        std::string_view("-fpie"),
+        std::string_view("-fno-pic"),
+        std::string_view("-fno-PIC"),
+        std::string_view("-fno-pie"),
+        std::string_view("-fno-PIE"),
+        std::string_view("-w"),
+        std::string_view("-pedantic"),
+        std::string_view("-pedantic-errors")
+    };
+
+    /// Debug information arguments, which don't change the parse
+    constexpr std::array debug_arguments {
+        std::string_view("-g"),
+        std::string_view("-g0"),
+        std::string_view("-g1"),
+        std::string_view("-g2"),
+        std::string_view("-g3"),
+        std::string_view("-gline-tables-only"),
+        std::string_view("-gline-directives-only"),
+        std::string_view("-gmlt"),
+        std::string_view("-gfull"),
+        std::string_view("-gused"),
+        std::string_view("-gmodules"),
+        std::string_view("-gcolumn-info"),
+        std::string_view("-gembed-source"),
+        std::string_view("-gstrict-dwarf"),
+        std::string_view("-gpubnames"),
+        std::string_view("-ggnu-pubnames"),
+        std::string_view("-gsimple-template-names"),
+        std::string_view("-gbtf"),
+        std::string_view("-gcodeview"),
+        std::string_view("-gcodeview-ghash")
+    };
+
+    /// Prefixes of debug information arguments, -ggdb3, -gdwarf-5,
+    /// -gsplit-dwarf=single, -gz=zlib or -gno-column-info
+    constexpr std::array debug_prefixes {
+        std::string_view("-ggdb"),
+        std::string_view("-gdwarf"),
+        std::string_view("-gsplit-dwarf"),
+        std::string_view("-gstabs"),
+        std::string_view("-gz"),
+        std::string_view("-gno-")
+    };
+
+    /// Arguments followed by a path, either joined or as the next
+    /// argument
+    constexpr std::array path_arguments {
+        std::string_view("-include-pch"),
+        std::string_view("-I"),
+        std::string_view("-isystem"),
+        std::string_view("-iquote"),
+        std::string_view("-idirafter"),
+        std::string_view("-include"),
+        std::string_view("-imacros")
+    };
+
+    bool
+    is_ignored(std::string_view argument) noexcept
+    {
+        // -o<file>, warnings, optimization and debug information, but
+        // not -Wp, which passes arguments to the preprocessor, or
+        // -gcc-toolchain, which isn't a debug argument
+        return std::ranges::find(ignored, argument) != ignored.end() ||
+            argument.starts_with("-o") ||
+            (argument.starts_with("-W") && !argument.starts_with("-Wp,")) ||
+            argument.starts_with("-O") ||
+            std::ranges::find(debug_arguments, argument) != debug_arguments.end() ||
+            std::ranges::any_of(debug_prefixes, [argument] (std::string_view prefix) {
+                return argument.starts_with(prefix);
+            });
+    }
+
+    std::string
+    absolute(const std::string & directory, std::string_view path)
+    {
+        return (std::filesystem::path(directory) / path).lexically_normal().string();
+    }
+}
+
+std::string
+tu_deduplicator::arguments_key(const compile_command & command)
+{
+    const std::string path = command.path().string();
+    std::string key;
+    for (std::size_t i = 0; i < command.size(); ++i)
+    {
+        const std::string_view argument = command.array()[i];
+        if (argument == command.file() || argument == path)
+        {
+            continue;
+        }
+
+        if (std::ranges::find(ignored_with_value, argument) != ignored_with_value.end())
+        {
+            ++i;
+            continue;
+        }
+
+        if (is_ignored(argument))
+        {
+            continue;
+        }
+
+        key += '\0';
+        const auto path_argument = std::ranges::find_if(path_arguments, [argument] (std::string_view prefix) {
+            return argument.starts_with(prefix);
+        });
+
+        if (path_argument == path_arguments.end())
+        {
+            key += argument;
+        }
+        else if (argument.size() > path_argument->size())
+        {
+            key += *path_argument;
+            key += absolute(command.directory(), argument.substr(path_argument->size()));
+        }
+        else if (i + 1 < command.size())
+        {
+            key += argument;
+            key += absolute(command.directory(), command.array()[++i]);
+        }
+    }
+
+    return key;
+}
+
+bool
+tu_deduplicator::add(const compile_command & command)
+{
+    ++this->_commands;
+    if (this->_keys.insert(command.path().lexically_normal().string() + arguments_key(command)).second)
+    {
+        return true;
+    }
+
+    ++this->_collapsed[command.path().lexically_normal().string()];
+    return false;
+}
+
+void
+tu_deduplicator::print_statistics(std::ostream & stream) const
+{
+    std::size_t collapsed = 0;
+    for (const auto & [file, count]: this->_collapsed)
+    {
+        collapsed += count;
+    }
+
+    stream << "compile commands: " << this->_commands
+           << ", translation units: " << this->_keys.size()
+           << ", collapsed: " << collapsed << '\n';
+
+    std::vector<std::pair<std::size_t, std::string>> files;
+    for (const auto & [file, count]: this->_collapsed)
+    {
+        files.emplace_back(count, file);
+    }
+
+    constexpr std::size_t max_files = 10;
+    const std::size_t shown = std::min(files.size(), max_files);
+    std::partial_sort(files.begin(), files.begin() + shown, files.end(), std::greater<> {});
+    for (std::size_t i = 0; i < shown; ++i)
+    {
+        stream << "  " << files[i].first << " collapsed: " << files[i].second << '\n';
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef TU_DEDUPLICATOR_HPP
+#define TU_DEDUPLICATOR_HPP
+
+#include <cstddef>
+#include <map>
+#include <ostream>
+#include <set>
+#include <string>
+
+class compile_command;
+
+/** Finds compile commands that parse the same translation unit.
+ *
+ *  A compile database lists a file once per object built from it, PIC
+ *  and non PIC objects or one per target sharing the file.  Those
+ *  compile commands only differ in arguments that don't change what
+ *  libclang parses: output files, dependency files, position
+ *  independent code, warnings, optimization and debug information.
+ *
+ *  Compile commands are compared by their main file and their
+ *  arguments without those, with include paths made absolute, and only
+ *  the first of each group is parsed.
+ */
+class tu_deduplicator
+{
+    public:
+
+    tu_deduplicator() = default;
+
+    tu_deduplicator(const tu_deduplicator &) = delete;
+    tu_deduplicator& operator = (const tu_deduplicator &) = delete;
+
+    /// Returns true if command is the first compile command of its
+    /// translation unit
+    bool
+    add(const compile_command & command);
+
+    /// The arguments of command that change what's parsed, with
+    /// include paths made absolute, without its main file
+    static
+    std::string
+    arguments_key(const compile_command & command);
+
+    /// Writes how many compile commands were collapsed and the files
+    /// with the most of them
+    void
+    print_statistics(std::ostream & stream) const;
+
+    private:
+
+    std::set<std::string> _keys;
+    std::size_t _commands = 0;
+
+    // number of collapsed compile commands of each main file
+    std::map<std::string, std::size_t> _collapsed;
+};
+
+#endif
@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <cctype>
+#include "compile_command.hpp"
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include "tu_scheduler.hpp"
+#include "tu_timings.hpp"
+#include <vector>
+
+namespace
+{
+    bool
+    is_space(char c) noexcept
+    {
+        return std::isspace(static_cast<unsigned char>(c));
+    }
+
+    // Weight of an included file relative to a byte of the main file
+    // when estimating the cost of a translation unit.
+    constexpr double include_weight = 32 * 1024;
+
+    /// Returns the files included by the main file of a compile command
+    std::vector<std::string>
+    scan_includes(const std::filesystem::path & file)
+    {
+        std::vector<std::string> includes;
+        std::ifstream stream(file);
+        std::string line;
+        while (std::getline(stream, line))
+        {
+            auto i = std::find_if_not(line.cbegin(), line.cend(), is_space);
+            if (i == line.cend() || *i != '#')
+            {
+                continue;
+            }
+
+            i = std::find_if_not(i + 1, line.cend(), is_space);
+            constexpr std::string_view include_directive = "include";
+            if (static_cast<std::size_t>(line.cend() - i) < include_directive.size() ||
+                !std::equal(include_directive.begin(), include_directive.end(), i))
+            {
+                continue;
+            }
+
+            i = std::find_if_not(i + include_directive.size(), line.cend(), is_space);
+            if (i == line.cend() || (*i != '"' && *i != '<'))
+            {
+                continue;
+            }
+
+            const char close = (*i == '"') ? '"' : '>';
+            const auto end = std::find(i + 1, line.cend(), close);
+            if (end != line.cend())
+            {
+                includes.emplace_back(i + 1, end);
+            }
+        }
+
+        return includes;
+    }
+}
+
+void
+tu_scheduler::push_back(std::unique_ptr<compile_command> command)
+{
+    const std::filesystem::path path = command->path();
+    std::vector<std::string> includes = scan_includes(path);
+
+    std::error_code ec;
+    const auto file_size = std::filesystem::file_size(path, ec);
+
+    entry e;
+    e.estimate = (ec ? 0 : file_size) + include_weight * includes.size();
+    e.command = std::move(command);
+
+    // A source file's own header does not make its include set
+    // different from its neighbours'.
+    const std::string stem = path.stem().string();
+    std::erase_if(includes, [&stem] (const std::string & include) {
+        return std::filesystem::path(include).stem() == stem;
+    });
+
+    std::sort(includes.begin(), includes.end());
+    includes.erase(std::unique(includes.begin(), includes.end()), includes.end());
+
+    std::string locality_key;
+    for (const auto & include: includes)
+    {
+        locality_key += include;
+        locality_key += '\n';
+    }
+
+    const std::lock_guard lock(this->_mutex);
+    const auto [index, inserted] = this->_group_indexes.try_emplace(locality_key, this->_groups.size());
+    if (inserted)
+    {
+        this->_groups.emplace_back();
+    }
+
+    this->_groups[index->second].push_back(std::move(e));
+    ++this->_size;
+}
+
+void
+tu_scheduler::schedule(const tu_timings & timings)
+{
+    const std::lock_guard lock(this->_mutex);
+
+    // Scale the estimates to seconds using the translation units that
+    // have a recorded time, so they can be compared with the recorded
+    // times.
+    double recorded_seconds = 0;
+    double recorded_estimate = 0;
+    for (auto & g: this->_groups)
+    {
+        for (auto & e: g)
+        {
+            const auto seconds = timings.find(e.command->path().string());
+            if (seconds)
+            {
+                e.cost = *seconds;
+                recorded_seconds += *seconds;
+                recorded_estimate += e.estimate;
+            }
+            else
+            {
+                e.cost = -1;
+            }
+        }
+    }
+
+    const double scale = (recorded_seconds > 0 && recorded_estimate > 0) ?
+        recorded_seconds / recorded_estimate : 1;
+
+    this->_group_costs.clear();
+    for (std::size_t i = 0; i < this->_groups.size(); ++i)
+    {
+        auto & g = this->_groups[i];
+        for (auto & e: g)
+        {
+            if (e.cost < 0)
+            {
+                e.cost = e.estimate * scale;
+            }
+        }
+
+        std::sort(g.begin(), g.end(), [] (const entry & lhs, const entry & rhs) {
+            return lhs.cost < rhs.cost;
+        });
+
+        if (!g.empty())
+        {
+            this->_group_costs.emplace(g.back().cost, i);
+        }
+    }
+}
+
+std::unique_ptr<compile_command>
+tu_scheduler::pop(affinity & worker)
+{
+    const std::lock_guard lock(this->_mutex);
+    std::unique_ptr<compile_command> command;
+
+    if (worker._group < this->_groups.size() && !this->_groups[worker._group].empty())
+    {
+        this->take(worker._group, command);
+        return command;
+    }
+
+    if (this->_group_costs.empty())
+    {
+        return nullptr;
+    }
+
+    // The worker's group is done, so move it to the group with the
+    // most expensive translation unit left.
+    worker._group = std::prev(this->_group_costs.end())->second;
+    this->take(worker._group, command);
+    return command;
+}
+
+void
+tu_scheduler::take(std::size_t group_index, std::unique_ptr<compile_command> & command)
+{
+    group & g = this->_groups[group_index];
+    this->_group_costs.erase({g.back().cost, group_index});
+
+    command = std::move(g.back().command);
+    g.pop_back();
+    --this->_size;
+
+    if (!g.empty())
+    {
+        this->_group_costs.emplace(g.back().cost, group_index);
+    }
+}
+
+std::size_t
+tu_scheduler::size() const
+{
+    const std::lock_guard lock(this->_mutex);
+    return this->_size;
+}
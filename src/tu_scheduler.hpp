@@ -0,0 +1,85 @@
+#ifndef TU_SCHEDULER_HPP
+#define TU_SCHEDULER_HPP
+
+#include "compile_command.hpp"
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class tu_timings;
+
+/** Hands compile commands out to the indexing workers.
+ *
+ *  The most expensive translation units are handed out first so a
+ *  long translation unit does not start at the end of a run.  A
+ *  translation unit's cost is its parse time from a previous run, or
+ *  an estimate based on the size of its main file and the number of
+ *  files it includes.
+ *
+ *  Translation units that include the same set of files are grouped
+ *  together, and a worker keeps receiving translation units from the
+ *  group of its last one while the group has any left.
+ */
+class tu_scheduler
+{
+    public:
+
+    /// The group of the last translation unit handed to a worker
+    class affinity
+    {
+        friend class tu_scheduler;
+        std::size_t _group = static_cast<std::size_t>(-1);
+    };
+
+    tu_scheduler() = default;
+
+    tu_scheduler(const tu_scheduler &) = delete;
+    tu_scheduler& operator = (const tu_scheduler &) = delete;
+
+    void
+    push_back(std::unique_ptr<compile_command> command);
+
+    /// Assigns the cost of each compile command, must be called
+    /// after all compile commands are pushed and before any are popped
+    void
+    schedule(const tu_timings & timings);
+
+    /// Returns the next compile command for a worker, or nullptr if
+    /// there are none left
+    std::unique_ptr<compile_command>
+    pop(affinity & worker);
+
+    std::size_t
+    size() const;
+
+    private:
+
+    struct entry
+    {
+        double cost = 0;
+        double estimate = 0;
+        std::unique_ptr<compile_command> command;
+    };
+
+    // Entries are ordered by ascending cost so the most expensive
+    // entry is at the back.
+    using group = std::vector<entry>;
+
+    void
+    take(std::size_t group_index, std::unique_ptr<compile_command> & command);
+
+    mutable std::mutex _mutex;
+    std::vector<group> _groups;
+    std::unordered_map<std::string, std::size_t> _group_indexes;
+
+    // cost of each non empty group's most expensive entry
+    std::set<std::pair<double, std::size_t>> _group_costs;
+    std::size_t _size = 0;
+};
+
+#endif
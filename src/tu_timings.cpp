@@ -0,0 +1,71 @@
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include "tu_timings.hpp"
+
+// Each line of the timings file is the number of seconds followed by
+// a space and the translation unit's path.
+
+void
+tu_timings::load(const std::filesystem::path & file)
+{
+    std::ifstream stream(file);
+    if (!stream)
+    {
+        return;
+    }
+
+    const std::lock_guard lock(this->_mutex);
+    double seconds;
+    std::string tu;
+    while (stream >> seconds && stream.get() == ' ' && std::getline(stream, tu))
+    {
+        this->_seconds[tu] = seconds;
+    }
+}
+
+void
+tu_timings::save(const std::filesystem::path & file) const
+{
+    std::filesystem::path tmp_file = file;
+    tmp_file += ".tmp";
+
+    {
+        std::ofstream stream(tmp_file, std::ios::trunc);
+        const std::lock_guard lock(this->_mutex);
+        for (const auto & [tu, seconds]: this->_seconds)
+        {
+            stream << seconds << ' ' << tu << '\n';
+        }
+
+        if (!stream)
+        {
+            throw std::runtime_error("error writing " + tmp_file.string());
+        }
+    }
+
+    std::filesystem::rename(tmp_file, file);
+}
+
+void
+tu_timings::record(const std::string & tu, double seconds)
+{
+    const std::lock_guard lock(this->_mutex);
+    this->_seconds[tu] = seconds;
+}
+
+std::optional<double>
+tu_timings::find(const std::string & tu) const
+{
+    const std::lock_guard lock(this->_mutex);
+    const auto i = this->_seconds.find(tu);
+    if (i == this->_seconds.end())
+    {
+        return std::nullopt;
+    }
+
+    return i->second;
+}
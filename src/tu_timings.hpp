@@ -0,0 +1,40 @@
+#ifndef TU_TIMINGS_HPP
+#define TU_TIMINGS_HPP
+
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+
+/// Per translation unit parse times, persisted between runs
+class tu_timings
+{
+    public:
+
+    tu_timings() = default;
+
+    tu_timings(const tu_timings &) = delete;
+    tu_timings& operator = (const tu_timings &) = delete;
+
+    /// Loads the timings in file, a missing file is not an error
+    void
+    load(const std::filesystem::path & file);
+
+    void
+    save(const std::filesystem::path & file) const;
+
+    /// Records how many seconds it took to parse and graph tu
+    void
+    record(const std::string & tu, double seconds);
+
+    std::optional<double>
+    find(const std::string & tu) const;
+
+    private:
+
+    mutable std::mutex _mutex;
+    std::map<std::string, double> _seconds;
+};
+
+#endif
@@ -0,0 +1,259 @@
+#include <algorithm>
+#include <clang-c/Index.h>
+#include "compile_command.hpp"
+#include "content_hash.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <map>
+#include <memory>
+#include "ngclang.hpp"
+#include <optional>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include "tu_deduplicator.hpp"
+#include <unordered_map>
+#include "unity_batches.hpp"
+#include <utility>
+#include <vector>
+
+namespace
+{
+    /// The state of conflicting_symbol's traversal
+    struct symbol_search
+    {
+        std::vector<CXFile> sources;
+
+        // the source each file is, or sources.size() if it's not one
+        std::unordered_map<CXFile, std::size_t> file_sources;
+
+        // the source that declares each internal linkage symbol, by its
+        // semantic parent and name
+        std::map<std::string, std::size_t> symbols;
+
+        std::optional<std::string> conflict;
+    };
+
+    std::size_t
+    source_index(symbol_search & search, CXFile file)
+    {
+        const auto [i, inserted] = search.file_sources.try_emplace(file, search.sources.size());
+        if (inserted)
+        {
+            const auto source = std::ranges::find_if(search.sources, [file] (CXFile f) {
+                return clang_File_isEqual(f, file);
+            });
+            i->second = source - search.sources.begin();
+        }
+
+        return i->second;
+    }
+
+    CXChildVisitResult
+    find_conflict(CXCursor cursor, CXCursor, CXClientData client_data)
+    {
+        auto & search = *reinterpret_cast<symbol_search *>(client_data);
+        const CXCursorKind kind = clang_getCursorKind(cursor);
+        if (kind == CXCursor_Namespace || kind == CXCursor_LinkageSpec)
+        {
+            return CXChildVisit_Recurse;
+        }
+
+        if (!clang_isDeclaration(kind))
+        {
+            return CXChildVisit_Continue;
+        }
+
+        const CXLinkageKind linkage = clang_getCursorLinkage(cursor);
+        if (linkage != CXLinkage_Internal && linkage != CXLinkage_UniqueExternal)
+        {
+            return CXChildVisit_Continue;
+        }
+
+        CXFile file = nullptr;
+        clang_getExpansionLocation(clang_getCursorLocation(cursor), &file, nullptr, nullptr, nullptr);
+        const std::size_t source = file ? source_index(search, file) : search.sources.size();
+        if (source == search.sources.size())
+        {
+            return CXChildVisit_Continue;
+        }
+
+        const std::string name = ngclang::to_string(clang_getCursorSpelling(cursor));
+        if (name.empty())
+        {
+            return CXChildVisit_Continue;
+        }
+
+        // The anonymous namespaces of all the sources are the same
+        // namespace in a unity translation unit.
+        const std::string key =
+            ngclang::to_string(clang_getCursorUSR(clang_getCursorSemanticParent(cursor))) + '\0' + name;
+        const auto [i, inserted] = search.symbols.try_emplace(key, source);
+        if (!inserted && i->second != source)
+        {
+            search.conflict = name;
+            return CXChildVisit_Break;
+        }
+
+        return CXChildVisit_Continue;
+    }
+}
+
+unity_batches::unity_batches(std::filesystem::path directory, std::size_t batch_size):
+    _directory(std::move(directory)),
+    _batch_size(std::max<std::size_t>(batch_size, 1))
+{}
+
+unity_batches::~unity_batches()
+{
+    std::error_code ec;
+    for (const auto & [file, sources]: this->_batches)
+    {
+        std::filesystem::remove(file, ec);
+    }
+
+    // Only removed once it's empty, concurrent runs may share it.
+    std::filesystem::remove(this->_directory, ec);
+}
+
+void
+unity_batches::add(std::unique_ptr<compile_command> command)
+{
+    std::string key = command->directory();
+    key += '\0';
+    key += command->path().extension().string();
+    key += tu_deduplicator::arguments_key(*command);
+
+    // A source that can't be named by an include directive isn't
+    // batched with others.
+    const std::string path = source(*command);
+    if (path.find_first_of("\"\n") != std::string::npos)
+    {
+        key += '\n';
+        key += path;
+    }
+
+    this->_groups[key].push_back(std::move(command));
+}
+
+std::vector<std::unique_ptr<compile_command>>
+unity_batches::build()
+{
+    std::vector<std::unique_ptr<compile_command>> commands;
+    for (auto & [key, group]: this->_groups)
+    {
+        for (std::size_t first = 0; first < group.size(); first += this->_batch_size)
+        {
+            const std::size_t last = std::min(first + this->_batch_size, group.size());
+            if (last - first == 1)
+            {
+                commands.push_back(std::move(group[first]));
+                continue;
+            }
+
+            batch sources(std::make_move_iterator(group.begin() + first),
+                          std::make_move_iterator(group.begin() + last));
+            auto command = this->write(sources);
+            if (!command)
+            {
+                std::move(sources.begin(), sources.end(), std::back_inserter(commands));
+                continue;
+            }
+
+            this->_batches.emplace(command->file(), std::move(sources));
+            commands.push_back(std::move(command));
+        }
+    }
+
+    this->_groups.clear();
+    return commands;
+}
+
+const unity_batches::batch *
+unity_batches::find(const compile_command & command) const
+{
+    const auto i = this->_batches.find(command.file());
+    return (i == this->_batches.end()) ? nullptr : &i->second;
+}
+
+std::string
+unity_batches::source(const compile_command & command)
+{
+    std::error_code ec;
+    const std::filesystem::path path = std::filesystem::absolute(command.path(), ec);
+    return (ec ? command.path() : path).lexically_normal().string();
+}
+
+std::optional<std::string>
+unity_batches::conflicting_symbol(CXTranslationUnit unit, const batch & sources)
+{
+    symbol_search search;
+    for (const auto & command: sources)
+    {
+        search.sources.push_back(clang_getFile(unit, source(*command).c_str()));
+    }
+
+    clang_visitChildren(clang_getTranslationUnitCursor(unit), &find_conflict, &search);
+    return search.conflict;
+}
+
+std::unique_ptr<compile_command>
+unity_batches::write(const batch & sources)
+{
+    const compile_command & first = *sources.front();
+
+    std::uint64_t hash = content_hash(tu_deduplicator::arguments_key(first));
+    for (const auto & command: sources)
+    {
+        hash = content_hash(source(*command), hash);
+    }
+
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << hash << first.path().extension().string();
+    const std::filesystem::path file = this->_directory / name.str();
+
+    std::error_code ec;
+    std::filesystem::create_directories(this->_directory, ec);
+    {
+        std::ofstream stream(file, std::ios::trunc);
+        for (const auto & command: sources)
+        {
+            stream << "#include \"" << source(*command) << "\"\n";
+        }
+
+        stream.close();
+        if (!stream)
+        {
+            std::filesystem::remove(file, ec);
+            return nullptr;
+        }
+    }
+
+    // The main file of the first compile command is replaced by the
+    // generated one, which has the same extension so it's parsed as
+    // the same language.
+    std::vector<std::string> arguments = first.arguments();
+    const std::string first_path = first.path().string();
+    bool replaced = false;
+    for (auto & argument: arguments)
+    {
+        if (argument == first.file() || argument == first_path)
+        {
+            argument = file.string();
+            replaced = true;
+        }
+    }
+
+    if (!replaced)
+    {
+        arguments.push_back(file.string());
+    }
+
+    auto command = std::make_unique<compile_command>(file.string());
+    command->assign_arguments(arguments);
+    return command;
+}
@@ -0,0 +1,97 @@
+#ifndef UNITY_BATCHES_HPP
+#define UNITY_BATCHES_HPP
+
+#include <clang-c/Index.h>
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+class compile_command;
+
+/** Unity translation units that parse the main files of several
+ *  compile commands in one libclang invocation.
+ *
+ *  Compile commands are grouped by their working directory, the
+ *  extension of their main file and their arguments that change what's
+ *  parsed, as tu_deduplicator compares them.  Each group is split into
+ *  batches of up to batch_size compile commands in the order they were
+ *  added, and a batch of more than one gets a generated main file that
+ *  includes their main files, its sources, and is parsed with the
+ *  arguments of the first.  The headers the sources share are then
+ *  only parsed once per batch, and declarations keep the locations of
+ *  the sources they're in.
+ *
+ *  As in any unity build, the sources of a batch see each other's
+ *  declarations and macros.  A batch is parsed one source at a time
+ *  instead when two of its sources declare internal linkage symbols
+ *  with the same name, which would otherwise be overloads of each
+ *  other or redefinitions.
+ *
+ *  The generated main files are removed with the batches.
+ */
+class unity_batches
+{
+    public:
+
+    using batch = std::vector<std::unique_ptr<compile_command>>;
+
+    /// The generated main files are written to directory
+    unity_batches(std::filesystem::path directory, std::size_t batch_size);
+
+    ~unity_batches();
+
+    unity_batches(const unity_batches &) = delete;
+    unity_batches& operator = (const unity_batches &) = delete;
+
+    void
+    add(std::unique_ptr<compile_command> command);
+
+    /** Writes the main file of each batch of more than one compile
+     *  command.
+     *
+     *  Returns the compile commands of the batches, and the compile
+     *  commands that aren't batched with others as they are.  A batch
+     *  whose main file can't be written is returned as separate
+     *  compile commands.
+     */
+    std::vector<std::unique_ptr<compile_command>>
+    build();
+
+    /// The compile commands batched in command, or nullptr if command
+    /// isn't the compile command of a batch
+    const batch *
+    find(const compile_command & command) const;
+
+    /// The path the main file of a batch includes command's main file by
+    static
+    std::string
+    source(const compile_command & command);
+
+    /// Returns the name of an internal linkage symbol declared by more
+    /// than one of the sources of batch in unit, or nothing
+    static
+    std::optional<std::string>
+    conflicting_symbol(CXTranslationUnit unit, const batch & sources);
+
+    private:
+
+    /// Writes the main file of sources and returns its compile command,
+    /// or nullptr if it can't be written
+    std::unique_ptr<compile_command>
+    write(const batch & sources);
+
+    std::filesystem::path _directory;
+    std::size_t _batch_size;
+
+    // compile commands by their group, in the order they were added
+    std::map<std::string, batch> _groups;
+
+    // batches by the main file of their compile command
+    std::map<std::string, batch> _batches;
+};
+
+#endif
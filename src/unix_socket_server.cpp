@@ -0,0 +1,163 @@
+#include <cerrno>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <system_error>
+#include <unistd.h>
+#include "unix_socket_server.hpp"
+#include <utility>
+
+namespace
+{
+    [[noreturn]]
+    void
+    throw_errno(const std::string & what)
+    {
+        throw std::system_error(errno, std::generic_category(), what);
+    }
+
+    /// Writes all of data to connection, returns false if the client
+    /// went away
+    bool
+    write_all(int connection, std::string_view data)
+    {
+        while (!data.empty())
+        {
+            const ssize_t written = ::send(connection, data.data(), data.size(), MSG_NOSIGNAL);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+
+                return false;
+            }
+
+            data.remove_prefix(written);
+        }
+
+        return true;
+    }
+}
+
+unix_socket_server::unix_socket_server(std::filesystem::path path):
+    _path(std::move(path))
+{
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    if (this->_path.native().size() >= sizeof(address.sun_path))
+    {
+        throw std::system_error(std::make_error_code(std::errc::filename_too_long), this->_path.string());
+    }
+
+    this->_path.native().copy(address.sun_path, sizeof(address.sun_path) - 1);
+
+    this->_socket = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (this->_socket < 0)
+    {
+        throw_errno("socket");
+    }
+
+    std::error_code ec;
+    if (std::filesystem::is_socket(this->_path, ec))
+    {
+        std::filesystem::remove(this->_path, ec);
+    }
+
+    // Only the owner may connect.  Nothing can connect before listen,
+    // so the socket's mode is set in between.
+    if (::bind(this->_socket, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) < 0 ||
+        ::chmod(this->_path.c_str(), S_IRUSR | S_IWUSR) < 0 ||
+        ::listen(this->_socket, 8) < 0)
+    {
+        const int error = errno;
+        ::close(this->_socket);
+        throw std::system_error(error, std::generic_category(), this->_path.string());
+    }
+}
+
+unix_socket_server::~unix_socket_server()
+{
+    ::close(this->_socket);
+
+    std::error_code ec;
+    std::filesystem::remove(this->_path, ec);
+}
+
+void
+unix_socket_server::serve(const handler & request_handler)
+{
+    while (!this->_stopped)
+    {
+        const int connection = ::accept4(this->_socket, nullptr, nullptr, SOCK_CLOEXEC);
+        if (connection < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+            {
+                continue;
+            }
+
+            throw_errno("accept");
+        }
+
+        try
+        {
+            this->serve_connection(connection, request_handler);
+        }
+        catch (...)
+        {
+            ::close(connection);
+            throw;
+        }
+
+        ::close(connection);
+    }
+}
+
+void
+unix_socket_server::stop() noexcept
+{
+    this->_stopped = true;
+}
+
+void
+unix_socket_server::serve_connection(int connection, const handler & request_handler)
+{
+    std::string buffer;
+    char data[4096];
+    while (!this->_stopped)
+    {
+        const ssize_t size = ::recv(connection, data, sizeof(data), 0);
+        if (size < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (size <= 0)
+        {
+            return;
+        }
+
+        buffer.append(data, size);
+
+        std::string::size_type end;
+        while (!this->_stopped && (end = buffer.find('\n')) != std::string::npos)
+        {
+            std::string request = buffer.substr(0, end);
+            buffer.erase(0, end + 1);
+            if (!request.empty() && request.back() == '\r')
+            {
+                request.pop_back();
+            }
+
+            if (!write_all(connection, request_handler(request)))
+            {
+                return;
+            }
+        }
+    }
+}
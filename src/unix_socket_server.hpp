@@ -0,0 +1,51 @@
+#ifndef UNIX_SOCKET_SERVER_HPP
+#define UNIX_SOCKET_SERVER_HPP
+
+#include <filesystem>
+#include <functional>
+#include <string>
+
+/** Answers line based requests on a Unix domain socket.
+ *
+ *  Connections are served one at a time.  Each line a client writes is
+ *  a request, and the handler's reply to it is written back before the
+ *  next line is read.
+ */
+class unix_socket_server
+{
+    public:
+
+    using handler = std::function<std::string (const std::string & request)>;
+
+    /// Listens on path, replacing a socket left there by a previous
+    /// server, only the user may connect
+    explicit
+    unix_socket_server(std::filesystem::path path);
+
+    ~unix_socket_server();
+
+    unix_socket_server(const unix_socket_server &) = delete;
+    unix_socket_server& operator = (const unix_socket_server &) = delete;
+
+    /// Serves connections until stop is called
+    void
+    serve(const handler & request_handler);
+
+    /// Stops serving once the current request is answered, can be
+    /// called from the handler
+    void
+    stop() noexcept;
+
+    private:
+
+    /// Serves one connection, returns once the client closes it or
+    /// the server is stopped
+    void
+    serve_connection(int connection, const handler & request_handler);
+
+    std::filesystem::path _path;
+    int _socket = -1;
+    bool _stopped = false;
+};
+
+#endif
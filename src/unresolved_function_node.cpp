@@ -0,0 +1,20 @@
+#include <string>
+#include <string_view>
+#include "unresolved_function_node.hpp"
+
+const ngmg::cypher::label &
+unresolved_function_node::label() noexcept
+{
+    static const ngmg::cypher::label l ("UnresolvedFunction");
+    return l;
+}
+
+void
+unresolved_function_node::fill(std::string_view name)
+{
+    // Not a USR libclang generates, those start with "c:".
+    this->usr.prop = "unresolved:" + std::string(name);
+    this->names.name_prop = name;
+    this->names.fq_name_prop = name;
+    this->names.unqualified_name_prop = name;
+}
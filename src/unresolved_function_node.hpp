@@ -0,0 +1,42 @@
+#ifndef UNRESOLVED_FUNCTION_NODE_HPP
+#define UNRESOLVED_FUNCTION_NODE_HPP
+
+#include "memgraph/cypher/label.hpp"
+#include "name_properties.hpp"
+#include <string_view>
+#include "universal_symbol_reference_property.hpp"
+#include <tuple>
+
+/** A placeholder for a function that a call refers to but libclang
+ *  couldn't resolve, because it's declared in a header that wasn't
+ *  parsed.
+ *
+ *  The placeholder is only known by the name the call uses, so its
+ *  universal symbol reference is made up from the name, and the calls
+ *  to every unresolved function with the same name go to the same
+ *  placeholder.
+ */
+class unresolved_function_node
+{
+    public:
+
+    unresolved_function_node() = default;
+
+    name_properties names;
+    universal_symbol_reference_property usr;
+
+    static
+    const ngmg::cypher::label &
+    label() noexcept;
+
+    void
+    fill(std::string_view name);
+
+    auto
+    tuple()
+    {
+        return std::tuple_cat(names.tuple(), std::tie(usr.prop));
+    }
+};
+
+#endif
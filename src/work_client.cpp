@@ -0,0 +1,89 @@
+#include <cerrno>
+#include <optional>
+#include "socket_address.hpp"
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <system_error>
+#include <unistd.h>
+#include "work_client.hpp"
+
+work_client::work_client(const std::string & address):
+    _socket(connect_socket(address))
+{}
+
+work_client::~work_client()
+{
+    ::close(this->_socket);
+}
+
+std::optional<std::string>
+work_client::next()
+{
+    return this->request("next\n");
+}
+
+std::optional<std::string>
+work_client::done(double seconds)
+{
+    std::ostringstream line;
+    line << "done " << seconds << '\n';
+    return this->request(line.str());
+}
+
+std::optional<std::string>
+work_client::request(const std::string & line)
+{
+    std::string_view data = line;
+    while (!data.empty())
+    {
+        const ssize_t written = ::send(this->_socket, data.data(), data.size(), MSG_NOSIGNAL);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            throw std::system_error(errno, std::generic_category(), "send to coordinator");
+        }
+
+        data.remove_prefix(written);
+    }
+
+    std::string::size_type end;
+    while ((end = this->_buffer.find('\n')) == std::string::npos)
+    {
+        char buffer[4096];
+        const ssize_t size = ::recv(this->_socket, buffer, sizeof(buffer), 0);
+        if (size < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (size <= 0)
+        {
+            throw std::runtime_error("lost the connection to the coordinator");
+        }
+
+        this->_buffer.append(buffer, size);
+    }
+
+    std::string reply = this->_buffer.substr(0, end);
+    this->_buffer.erase(0, end + 1);
+
+    constexpr std::string_view work = "work ";
+    if (reply.starts_with(work))
+    {
+        return reply.substr(work.size());
+    }
+
+    if (reply == "end")
+    {
+        return std::nullopt;
+    }
+
+    throw std::runtime_error("invalid reply from the coordinator: " + reply);
+}
@@ -0,0 +1,39 @@
+#ifndef WORK_CLIENT_HPP
+#define WORK_CLIENT_HPP
+
+#include <optional>
+#include <string>
+
+/// A worker's connection to a work_coordinator
+class work_client
+{
+    public:
+
+    /// Connects to the coordinator at address, see socket_address.hpp
+    explicit
+    work_client(const std::string & address);
+
+    ~work_client();
+
+    work_client(const work_client &) = delete;
+    work_client& operator = (const work_client &) = delete;
+
+    /// Asks for the first item, returns nothing once every item is done
+    std::optional<std::string>
+    next();
+
+    /// Reports that the last item took seconds and asks for the next
+    /// one, returns nothing once every item is done
+    std::optional<std::string>
+    done(double seconds);
+
+    private:
+
+    std::optional<std::string>
+    request(const std::string & line);
+
+    int _socket = -1;
+    std::string _buffer;
+};
+
+#endif
@@ -0,0 +1,238 @@
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <poll.h>
+#include "socket_address.hpp"
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <system_error>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+#include "work_coordinator.hpp"
+
+namespace
+{
+    // the times an item is handed out before it's given up on
+    constexpr unsigned int max_attempts = 3;
+
+    struct worker
+    {
+        std::string buffer;
+
+        // the item the worker is working on
+        std::optional<std::size_t> item;
+
+        // true while the worker waits for its next item
+        bool waiting = false;
+    };
+
+    /// Writes all of data to connection, returns false if the worker
+    /// went away
+    bool
+    write_all(int connection, std::string_view data)
+    {
+        while (!data.empty())
+        {
+            const ssize_t written = ::send(connection, data.data(), data.size(), MSG_NOSIGNAL);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+
+                return false;
+            }
+
+            data.remove_prefix(written);
+        }
+
+        return true;
+    }
+}
+
+work_coordinator::work_coordinator(std::string address):
+    _address(std::move(address)),
+    _socket(listen_socket(this->_address))
+{}
+
+work_coordinator::~work_coordinator()
+{
+    ::close(this->_socket);
+    remove_socket(this->_address);
+}
+
+void
+work_coordinator::run(const std::vector<std::string> & items, const completion & completed)
+{
+    std::deque<std::size_t> pending;
+    for (std::size_t i = 0; i < items.size(); ++i)
+    {
+        pending.push_back(i);
+    }
+
+    std::size_t remaining = items.size();
+    std::map<int, worker> workers;
+
+    // the times each item was handed out
+    std::vector<unsigned int> attempts(items.size(), 0);
+
+    const auto disconnect = [&items, &workers, &pending, &remaining, &attempts] (int connection) {
+        worker & w = workers.at(connection);
+        if (w.item && attempts[*w.item] < max_attempts)
+        {
+            std::cerr << "worker disconnected, handing out " << items[*w.item] << " again\n";
+            pending.push_front(*w.item);
+        }
+        else if (w.item)
+        {
+            std::cerr << "worker disconnected " << max_attempts << " times, skipped " << items[*w.item] << '\n';
+            --remaining;
+        }
+
+        ::close(connection);
+        workers.erase(connection);
+    };
+
+    // Handles the requests a worker sent, returns false if it sent an
+    // invalid request.
+    const auto handle_requests = [&completed, &remaining] (worker & w) {
+        std::string::size_type end;
+        while ((end = w.buffer.find('\n')) != std::string::npos)
+        {
+            std::string request = w.buffer.substr(0, end);
+            w.buffer.erase(0, end + 1);
+            if (!request.empty() && request.back() == '\r')
+            {
+                request.pop_back();
+            }
+
+            if (w.waiting)
+            {
+                return false;
+            }
+
+            constexpr std::string_view done = "done ";
+            if (request.starts_with(done) && w.item)
+            {
+                char * end_seconds = nullptr;
+                const double seconds = std::strtod(request.c_str() + done.size(), &end_seconds);
+                if (*end_seconds != '\0')
+                {
+                    return false;
+                }
+
+                completed(*w.item, seconds);
+                w.item.reset();
+                --remaining;
+            }
+            else if (request != "next" || w.item)
+            {
+                return false;
+            }
+
+            w.waiting = true;
+        }
+
+        return true;
+    };
+
+    while (remaining > 0)
+    {
+        // Hand out the pending items to the waiting workers.
+        for (auto i = workers.begin(); i != workers.end() && !pending.empty();)
+        {
+            const int connection = i->first;
+            worker & w = (i++)->second;
+            if (!w.waiting)
+            {
+                continue;
+            }
+
+            w.waiting = false;
+            w.item = pending.front();
+            pending.pop_front();
+            ++attempts[*w.item];
+            if (!write_all(connection, "work " + items[*w.item] + '\n'))
+            {
+                disconnect(connection);
+            }
+        }
+
+        std::vector<pollfd> fds;
+        fds.push_back(pollfd {this->_socket, POLLIN, 0});
+        for (const auto & [connection, w]: workers)
+        {
+            fds.push_back(pollfd {connection, POLLIN, 0});
+        }
+
+        if (::poll(fds.data(), fds.size(), -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            throw std::system_error(errno, std::generic_category(), "poll");
+        }
+
+        for (std::size_t i = 1; i < fds.size(); ++i)
+        {
+            if (fds[i].revents == 0)
+            {
+                continue;
+            }
+
+            const int connection = fds[i].fd;
+            char data[4096];
+            const ssize_t size = ::recv(connection, data, sizeof(data), 0);
+            if (size < 0 && errno == EINTR)
+            {
+                continue;
+            }
+
+            if (size <= 0)
+            {
+                disconnect(connection);
+                continue;
+            }
+
+            worker & w = workers.at(connection);
+            w.buffer.append(data, size);
+            if (!handle_requests(w))
+            {
+                std::cerr << "invalid request from worker\n";
+                disconnect(connection);
+            }
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            const int connection = ::accept4(this->_socket, nullptr, nullptr, SOCK_CLOEXEC);
+            if (connection >= 0)
+            {
+                workers.emplace(connection, worker {});
+            }
+            else if (errno != EINTR && errno != ECONNABORTED)
+            {
+                throw std::system_error(errno, std::generic_category(), "accept");
+            }
+        }
+    }
+
+    for (const auto & [connection, w]: workers)
+    {
+        if (w.waiting)
+        {
+            write_all(connection, "end\n");
+        }
+
+        ::close(connection);
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef WORK_COORDINATOR_HPP
+#define WORK_COORDINATOR_HPP
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+/** Hands work items out to worker processes over a socket.
+ *
+ *  Any number of workers connect to the coordinator, each connection
+ *  works on one item at a time.  A worker writes a "next" line for its
+ *  first item and a "done <seconds>" line when it finished an item,
+ *  the coordinator replies with a "work <item>" line or, once every
+ *  item is done, an "end" line.
+ *
+ *  The item of a worker whose connection closes before it's done is
+ *  handed out again, ahead of the items no worker started.  An item
+ *  whose workers went away three times, like a translation unit that
+ *  crashes libclang, is reported and skipped.
+ */
+class work_coordinator
+{
+    public:
+
+    using completion = std::function<void (std::size_t item, double seconds)>;
+
+    /// Listens on address, see socket_address.hpp
+    explicit
+    work_coordinator(std::string address);
+
+    ~work_coordinator();
+
+    work_coordinator(const work_coordinator &) = delete;
+    work_coordinator& operator = (const work_coordinator &) = delete;
+
+    /** Hands out items in order until all of them are done or skipped.
+     *
+     *  completed is called with the index of each item done and the
+     *  seconds its worker reported.  Items must not contain newlines.
+     */
+    void
+    run(const std::vector<std::string> & items, const completion & completed);
+
+    private:
+
+    std::string _address;
+    int _socket = -1;
+};
+
+#endif